@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""Generate src/common/crc32_tables.h: slicing-by-8 tables for the reflected
+CRC-32 polynomial 0xEDB88320 used by ru_crc32()."""
+
+import os
+
+POLY = 0xEDB88320
+
+
+def main():
+    t = [[0] * 256 for _ in range(8)]
+    for i in range(256):
+        c = i
+        for _ in range(8):
+            c = (c >> 1) ^ POLY if c & 1 else c >> 1
+        t[0][i] = c
+    for k in range(1, 8):
+        for i in range(256):
+            t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF]
+
+    out = ["/* Generated by scripts/gen_crc32_tables.py, do not edit. */",
+           "#ifndef CRC32_TABLES_H",
+           "#define CRC32_TABLES_H",
+           "",
+           "#include <stdint.h>",
+           "",
+           "static const uint32_t crc32_tables[8][256] = {"]
+    for k in range(8):
+        out.append("    {")
+        for i in range(0, 256, 6):
+            row = ", ".join("0x%08xu" % v for v in t[k][i:i + 6])
+            out.append("        " + row + ("," if i + 6 < 256 else ""))
+        out.append("    }" + ("," if k < 7 else ""))
+    out += ["};", "", "#endif /* CRC32_TABLES_H */", ""]
+
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    with open(os.path.join(root, "src", "common", "crc32_tables.h"), "w") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
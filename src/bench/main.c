@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "../common/platform.h"
+#include "../common/util.h"
+#include "../common/netem.h"
+
+/* Loopback benchmark: for every point of a chunk size x window x loss x
+ * RTT sweep it starts the server binary, sends one test file --runs times
+ * with the client binary and reports goodput, the share of DATA packets
+ * that had to be resent, CPU seconds per GB moved (client plus server)
+ * and the median and 99th percentile completion time. Loss and delay come
+ * from the RUFT_NETEM impairment in the socket layer, applied by both ends,
+ * so each gets half the round trip. */
+
+#define MAX_POINTS 16           /* values per swept parameter */
+#define MAX_RUNS 1000
+#define MAX_EXTRA 32            /* client arguments after "--" */
+
+typedef struct {
+    char bin[1024];             /* directory holding client and server */
+    uint64_t size;
+    int runs;
+    int port;
+    int timeout_s;
+    int csv;
+    const char* netem;          /* further RUFT_NETEM keys for every point */
+    const char* chunks[MAX_POINTS];
+    int nchunks;
+    const char* windows[MAX_POINTS];
+    int nwindows;
+    const char* losses[MAX_POINTS];
+    int nlosses;
+    const char* rtts[MAX_POINTS];
+    int nrtts;
+    char* extra[MAX_EXTRA];
+    int nextra;
+} Args;
+
+typedef struct {
+    int ok;
+    int failed;
+    double times[MAX_RUNS];     /* completion, seconds */
+    size_t packets;
+    size_t resent;
+    double cpu;                 /* user + system seconds, both processes */
+} Result;
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--bin <dir>] [--size 16M] [--runs 5] [--chunk 1400,...] [--window 256,...] "
+                    "[--loss 0,1%%,...] [--rtt 0,20,...] [--netem <spec>] [--port 19000] [--timeout 120] "
+                    "[--csv] [-- <client args>]\n", prog);
+}
+
+/* Comma-separated values, split in place */
+static int split_list(char* s, const char** out) {
+    int n = 0;
+    for (char* v = strtok(s, ","); v && n < MAX_POINTS; v = strtok(NULL, ",")) out[n++] = v;
+    return n;
+}
+
+static int parse_args(int argc, char** argv, Args* a) {
+    memset(a, 0, sizeof(*a));
+    const char* slash = strrchr(argv[0], '/');
+    if (slash) snprintf(a->bin, sizeof(a->bin), "%.*s", (int)(slash - argv[0]), argv[0]);
+    else strcpy(a->bin, ".");
+    a->size = 16 << 20;
+    a->runs = 5;
+    a->port = 19000;
+    a->timeout_s = 120;
+    static char def_chunk[] = "1400", def_window[] = "256", def_loss[] = "0", def_rtt[] = "0";
+    a->nchunks = split_list(def_chunk, a->chunks);
+    a->nwindows = split_list(def_window, a->windows);
+    a->nlosses = split_list(def_loss, a->losses);
+    a->nrtts = split_list(def_rtt, a->rtts);
+
+    for (int i = 1; i < argc; i++) {
+        char* s = argv[i];
+        if (strcmp(s, "--bin") == 0 && i+1 < argc) {
+            snprintf(a->bin, sizeof(a->bin), "%s", argv[++i]);
+        } else if (strcmp(s, "--size") == 0 && i+1 < argc) {
+            char* end;
+            double v = strtod(argv[++i], &end);
+            if (*end == 'k' || *end == 'K') v *= 1024;
+            else if (*end == 'M') v *= 1024 * 1024;
+            else if (*end == 'G') v *= 1024.0 * 1024 * 1024;
+            a->size = (uint64_t)v;
+        } else if (strcmp(s, "--runs") == 0 && i+1 < argc) {
+            a->runs = atoi(argv[++i]);
+        } else if (strcmp(s, "--port") == 0 && i+1 < argc) {
+            a->port = atoi(argv[++i]);
+        } else if (strcmp(s, "--timeout") == 0 && i+1 < argc) {
+            a->timeout_s = atoi(argv[++i]);
+        } else if (strcmp(s, "--netem") == 0 && i+1 < argc) {
+            a->netem = argv[++i];
+        } else if (strcmp(s, "--chunk") == 0 && i+1 < argc) {
+            a->nchunks = split_list(argv[++i], a->chunks);
+        } else if (strcmp(s, "--window") == 0 && i+1 < argc) {
+            a->nwindows = split_list(argv[++i], a->windows);
+        } else if (strcmp(s, "--loss") == 0 && i+1 < argc) {
+            a->nlosses = split_list(argv[++i], a->losses);
+        } else if (strcmp(s, "--rtt") == 0 && i+1 < argc) {
+            a->nrtts = split_list(argv[++i], a->rtts);
+        } else if (strcmp(s, "--csv") == 0) {
+            a->csv = 1;
+        } else if (strcmp(s, "--") == 0) {
+            while (++i < argc && a->nextra < MAX_EXTRA) a->extra[a->nextra++] = argv[i];
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", s);
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    if (a->runs < 1 || a->runs > MAX_RUNS) {
+        fprintf(stderr, "--runs must be from 1 to %d\n", MAX_RUNS);
+        return 0;
+    }
+    if (a->size == 0 || !a->nchunks || !a->nwindows || !a->nlosses || !a->nrtts) {
+        usage(argv[0]);
+        return 0;
+    }
+    return 1;
+}
+
+/* The RUFT_NETEM spec for one point, empty when the link is clean */
+static int point_spec(const Args* a, const char* loss, const char* rtt, char* buf, size_t cap) {
+    double rtt_ms = atof(rtt);
+    int n = 0;
+    buf[0] = '\0';
+    if (atof(loss) > 0) n += snprintf(buf + n, cap - (size_t)n, "loss=%s,", loss);
+    if (rtt_ms > 0) n += snprintf(buf + n, cap - (size_t)n, "delay=%.0fus,", rtt_ms * 500);
+    if (a->netem) n += snprintf(buf + n, cap - (size_t)n, "%s,", a->netem);
+    if (n > 0) buf[--n] = '\0';
+    NetemSpec check;
+    return n == 0 || netem_parse(&check, buf);
+}
+
+/* Runs argv with the point's impairment; timeout_s > 0 kills it by then */
+static pid_t spawn(char* const* argv, const char* spec, int out_fd, int timeout_s) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    if (timeout_s > 0) alarm((unsigned)timeout_s);
+    if (*spec) setenv(NETEM_ENV, spec, 1);
+    else unsetenv(NETEM_ENV);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(out_fd >= 0 ? out_fd : null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execv(argv[0], argv);
+    _exit(127);
+}
+
+static double cpu_seconds(const struct rusage* ru) {
+    return (double)(ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) +
+           (double)(ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) / 1e6;
+}
+
+/* Whether the received copy matches what was sent */
+static int same_file(const char* path, const uint8_t* data, uint64_t size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    uint8_t buf[65536];
+    uint64_t off = 0;
+    int same = 1;
+    size_t n;
+    while (same && (n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        same = off + n <= size && memcmp(buf, data + off, n) == 0;
+        off += n;
+    }
+    fclose(f);
+    return same && off == size;
+}
+
+/* One client run, counted only if the copy arrived intact; its stdout is
+ * read for the resend count */
+static int run_client(const Args* a, const char* spec, const char* port, const char* chunk,
+                      const char* window, const char* file, const char* received,
+                      const uint8_t* data, Result* r) {
+    char client[1100];
+    snprintf(client, sizeof(client), "%s/client", a->bin);
+    char* argv[12 + MAX_EXTRA];
+    int n = 0;
+    argv[n++] = client;
+    argv[n++] = "--host";
+    argv[n++] = "127.0.0.1";
+    argv[n++] = "--port";
+    argv[n++] = (char*)port;
+    argv[n++] = "--file";
+    argv[n++] = (char*)file;
+    argv[n++] = "--chunk";
+    argv[n++] = (char*)chunk;
+    argv[n++] = "--window";
+    argv[n++] = (char*)window;
+    for (int i = 0; i < a->nextra; i++) argv[n++] = a->extra[i];
+    argv[n] = NULL;
+
+    int fds[2];
+    if (pipe(fds) != 0) return 0;
+    uint64_t t0 = us_now();
+    pid_t pid = spawn(argv, spec, fds[1], a->timeout_s);
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return 0;
+    }
+    char out[4096];
+    size_t len = 0;
+    ssize_t got;
+    while ((got = read(fds[0], out + len, sizeof(out) - 1 - len)) > 0) {
+        len += (size_t)got;
+        if (len == sizeof(out) - 1) len = 0; /* only the last lines matter */
+    }
+    close(fds[0]);
+    out[len] = '\0';
+    int status;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    double t = (double)(us_now() - t0) / 1e6;
+    r->cpu += cpu_seconds(&ru);
+
+    const char* done = strstr(out, "Transfer complete:");
+    size_t packets = 0, resent = 0;
+    const char* paren = done ? strchr(done, '(') : NULL;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !paren ||
+        sscanf(paren, "(%zu packets, %zu resent", &packets, &resent) != 2 ||
+        !same_file(received, data, a->size)) {
+        return 0;
+    }
+    r->times[r->ok++] = t;
+    r->packets += packets;
+    r->resent += resent;
+    return 1;
+}
+
+static int cmp_double(const void* x, const void* y) {
+    double a = *(const double*)x, b = *(const double*)y;
+    return a < b ? -1 : a > b;
+}
+
+/* Nearest-rank percentile of sorted values */
+static double percentile(const double* v, int n, double p) {
+    int k = (int)(p * n + 0.999999);
+    if (k < 1) k = 1;
+    return v[k - 1];
+}
+
+static void print_header(const Args* a) {
+    if (a->csv) {
+        printf("chunk,window,loss,rtt_ms,runs,failed,goodput_mbps,resent_pct,cpu_s_per_gb,p50_ms,p99_ms\n");
+    } else {
+        printf("%6s %7s %6s %7s %5s %12s %8s %10s %9s %9s\n", "chunk", "window", "loss", "rtt_ms",
+               "fail", "goodput_Mb/s", "resent%", "cpu_s/GB", "p50_ms", "p99_ms");
+    }
+}
+
+static void print_row(const Args* a, const char* chunk, const char* window, const char* loss,
+                      const char* rtt, Result* r) {
+    double total = 0;
+    for (int i = 0; i < r->ok; i++) total += r->times[i];
+    qsort(r->times, (size_t)r->ok, sizeof(double), cmp_double);
+    double bytes = (double)a->size * r->ok;
+    double goodput = total > 0 ? bytes * 8 / total / 1e6 : 0;
+    double resent = r->packets ? 100.0 * (double)r->resent / (double)(r->packets + r->resent) : 0;
+    double cpu = bytes > 0 ? r->cpu / (bytes / 1e9) : 0;
+    double p50 = r->ok ? percentile(r->times, r->ok, 0.50) * 1e3 : 0;
+    double p99 = r->ok ? percentile(r->times, r->ok, 0.99) * 1e3 : 0;
+    if (a->csv) {
+        printf("%s,%s,%s,%s,%d,%d,%.1f,%.2f,%.2f,%.1f,%.1f\n", chunk, window, loss, rtt,
+               r->ok + r->failed, r->failed, goodput, resent, cpu, p50, p99);
+    } else {
+        printf("%6s %7s %6s %7s %5d %12.1f %8.2f %10.2f %9.1f %9.1f\n", chunk, window, loss, rtt,
+               r->failed, goodput, resent, cpu, p50, p99);
+    }
+    fflush(stdout);
+}
+
+/* One sweep point: a fresh server, --runs transfers, then its CPU time */
+static void run_point(const Args* a, int port, const char* chunk, const char* window,
+                      const char* loss, const char* rtt, const char* dir, const char* file,
+                      const uint8_t* data) {
+    Result* r = calloc(1, sizeof(Result));
+    char spec[512];
+    if (!r) return;
+    if (!point_spec(a, loss, rtt, spec, sizeof(spec))) {
+        fprintf(stderr, "Bad impairment for loss %s, rtt %s: %s\n", loss, rtt, spec);
+        free(r);
+        return;
+    }
+    char server[1100], outdir[1100], received[1200], portstr[16];
+    snprintf(server, sizeof(server), "%s/server", a->bin);
+    snprintf(outdir, sizeof(outdir), "%s/out", dir);
+    snprintf(received, sizeof(received), "%s/%s", outdir, strrchr(file, '/') + 1);
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    char* argv[] = { server, "--port", portstr, "--out", outdir, "--window", (char*)window, NULL };
+    pid_t sp = spawn(argv, spec, -1, 0);
+    if (sp < 0) {
+        free(r);
+        return;
+    }
+    usleep(200000); /* let it bind */
+
+    for (int i = 0; i < a->runs; i++) {
+        if (!run_client(a, spec, portstr, chunk, window, file, received, data, r)) r->failed++;
+        remove(received);
+    }
+
+    kill(sp, SIGTERM);
+    int status;
+    struct rusage ru;
+    wait4(sp, &status, 0, &ru);
+    r->cpu += cpu_seconds(&ru);
+    print_row(a, chunk, window, loss, rtt, r);
+    free(r);
+}
+
+int main(int argc, char** argv) {
+    Args args;
+    if (!parse_args(argc, argv, &args)) return 1;
+
+    char dir[] = "/tmp/ruft_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Cannot create a scratch directory: %s\n", strerror(errno));
+        return 1;
+    }
+    char file[64], outdir[64];
+    snprintf(file, sizeof(file), "%s/bench.bin", dir);
+    snprintf(outdir, sizeof(outdir), "%s/out", dir);
+    MKDIR(outdir);
+
+    /* Incompressible contents, the same on every run */
+    uint8_t* data = malloc(args.size);
+    FILE* f = data ? fopen(file, "wb") : NULL;
+    if (!f) {
+        fprintf(stderr, "Cannot create the %llu-byte test file\n", (unsigned long long)args.size);
+        free(data);
+        rmdir(outdir);
+        rmdir(dir);
+        return 1;
+    }
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (uint64_t i = 0; i < args.size; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    int written = fwrite(data, 1, args.size, f) == args.size;
+    if (fclose(f) != 0 || !written) {
+        fprintf(stderr, "Cannot write the test file\n");
+        free(data);
+        remove(file);
+        rmdir(outdir);
+        rmdir(dir);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    print_header(&args);
+    int port = args.port;
+    for (int c = 0; c < args.nchunks; c++)
+        for (int w = 0; w < args.nwindows; w++)
+            for (int l = 0; l < args.nlosses; l++)
+                for (int r = 0; r < args.nrtts; r++) {
+                    run_point(&args, port++, args.chunks[c], args.windows[w], args.losses[l],
+                              args.rtts[r], dir, file, data);
+                }
+
+    free(data);
+    remove(file);
+    rmdir(outdir);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../common/platform.h"
+#include "../common/protocol.h"
+#include "../common/crc32.h"
+#include "../common/digest.h"
+#include "../common/hashmap.h"
+#include "../common/util.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RU_HAVE_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define RU_HAVE_TSC 1
+#endif
+
+/* Microbenchmarks for the per-packet hot paths: header pack/unpack with and
+ * without copying, ru_crc32 over payload sizes (next to the portable
+ * slicing-by-8 fallback) and the chunk digest, the server's session lookup
+ * as the table grows, and handshake option encode/parse. Each case runs for
+ * --time-ms after a warm-up and reports ns per operation and, where there
+ * is a payload, cycles per byte. Cycles come from the TSC on x86 and from
+ * --ghz times the elapsed time elsewhere. */
+
+#define DEFAULT_TIME_MS 200
+#define MAX_SESSIONS 10000
+
+typedef struct {
+    int time_ms;
+    double ghz;                 /* clock for cycles where there is no TSC, 0 = unknown */
+    const char* filter;         /* run only cases whose name contains this */
+    int csv;
+} Args;
+
+/* Keeps results live so the compiler cannot drop the work */
+static volatile uint64_t sink;
+
+static uint64_t cycles_now(void) {
+#ifdef RU_HAVE_TSC
+    return (uint64_t)__rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef void (*BenchFn)(void* ctx, size_t iters);
+
+static const Args* args;
+
+/* Runs fn for about --time-ms and reports the per-operation cost */
+static void measure(const char* name, size_t bytes, BenchFn fn, void* ctx) {
+    if (args->filter && !strstr(name, args->filter)) return;
+    size_t iters = 1;
+    uint64_t budget = (uint64_t)args->time_ms * 1000;
+    fn(ctx, 1000); /* warm caches, branch predictors and the CPU clock */
+    for (;;) {
+        uint64_t c0 = cycles_now();
+        uint64_t t0 = us_now();
+        fn(ctx, iters);
+        uint64_t us = us_now() - t0;
+        uint64_t cyc = cycles_now() - c0;
+        if (us >= budget || iters >= ((size_t)1 << 40)) {
+            double ns = (double)us * 1e3 / (double)iters;
+            double cycles = cyc ? (double)cyc / (double)iters : ns * args->ghz;
+            double gbps = bytes && ns > 0 ? (double)bytes / ns : 0;
+            if (args->csv) {
+                printf("%s,%zu,%.2f,%.3f,%.2f\n", name, bytes, ns,
+                       bytes && cycles > 0 ? cycles / (double)bytes : 0, gbps);
+            } else if (bytes && cycles > 0) {
+                printf("%-28s %8zu %12.2f %12.3f %10.2f\n", name, bytes, ns, cycles / (double)bytes, gbps);
+            } else if (bytes) {
+                printf("%-28s %8zu %12.2f %12s %10.2f\n", name, bytes, ns, "-", gbps);
+            } else {
+                printf("%-28s %8s %12.2f %12s %10s\n", name, "-", ns, "-", "-");
+            }
+            fflush(stdout);
+            return;
+        }
+        /* Aim straight for the budget once a run is long enough to time */
+        iters = us > 1000 ? (size_t)((double)iters * (double)budget / (double)us) + 1 : iters * 10;
+    }
+}
+
+/* ---- pack / unpack ---- */
+
+typedef struct {
+    Packet p;
+    uint8_t* wire;
+    size_t len;
+    uint8_t* out;
+} PackCtx;
+
+static void bench_pack_into(void* ctx, size_t iters) {
+    PackCtx* c = ctx;
+    for (size_t i = 0; i < iters; i++) {
+        c->p.seq = (uint32_t)i;
+        sink += pack_into(c->out, HEADER_SIZE + c->p.payload_size, &c->p);
+    }
+}
+
+static void bench_pack_alloc(void* ctx, size_t iters) {
+    PackCtx* c = ctx;
+    for (size_t i = 0; i < iters; i++) {
+        size_t n;
+        c->p.seq = (uint32_t)i;
+        uint8_t* b = pack(&c->p, &n);
+        sink += n + (b ? b[4] : 0);
+        free(b);
+    }
+}
+
+static void bench_unpack_view(void* ctx, size_t iters) {
+    PackCtx* c = ctx;
+    Packet p;
+    for (size_t i = 0; i < iters; i++) {
+        sink += (uint64_t)unpack_view(c->wire, c->len, &p) + p.seq + p.payload_size;
+    }
+}
+
+static void bench_unpack_alloc(void* ctx, size_t iters) {
+    PackCtx* c = ctx;
+    Packet p;
+    for (size_t i = 0; i < iters; i++) {
+        if (unpack(c->wire, c->len, &p) == 0) {
+            sink += p.seq + p.payload[0];
+            free_packet(&p);
+        }
+    }
+}
+
+/* A received DATA packet as the server handles it: header plus CRC check */
+static void bench_unpack_verify(void* ctx, size_t iters) {
+    PackCtx* c = ctx;
+    Packet p;
+    for (size_t i = 0; i < iters; i++) {
+        if (unpack_view(c->wire, c->len, &p) == 0) {
+            sink += ru_crc32(p.payload, p.payload_size) == p.checksum;
+        }
+    }
+}
+
+static void run_codec(uint8_t* payload, size_t payload_len) {
+    PackCtx c;
+    memset(&c, 0, sizeof(c));
+    c.p.magic0 = 'R';
+    c.p.magic1 = 'U';
+    c.p.version = VERSION;
+    c.p.ptype = PT_DATA;
+    c.p.total = 100000;
+    c.p.stream = 1;
+    c.p.payload = payload;
+    c.p.payload_size = payload_len;
+    c.p.checksum = ru_crc32(payload, payload_len);
+    c.wire = malloc(HEADER_SIZE + payload_len);
+    c.out = malloc(HEADER_SIZE + payload_len);
+    if (!c.wire || !c.out) {
+        free(c.wire);
+        free(c.out);
+        return;
+    }
+    c.len = pack_into(c.wire, HEADER_SIZE + payload_len, &c.p);
+    size_t bytes = HEADER_SIZE + payload_len;
+
+    char name[64];
+    snprintf(name, sizeof(name), "pack_into/%zu", payload_len);
+    measure(name, bytes, bench_pack_into, &c);
+    snprintf(name, sizeof(name), "pack (malloc)/%zu", payload_len);
+    measure(name, bytes, bench_pack_alloc, &c);
+    snprintf(name, sizeof(name), "unpack_view/%zu", payload_len);
+    measure(name, bytes, bench_unpack_view, &c);
+    snprintf(name, sizeof(name), "unpack (copy)/%zu", payload_len);
+    measure(name, bytes, bench_unpack_alloc, &c);
+    snprintf(name, sizeof(name), "unpack_view+crc/%zu", payload_len);
+    measure(name, bytes, bench_unpack_verify, &c);
+    free(c.wire);
+    free(c.out);
+}
+
+/* ---- CRC ---- */
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+} CrcCtx;
+
+static void bench_crc(void* ctx, size_t iters) {
+    CrcCtx* c = ctx;
+    for (size_t i = 0; i < iters; i++) sink += ru_crc32(c->data, c->len);
+}
+
+static void bench_crc_portable(void* ctx, size_t iters) {
+    CrcCtx* c = ctx;
+    for (size_t i = 0; i < iters; i++) sink += ru_crc32_portable(c->data, c->len);
+}
+
+static void bench_digest(void* ctx, size_t iters) {
+    CrcCtx* c = ctx;
+    for (size_t i = 0; i < iters; i++) sink += digest_chunk(c->data, c->len, i);
+}
+
+static void run_crc(const uint8_t* data) {
+    static const size_t sizes[] = { 64, 512, 1400, 8192, 65536 };
+    char name[64];
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        CrcCtx c = { data, sizes[i] };
+        snprintf(name, sizeof(name), "crc32 %s/%zu", ru_crc32_impl(), sizes[i]);
+        measure(name, sizes[i], bench_crc, &c);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        CrcCtx c = { data, sizes[i] };
+        snprintf(name, sizeof(name), "crc32 portable/%zu", sizes[i]);
+        measure(name, sizes[i], bench_crc_portable, &c);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        CrcCtx c = { data, sizes[i] };
+        snprintf(name, sizeof(name), "digest xxh64/%zu", sizes[i]);
+        measure(name, sizes[i], bench_digest, &c);
+    }
+}
+
+/* ---- session lookup ---- */
+
+typedef struct {
+    HashMap map;
+    uint64_t* keys;
+    uint64_t* order;            /* the keys shuffled, so lookups jump around */
+    size_t n;
+} LookupCtx;
+
+/* Session keys as the server packs them: IPv4 address, port, stream. Many
+ * sessions share an address and differ only in the low bits. */
+static uint64_t make_key(size_t i) {
+    uint64_t ip = 0x0A000001u + (uint64_t)(i / 64);
+    uint64_t port = 40000 + i % 64;
+    return (((ip << 16) | port) << 16) | 1;
+}
+
+static void bench_lookup_hit(void* ctx, size_t iters) {
+    LookupCtx* c = ctx;
+    size_t j = 0;
+    for (size_t i = 0; i < iters; i++) {
+        sink += (uintptr_t)hmap_get(&c->map, c->order[j]);
+        if (++j == c->n) j = 0;
+    }
+}
+
+static void bench_lookup_miss(void* ctx, size_t iters) {
+    LookupCtx* c = ctx;
+    size_t j = 0;
+    for (size_t i = 0; i < iters; i++) {
+        sink += (uintptr_t)hmap_get(&c->map, c->order[j] ^ ((uint64_t)0xFFFF << 16));
+        if (++j == c->n) j = 0;
+    }
+}
+
+static void run_lookup(void) {
+    static const size_t counts[] = { 10, 100, 1000, MAX_SESSIONS };
+    LookupCtx c;
+    c.keys = malloc(MAX_SESSIONS * sizeof(uint64_t));
+    c.order = malloc(MAX_SESSIONS * sizeof(uint64_t));
+    if (!c.keys || !c.order) {
+        free(c.keys);
+        free(c.order);
+        return;
+    }
+    char name[64];
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+        if (!hmap_init(&c.map, 16)) break;
+        c.n = counts[k];
+        for (size_t i = 0; i < c.n; i++) {
+            c.keys[i] = make_key(i);
+            hmap_put(&c.map, c.keys[i], &c.keys[i]);
+            c.order[i] = c.keys[i];
+        }
+        uint32_t x = 88172645u;
+        for (size_t i = c.n - 1; i > 0; i--) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            size_t r = x % (i + 1);
+            uint64_t t = c.order[i];
+            c.order[i] = c.order[r];
+            c.order[r] = t;
+        }
+        snprintf(name, sizeof(name), "session lookup/%zu", c.n);
+        measure(name, 0, bench_lookup_hit, &c);
+        snprintf(name, sizeof(name), "session miss/%zu", c.n);
+        measure(name, 0, bench_lookup_miss, &c);
+        hmap_free(&c.map);
+    }
+    free(c.keys);
+    free(c.order);
+}
+
+/* ---- handshake ---- */
+
+typedef struct {
+    Handshake hs;
+    uint8_t opts[1024];
+    size_t len;
+} HsCtx;
+
+static void bench_hs_encode(void* ctx, size_t iters) {
+    HsCtx* c = ctx;
+    uint8_t out[1024];
+    for (size_t i = 0; i < iters; i++) sink += hs_encode(out, sizeof(out), &c->hs) + out[3];
+}
+
+static void bench_hs_parse(void* ctx, size_t iters) {
+    HsCtx* c = ctx;
+    Handshake hs;
+    for (size_t i = 0; i < iters; i++) sink += (uint64_t)hs_parse(c->opts, c->len, &hs) + hs.size;
+}
+
+static void run_handshake(void) {
+    HsCtx c;
+    memset(&c, 0, sizeof(c));
+    strcpy(c.hs.name, "photos/2026/holiday/IMG_0001.jpg");
+    c.hs.size = 7340032;
+    c.hs.chunk = 1400;
+    c.hs.caps = CAP_RESUME | CAP_COMPRESS;
+    c.hs.id = 0x1234ABCD;
+    c.hs.codecs[c.hs.ncodecs++] = 1;
+    c.len = hs_encode(c.opts, sizeof(c.opts), &c.hs);
+    measure("handshake encode", c.len, bench_hs_encode, &c);
+    measure("handshake parse", c.len, bench_hs_parse, &c);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--time-ms %d] [--ghz <clock>] [--filter <name>] [--csv]\n",
+            prog, DEFAULT_TIME_MS);
+}
+
+int main(int argc, char** argv) {
+    Args a;
+    memset(&a, 0, sizeof(a));
+    a.time_ms = DEFAULT_TIME_MS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--time-ms") == 0 && i+1 < argc) {
+            a.time_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ghz") == 0 && i+1 < argc) {
+            a.ghz = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i+1 < argc) {
+            a.filter = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            a.csv = 1;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (a.time_ms <= 0) a.time_ms = DEFAULT_TIME_MS;
+    args = &a;
+
+    uint8_t* data = malloc(65536);
+    if (!data) return 1;
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < 65536; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = (uint8_t)x;
+    }
+
+    if (a.csv) printf("case,bytes,ns_per_op,cycles_per_byte,gb_per_s\n");
+    else printf("%-28s %8s %12s %12s %10s\n", "case", "bytes", "ns/op", "cycles/byte", "GB/s");
+    run_codec(data, 1400);
+    run_codec(data, 8192);
+    run_crc(data);
+    run_lookup();
+    run_handshake();
+    free(data);
+    return 0;
+}
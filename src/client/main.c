@@ -1,580 +1,1707 @@
-#include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-#include "../common/platform.h"
-#include "../common/protocol.h"
-#include "../common/util.h"
-#include "../common/crc32.h"
-
-
-
-typedef struct {
-    char host[256];
-    int port;
-    char file[1024];
-    size_t chunk;
-    uint16_t window;
-    int timeout_ms;
-    int max_retries;
-} Args;
-
-static void usage(const char* prog) {
-    fprintf(stderr, "Usage: %s --host <host> --port <port> --file <path> "
-            "[--chunk 1024] [--window 8] [--timeout 300] [--max-retries 20]\n", prog);
-}
-
-static int parse_args(int argc, char** argv, Args* args) {
-    /* Initialize defaults */
-    strcpy(args->host, "127.0.0.1");
-    args->port = 9000;
-    args->file[0] = '\0';
-    args->chunk = 1024;
-    args->window = 8;
-    args->timeout_ms = 300;
-    args->max_retries = 20;
-    
-    for (int i = 1; i < argc; i++) {
-        char* a = argv[i];
-        
-        if (strcmp(a, "--host") == 0 && i+1 < argc) {
-            strncpy(args->host, argv[++i], sizeof(args->host) - 1);
-            args->host[sizeof(args->host) - 1] = '\0';
-        } else if (strcmp(a, "--port") == 0 && i+1 < argc) {
-            args->port = atoi(argv[++i]);
-        } else if (strcmp(a, "--file") == 0 && i+1 < argc) {
-            strncpy(args->file, argv[++i], sizeof(args->file) - 1);
-            args->file[sizeof(args->file) - 1] = '\0';
-        } else if (strcmp(a, "--chunk") == 0 && i+1 < argc) {
-            args->chunk = (size_t)atol(argv[++i]);
-        } else if (strcmp(a, "--window") == 0 && i+1 < argc) {
-            args->window = (uint16_t)atoi(argv[++i]);
-        } else if (strcmp(a, "--timeout") == 0 && i+1 < argc) {
-            args->timeout_ms = atoi(argv[++i]);
-        } else if (strcmp(a, "--max-retries") == 0 && i+1 < argc) {
-            args->max_retries = atoi(argv[++i]);
-        } else if (strncmp(a, "--", 2) == 0) {
-            fprintf(stderr, "Unknown flag: %s\n", a);
-            usage(argv[0]);
-            return 0;
-        } else {
-            fprintf(stderr, "Unexpected argument: %s\n", a);
-            usage(argv[0]);
-            return 0;
-        }
-    }
-    
-    if (strlen(args->file) == 0) {
-        fprintf(stderr, "Missing required --file argument\n");
-        usage(argv[0]);
-        return 0;
-    }
-    return 1;
-}
-
-static void cleanup_resources(uint8_t** chunks, size_t total, uint8_t* data, 
-                             SOCKET_TYPE sock, struct addrinfo* res) {
-    if (chunks) {
-        for (size_t i = 0; i < total; i++) {
-            if (chunks[i]) {
-                free(chunks[i]);
-            }
-        }
-        free(chunks);
-    }
-    if (data) free(data);
-    if (sock != INVALID_SOCKET_TYPE) CLOSE_SOCKET(sock);
-    if (res) freeaddrinfo(res);
-}
-
-int main(int argc, char** argv) {
-#ifdef _WIN32
-    // Initialize Winsock
-    WSADATA wsaData;
-    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (result != 0) {
-        fprintf(stderr, "WSAStartup failed: %d\n", result);
-        return 1;
-    }
-#endif
-
-    Args args;
-    if (!parse_args(argc, argv, &args)) {
-#ifdef _WIN32
-
-
-
-        WSACleanup();
-#endif
-        return 1;
-    }
-
-    /* Read file */
-    FILE* fp = fopen(args.file, "rb");
-    if (!fp) {
-        fprintf(stderr, "Cannot open file: %s\n", args.file);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    
-    /* Get file size */
-    fseek(fp, 0, SEEK_END);
-    long filesize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    
-    if (filesize < 0) {
-        fprintf(stderr, "Error getting file size\n");
-        fclose(fp);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    
-    /* Calculate total packets */
-    size_t total = (filesize + args.chunk - 1) / args.chunk;
-    
-    /* Read entire file */
-    uint8_t* data = malloc(filesize);
-    if (!data) {
-        fprintf(stderr, "Memory allocation failed\n");
-        fclose(fp);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    
-    if (fread(data, 1, filesize, fp) != (size_t)filesize) {
-        fprintf(stderr, "Failed to read file\n");
-        free(data);
-        fclose(fp);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    fclose(fp);
-    
-    /* Resolve host */
-    struct addrinfo hints, *res = NULL;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_DGRAM;
-    
-    char port_str[16];
-    snprintf(port_str, sizeof(port_str), "%d", args.port);
-    
-    if (getaddrinfo(args.host, port_str, &hints, &res) != 0) {
-        fprintf(stderr, "Failed to resolve host\n");
-        free(data);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    
-    SOCKET_TYPE sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (sock == INVALID_SOCKET_TYPE) {
-#ifdef _WIN32
-        fprintf(stderr, "socket failed: %d\n", WSAGetLastError());
-        freeaddrinfo(res);
-        free(data);
-        WSACleanup();
-#else
-        fprintf(stderr, "socket failed: %s\n", strerror(errno));
-        freeaddrinfo(res);
-        free(data);
-#endif
-        return 1;
-    }
-
-    /* Non-blocking receive */
-#ifdef _WIN32
-    u_long mode = 1;
-    if (ioctlsocket(sock, FIONBIO, &mode) == SOCKET_ERROR) {
-        fprintf(stderr, "ioctlsocket failed: %d\n", WSAGetLastError());
-        closesocket(sock);
-        freeaddrinfo(res);
-        free(data);
-        WSACleanup();
-        return 1;
-    }
-#else
-    int flags = fcntl(sock, F_GETFL, 0);
-    if (flags == -1) {
-        fprintf(stderr, "fcntl F_GETFL failed: %s\n", strerror(errno));
-        CLOSE_SOCKET(sock);
-        freeaddrinfo(res);
-        free(data);
-        return 1;
-    }
-    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
-        fprintf(stderr, "fcntl F_SETFL failed: %s\n", strerror(errno));
-        CLOSE_SOCKET(sock);
-        freeaddrinfo(res);
-        free(data);
-        return 1;
-    }
-#endif
-
-    char* time_str = now_time();
-    printf("[%s] Client connecting to %s:%d sending %s (%ld bytes, %zu packets)\n",
-           time_str, args.host, args.port, args.file, filesize, total);
-    free(time_str);
-
-    /* HANDSHAKE */
-    Packet hs;
-    memset(&hs, 0, sizeof(hs));
-    hs.magic0 = 'R';
-    hs.magic1 = 'U';
-    hs.version = VERSION;
-    hs.ptype = PT_HANDSHAKE;
-    
-    /* Extract filename */
-    char* fname = strrchr(args.file, '/');
-    if (!fname) fname = strrchr(args.file, '\\');
-    if (!fname) fname = args.file;
-    else fname++; /* Skip the separator */
-    
-    /* Create metadata string */
-    char meta[1024];
-    snprintf(meta, sizeof(meta), "%s|%ld|%zu|%zu|%d",
-             fname, filesize, total, args.chunk, args.window);
-    
-    hs.payload_size = strlen(meta);
-    hs.payload = (uint8_t*)meta;
-    
-    /* Note: meta is a stack variable, so we don't need to free it */
-    
-    size_t packed_size;
-    uint8_t* buf = pack(&hs, &packed_size);
-    if (!buf) {
-        fprintf(stderr, "Failed to pack handshake\n");
-        cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-
-    struct sockaddr_storage peer;
-    memcpy(&peer, res->ai_addr, res->ai_addrlen);
-    int peerlen = (int)res->ai_addrlen;
-
-    int tries = 0;
-    int hs_ackd = 0;
-    while (tries < args.max_retries && !hs_ackd) {
-        sendto(sock, (char*)buf, (int)packed_size, 0, (struct sockaddr*)&peer, peerlen);
-        
-        uint64_t t0 = ms_since(0);
-        while (ms_since(t0) < (uint64_t)args.timeout_ms) {
-            uint8_t rbuf[2048];
-            struct sockaddr_storage from;
-            int fromlen = sizeof(from);
-            int rn = recvfrom(sock, (char*)rbuf, sizeof(rbuf), 0, (struct sockaddr*)&from, &fromlen);
-            if (rn <= 0) {
-#ifdef _WIN32
-                int error = WSAGetLastError();
-                if (error == WSAEWOULDBLOCK) {
-                    Sleep(5); // Windows equivalent of usleep(5000)
-                    continue;
-                }
-#else
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    usleep(5000); // 5ms sleep
-                    continue;
-                }
-#endif
-                continue;
-            }
-            
-            Packet p;
-            if (unpack(rbuf, rn, &p) == 0) {
-                if (p.ptype == PT_HANDSHAKE_ACK) {
-                    hs_ackd = 1;
-                    free_packet(&p);
-                    break;
-                }
-                free_packet(&p);
-            }
-        }
-        tries++;
-    }
-    
-    free(buf);
-    
-    if (!hs_ackd) {
-        fprintf(stderr, "Handshake failed\n");
-        cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 2;
-    }
-    
-    time_str = now_time();
-    printf("[%s] Handshake ACK received\n", time_str);
-    free(time_str);
-
-    /* Prepare chunks */
-    uint8_t** chunks = malloc(total * sizeof(uint8_t*));
-    size_t* chunk_sizes = malloc(total * sizeof(size_t));
-    if (!chunks || !chunk_sizes) {
-        fprintf(stderr, "Memory allocation failed\n");
-        cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    
-    for (size_t i = 0; i < total; i++) {
-        size_t off = i * args.chunk;
-        size_t len = (off + args.chunk > (size_t)filesize) ? (size_t)filesize - off : args.chunk;
-        chunks[i] = malloc(len);
-        if (!chunks[i]) {
-            fprintf(stderr, "Memory allocation failed\n");
-            /* Cleanup */
-            for (size_t j = 0; j < i; j++) {
-                if (chunks[j]) {
-                    free(chunks[j]);
-                }
-            }
-            free(chunks);
-            free(chunk_sizes);
-            cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-            WSACleanup();
-#endif
-            return 1;
-        }
-        memcpy(chunks[i], data + off, len);
-        chunk_sizes[i] = len;
-    }
-
-    size_t base = 0;
-    size_t nextseq = 0;
-    int retries = 0;
-    int timer_running = 0;
-    uint64_t timer_t0 = 0;
-
-    /* Main GBN send loop */
-    while (base < total) {
-        while (nextseq < total && nextseq < base + args.window) {
-            /* Send data packet */
-            Packet d;
-            memset(&d, 0, sizeof(d));
-            d.magic0 = 'R';
-            d.magic1 = 'U';
-            d.version = VERSION;
-            d.ptype = PT_DATA;
-            d.seq = nextseq;
-            d.total = total;
-            d.window = args.window;
-            d.payload = chunks[nextseq];
-            d.payload_size = chunk_sizes[nextseq];
-            
-            size_t d_packed_size;
-            uint8_t* d_buf = pack(&d, &d_packed_size);
-            if (d_buf) {
-                sendto(sock, (char*)d_buf, (int)d_packed_size, 0, (struct sockaddr*)&peer, peerlen);
-                free(d_buf);
-            }
-            
-            if (base == nextseq && !timer_running) {
-                timer_running = 1;
-                timer_t0 = ms_since(0);
-            }
-            nextseq++;
-        }
-
-        /* Receive ACKs (non-blocking) */
-        uint8_t rbuf[2048];
-        struct sockaddr_storage from;
-        int fromlen = sizeof(from);
-        int rn = recvfrom(sock, (char*)rbuf, sizeof(rbuf), 0, (struct sockaddr*)&from, &fromlen);
-        if (rn > 0) {
-            Packet p;
-            if (unpack(rbuf, rn, &p) == 0) {
-                if (p.ptype == PT_ACK) {
-                    if (p.seq >= base) {
-                        /* Move base forward */
-                        size_t old_base = base;
-                        base = p.seq + 1;
-                        
-                        /* Free chunks we no longer need */
-                        for (size_t s = old_base; s < base; s++) {
-                            free(chunks[s]);
-                            chunks[s] = NULL; /* Mark as freed */
-                        }
-                        
-                        if (base == nextseq) {
-                            timer_running = 0;
-                        } else {
-                            timer_running = 1;
-                            timer_t0 = ms_since(0);
-                        }
-                    }
-                }
-                free_packet(&p);
-            }
-        }
-        
-        /* Check timeout */
-        if (timer_running && ms_since(timer_t0) > (uint64_t)args.timeout_ms) {
-            /* Timeout - retransmit from base */
-            timer_running = 0;
-            retries++;
-            
-            if (retries > args.max_retries) {
-                fprintf(stderr, "Max retries exceeded\n");
-                /* Cleanup */
-                for (size_t i = 0; i < total; i++) {
-                    if (chunks[i]) {
-                        free(chunks[i]);
-                    }
-                }
-                free(chunks);
-                free(chunk_sizes);
-                cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-                WSACleanup();
-#endif
-                return 3;
-            }
-            
-            /* Retransmit all packets in window */
-            for (size_t s = base; s < nextseq; s++) {
-                if (chunks[s]) {  // Only retransmit if chunk still exists
-                    Packet d;
-                    memset(&d, 0, sizeof(d));
-                    d.magic0 = 'R';
-                    d.magic1 = 'U';
-                    d.version = VERSION;
-                    d.ptype = PT_DATA;
-                    d.seq = s;
-                    d.total = total;
-                    d.window = args.window;
-                    d.payload = chunks[s];
-                    d.payload_size = chunk_sizes[s];
-                    
-                    size_t d_packed_size;
-                    uint8_t* d_buf = pack(&d, &d_packed_size);
-                    if (d_buf) {
-                        sendto(sock, (char*)d_buf, (int)d_packed_size, 0, (struct sockaddr*)&peer, peerlen);
-                        free(d_buf);
-                    }
-                }
-            }
-            timer_running = 1;
-            timer_t0 = ms_since(0);
-        }
-    }
-
-    /* FIN */
-    Packet fin;
-    memset(&fin, 0, sizeof(fin));
-    fin.magic0 = 'R';
-    fin.magic1 = 'U';
-    fin.version = VERSION;
-    fin.ptype = PT_FIN;
-    
-    size_t fin_packed_size;
-    uint8_t* bfin = pack(&fin, &fin_packed_size);
-    if (!bfin) {
-        fprintf(stderr, "Failed to pack FIN\n");
-        /* Cleanup */
-        for (size_t i = 0; i < total; i++) {
-            if (chunks[i]) {
-                free(chunks[i]);
-            }
-        }
-        free(chunks);
-        free(chunk_sizes);
-        cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    
-    int fin_ok = 0;
-    tries = 0;
-    while (tries < args.max_retries && !fin_ok) {
-        sendto(sock, (char*)bfin, (int)fin_packed_size, 0, (struct sockaddr*)&peer, peerlen);
-        
-        uint64_t t0 = ms_since(0);
-        while (ms_since(t0) < (uint64_t)args.timeout_ms) {
-            uint8_t rbuf2[2048];
-            struct sockaddr_storage from2;
-            int fromlen2 = sizeof(from2);
-            int rn2 = recvfrom(sock, (char*)rbuf2, sizeof(rbuf2), 0, (struct sockaddr*)&from2, &fromlen2);
-            if (rn2 <= 0) {
-#ifdef _WIN32
-                int error = WSAGetLastError();
-                if (error == WSAEWOULDBLOCK) {
-                    Sleep(5); // Windows equivalent of usleep(5000)
-                    continue;
-                }
-#else
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    usleep(5000); // 5ms sleep
-                    continue;
-                }
-#endif
-                continue;
-            }
-            
-            Packet p;
-            if (unpack(rbuf2, rn2, &p) == 0) {
-                if (p.ptype == PT_FIN_ACK) {
-                    fin_ok = 1;
-                    free_packet(&p);
-                    break;
-                }
-                free_packet(&p);
-            }
-        }
-        tries++;
-    }
-    
-    free(bfin);
-    
-    if (!fin_ok) {
-        fprintf(stderr, "FIN not acknowledged\n");
-        /* Cleanup */
-        for (size_t i = 0; i < total; i++) {
-            if (chunks[i]) {
-                free(chunks[i]);
-            }
-        }
-        free(chunks);
-        free(chunk_sizes);
-        cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 4;
-    }
-
-    time_str = now_time();
-    printf("[%s] Transfer complete (%zu packets)\n", time_str, total);
-    free(time_str);
-    
-    /* Cleanup */
-    for (size_t i = 0; i < total; i++) {
-        if (chunks[i]) {
-            free(chunks[i]);
-        }
-    }
-    free(chunks);
-    free(chunk_sizes);
-    cleanup_resources(NULL, 0, data, sock, res);
-#ifdef _WIN32
-    WSACleanup();
-#endif
-    return 0;
-}
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../common/platform.h"
+#include "../common/protocol.h"
+#include "../common/util.h"
+#include "../common/crc32.h"
+#include "../common/rtt.h"
+#include "../common/cc.h"
+#include "../common/filesrc.h"
+#include "../common/udpio.h"
+#include "../common/evloop.h"
+#include "../common/fec.h"
+#include "../common/compress.h"
+#include "../common/pacer.h"
+#include "../common/slab.h"
+#include "../common/trace.h"
+#include "../common/digest.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#define MAX_PARALLEL 256
+#define MAX_FLOWS EV_MAX_SOCKETS
+#define DEFAULT_CHUNK 1024
+
+typedef struct {
+    const char* hosts[MAX_FLOWS]; /* --host, used round-robin by the flows */
+    int nhosts;
+    const char* binds[MAX_FLOWS]; /* --bind local addresses, likewise */
+    int nbinds;
+    int flows;          /* sockets, each its own 5-tuple */
+    int port;
+    char** files;       /* --file arguments, files or directories */
+    int nfiles;
+    size_t chunk;       /* 0 = --chunk auto, set by path MTU probing */
+    uint16_t window;
+    int timeout_ms;     /* initial retransmission timeout */
+    int min_rto_ms;
+    int max_rto_ms;
+    int max_retries;
+    int parallel;       /* files in flight at once */
+    int fec;            /* parity group shift, -1 = sized to the loss rate, 0 = off */
+    const Codec* codec; /* --compress, NULL = off */
+    double rate;        /* --rate in bytes/s, 0 = paced from cwnd/RTT, < 0 = unpaced */
+    int early;          /* DATA packets sent right behind the handshake, 0 = wait for its ACK */
+    int stats_interval; /* seconds between printed summaries, 0 = none */
+    const char* trace;  /* --trace output file, NULL = off */
+    char cc[16];
+} Args;
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s --host <host> [--host <host> ...] --port <port> --file <path> "
+            "[--file <path> ...] [--chunk 1024|auto] [--window 256] [--timeout 300] [--min-rto 5] "
+            "[--max-rto 60000] [--max-retries 20] [--parallel 8] [--flows 1] [--bind <addr> ...] "
+            "[--fec off|auto|<group size>] [--compress %s] [--rate auto|off|<bits/s>[k|M|G]] "
+            "[--early 0] [--stats-interval 0] [--trace <file>] [--cc %s]\n", prog, codec_names(), cc_names());
+}
+
+static int parse_args(int argc, char** argv, Args* args) {
+    /* Initialize defaults */
+    args->nhosts = 0;
+    args->nbinds = 0;
+    args->flows = 1;
+    args->port = 9000;
+    args->files = NULL;
+    args->nfiles = 0;
+    args->chunk = DEFAULT_CHUNK;
+    args->window = 256;
+    args->timeout_ms = 300;
+    args->min_rto_ms = 5;
+    args->max_rto_ms = 60000;
+    args->max_retries = 20;
+    args->parallel = 8;
+    args->fec = 0;
+    args->codec = NULL;
+    args->rate = 0;
+    args->early = 0;
+    args->stats_interval = 0;
+    args->trace = NULL;
+    strcpy(args->cc, "cubic");
+
+    for (int i = 1; i < argc; i++) {
+        char* a = argv[i];
+
+        if (strcmp(a, "--host") == 0 && i+1 < argc) {
+            if (args->nhosts == MAX_FLOWS) {
+                fprintf(stderr, "At most %d --host addresses\n", MAX_FLOWS);
+                return 0;
+            }
+            args->hosts[args->nhosts++] = argv[++i];
+        } else if (strcmp(a, "--bind") == 0 && i+1 < argc) {
+            if (args->nbinds == MAX_FLOWS) {
+                fprintf(stderr, "At most %d --bind addresses\n", MAX_FLOWS);
+                return 0;
+            }
+            args->binds[args->nbinds++] = argv[++i];
+        } else if (strcmp(a, "--flows") == 0 && i+1 < argc) {
+            args->flows = atoi(argv[++i]);
+        } else if (strcmp(a, "--port") == 0 && i+1 < argc) {
+            args->port = atoi(argv[++i]);
+        } else if (strcmp(a, "--file") == 0 && i+1 < argc) {
+            char** files = realloc(args->files, (size_t)(args->nfiles + 1) * sizeof(char*));
+            if (!files) {
+                fprintf(stderr, "Memory allocation failed\n");
+                return 0;
+            }
+            args->files = files;
+            args->files[args->nfiles++] = argv[++i];
+        } else if (strcmp(a, "--chunk") == 0 && i+1 < argc) {
+            const char* v = argv[++i];
+            args->chunk = strcmp(v, "auto") == 0 ? 0 : (size_t)atol(v);
+            if (args->chunk < MIN_CHUNK && strcmp(v, "auto") != 0) {
+                fprintf(stderr, "--chunk must be at least %d or auto\n", MIN_CHUNK);
+                return 0;
+            }
+        } else if (strcmp(a, "--window") == 0 && i+1 < argc) {
+            args->window = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--timeout") == 0 && i+1 < argc) {
+            args->timeout_ms = atoi(argv[++i]);
+        } else if (strcmp(a, "--min-rto") == 0 && i+1 < argc) {
+            args->min_rto_ms = atoi(argv[++i]);
+        } else if (strcmp(a, "--max-rto") == 0 && i+1 < argc) {
+            args->max_rto_ms = atoi(argv[++i]);
+        } else if (strcmp(a, "--max-retries") == 0 && i+1 < argc) {
+            args->max_retries = atoi(argv[++i]);
+        } else if (strcmp(a, "--parallel") == 0 && i+1 < argc) {
+            args->parallel = atoi(argv[++i]);
+        } else if (strcmp(a, "--early") == 0 && i+1 < argc) {
+            args->early = atoi(argv[++i]);
+            if (args->early < 0) args->early = 0;
+        } else if (strcmp(a, "--stats-interval") == 0 && i+1 < argc) {
+            args->stats_interval = atoi(argv[++i]);
+            if (args->stats_interval < 0) args->stats_interval = 0;
+        } else if (strcmp(a, "--trace") == 0 && i+1 < argc) {
+            args->trace = argv[++i];
+        } else if (strcmp(a, "--fec") == 0 && i+1 < argc) {
+            const char* v = argv[++i];
+            if (strcmp(v, "off") == 0) {
+                args->fec = 0;
+            } else if (strcmp(v, "auto") == 0) {
+                args->fec = -1;
+            } else {
+                int n = atoi(v);
+                args->fec = FEC_MIN_SHIFT;
+                while (args->fec < FEC_MAX_SHIFT && (1 << args->fec) < n) args->fec++;
+                if ((1 << args->fec) != n) {
+                    fprintf(stderr, "--fec group size must be a power of two from %d to %d\n",
+                            1 << FEC_MIN_SHIFT, 1 << FEC_MAX_SHIFT);
+                    return 0;
+                }
+            }
+        } else if (strcmp(a, "--compress") == 0 && i+1 < argc) {
+            const char* v = argv[++i];
+            args->codec = strcmp(v, "off") == 0 ? NULL : codec_find(v);
+            if (!args->codec && strcmp(v, "off") != 0) {
+                fprintf(stderr, "Unknown codec: %s (this build has %s)\n", v, codec_names());
+                return 0;
+            }
+        } else if (strcmp(a, "--rate") == 0 && i+1 < argc) {
+            const char* v = argv[++i];
+            if (strcmp(v, "auto") == 0) {
+                args->rate = 0;
+            } else if (strcmp(v, "off") == 0) {
+                args->rate = -1;
+            } else {
+                char* end;
+                double bits = strtod(v, &end);
+                if (*end == 'k' || *end == 'K') bits *= 1e3, end++;
+                else if (*end == 'M') bits *= 1e6, end++;
+                else if (*end == 'G') bits *= 1e9, end++;
+                if (*end != '\0' || bits <= 0) {
+                    fprintf(stderr, "--rate must be auto, off or bits per second like 800M\n");
+                    return 0;
+                }
+                args->rate = bits / 8;
+            }
+        } else if (strcmp(a, "--cc") == 0 && i+1 < argc) {
+            strncpy(args->cc, argv[++i], sizeof(args->cc) - 1);
+            args->cc[sizeof(args->cc) - 1] = '\0';
+        } else if (strncmp(a, "--", 2) == 0) {
+            fprintf(stderr, "Unknown flag: %s\n", a);
+            usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "Unexpected argument: %s\n", a);
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (!cc_find(args->cc)) {
+        fprintf(stderr, "Unknown congestion control: %s\n", args->cc);
+        usage(argv[0]);
+        return 0;
+    }
+    if (args->window == 0) {
+        fprintf(stderr, "--window must be positive\n");
+        return 0;
+    }
+    if (args->fec && args->codec) {
+        /* parity is taken over raw chunks, the receiver only sees packed ones */
+        fprintf(stderr, "--fec and --compress cannot be combined\n");
+        return 0;
+    }
+    if (args->chunk > MAX_PACKET - HEADER_SIZE) {
+        fprintf(stderr, "--chunk must be at most %d\n", MAX_PACKET - HEADER_SIZE);
+        return 0;
+    }
+    if (args->nhosts == 0) args->hosts[args->nhosts++] = "127.0.0.1";
+    /* Every address given gets at least one flow */
+    if (args->flows < args->nhosts) args->flows = args->nhosts;
+    if (args->flows < args->nbinds) args->flows = args->nbinds;
+    if (args->flows > MAX_FLOWS) {
+        fprintf(stderr, "--flows must be between 1 and %d\n", MAX_FLOWS);
+        return 0;
+    }
+    if (args->parallel < 1 || args->parallel > MAX_PARALLEL) {
+        fprintf(stderr, "--parallel must be between 1 and %d\n", MAX_PARALLEL);
+        return 0;
+    }
+    if (args->nfiles == 0) {
+        fprintf(stderr, "Missing required --file argument\n");
+        usage(argv[0]);
+        return 0;
+    }
+    return 1;
+}
+
+/* Files to send: the local path and the name the server stores it under.
+ * A directory contributes every regular file below it, named by its path
+ * relative to the directory's parent with '/' separators. */
+typedef struct {
+    char** paths;
+    char** names;
+    size_t count;
+    size_t cap;
+} FileList;
+
+static int list_push(FileList* l, const char* path, const char* name) {
+    if (l->count == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 16;
+        char** paths = realloc(l->paths, cap * sizeof(char*));
+        if (!paths) return 0;
+        l->paths = paths;
+        char** names = realloc(l->names, cap * sizeof(char*));
+        if (!names) return 0;
+        l->names = names;
+        l->cap = cap;
+    }
+    char* p = malloc(strlen(path) + 1);
+    char* n = malloc(strlen(name) + 1);
+    if (!p || !n) {
+        free(p);
+        free(n);
+        return 0;
+    }
+    strcpy(p, path);
+    strcpy(n, name);
+    l->paths[l->count] = p;
+    l->names[l->count] = n;
+    l->count++;
+    return 1;
+}
+
+static void list_free(FileList* l) {
+    for (size_t i = 0; i < l->count; i++) {
+        free(l->paths[i]);
+        free(l->names[i]);
+    }
+    free(l->paths);
+    free(l->names);
+    memset(l, 0, sizeof(*l));
+}
+
+static int list_dir(FileList* l, const char* dir, const char* prefix);
+
+/* Adds path under name; directories are walked. Other non-regular files
+ * (FIFOs, sockets, devices) are refused when named on the command line and
+ * skipped inside a directory, as are symlinked directories. */
+static int list_add(FileList* l, const char* path, const char* name, int top) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path, &st) != 0) {
+        fprintf(stderr, "Cannot open file: %s\n", path);
+        return 0;
+    }
+    int is_dir = (st.st_mode & _S_IFDIR) != 0;
+    int is_reg = (st.st_mode & _S_IFREG) != 0;
+#else
+    struct stat st;
+    if (lstat(path, &st) != 0) {
+        fprintf(stderr, "Cannot open file: %s\n", path);
+        return 0;
+    }
+    int linked = S_ISLNK(st.st_mode);
+    if (linked && stat(path, &st) != 0) return 1; /* dangling link */
+    int is_dir = S_ISDIR(st.st_mode) && (!linked || top);
+    int is_reg = S_ISREG(st.st_mode);
+#endif
+    if (is_dir) return list_dir(l, path, name);
+    if (!is_reg) {
+        if (!top) return 1;
+        fprintf(stderr, "Not a regular file: %s\n", path);
+        return 0;
+    }
+    return list_push(l, path, name);
+}
+
+static int list_dir(FileList* l, const char* dir, const char* prefix) {
+    char path[2048], name[1024];
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    snprintf(path, sizeof(path), "%s\\*", dir);
+    HANDLE h = FindFirstFileA(path, &fd);
+    if (h == INVALID_HANDLE_VALUE) return 1; /* empty */
+    int ok = 1;
+    do {
+        const char* e = fd.cFileName;
+        if (strcmp(e, ".") == 0 || strcmp(e, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s\\%s", dir, e);
+        snprintf(name, sizeof(name), "%s%s%s", prefix, prefix[0] ? "/" : "", e);
+        ok = list_add(l, path, name, 0);
+    } while (ok && FindNextFileA(h, &fd));
+    FindClose(h);
+    return ok;
+#else
+    DIR* d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Cannot open directory: %s\n", dir);
+        return 0;
+    }
+    int ok = 1;
+    struct dirent* de;
+    while (ok && (de = readdir(d)) != NULL) {
+        const char* e = de->d_name;
+        if (strcmp(e, ".") == 0 || strcmp(e, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, e);
+        snprintf(name, sizeof(name), "%s%s%s", prefix, prefix[0] ? "/" : "", e);
+        ok = list_add(l, path, name, 0);
+    }
+    closedir(d);
+    return ok;
+#endif
+}
+
+/* Name of a command line path on the server: its last component, or nothing
+ * for "." and the like so a directory's entries land at the top level */
+static void base_name(const char* path, char* out, size_t cap) {
+    size_t end = strlen(path);
+    while (end > 1 && (path[end - 1] == '/' || path[end - 1] == '\\')) end--;
+    size_t start = end;
+    while (start > 0 && path[start - 1] != '/' && path[start - 1] != '\\') start--;
+    size_t len = end - start;
+    if ((len == 1 && path[start] == '.') || (len == 2 && path[start] == '.' && path[start + 1] == '.') ||
+        path[start] == '/' || path[start] == '\\') {
+        len = 0;
+    }
+    if (len >= cap) len = cap - 1;
+    memcpy(out, path + start, len);
+    out[len] = '\0';
+}
+
+/* Per-sequence send state for packets in flight, indexed by seq % window */
+typedef struct {
+    uint64_t sent_us;   /* time of the most recent transmission */
+    uint8_t in_flight;  /* counted in the pipe */
+    uint8_t sacked;     /* receiver reported holding this packet */
+    uint8_t lost;       /* deemed lost, waiting to be resent */
+    uint8_t retx;       /* sent more than once, so not usable as an RTT sample */
+    uint8_t fec;        /* shift of its parity group, kept for resends */
+} SendSlot;
+
+/* Holes with this many selectively acknowledged packets above them are treated
+ * as lost without waiting for the retransmission timer */
+#define DUP_THRESH 3
+
+/* Largest reply we expect: a HANDSHAKE_ACK with resume ranges or a SACK */
+#define SACK_MAX (SACK_RECOVERED_SIZE + SACK_MAX_BYTES)
+#define REPLY_MAX (HEADER_SIZE + (HS_ACK_MAX > SACK_MAX ? HS_ACK_MAX : SACK_MAX))
+
+#define META_MAX 1024
+
+/* --chunk auto: UDP payload sizes to probe, largest first. A 9000-byte
+ * jumbo frame, a 4 KiB frame, Ethernet, then PPPoE, common tunnel overheads
+ * and the IPv6 minimum MTU, each less 28 bytes of IPv4 and UDP header. */
+static const size_t probe_sizes[] = { 8972, 4068, 1472, 1464, 1392, 1232 };
+#define NPROBE_SIZES (sizeof(probe_sizes) / sizeof(probe_sizes[0]))
+#define PROBE_MAX 8972
+#define PROBE_COPIES 2          /* each size is sent twice against random loss */
+#define PROBE_SETTLE_US 5000    /* least wait for larger probes after the first answer */
+#define PROBE_FALLBACK 1472     /* datagram size when the DF bit cannot be set */
+
+/* Files with at least this many chunks per flow are striped over every flow */
+#define STRIPE_MIN_CHUNKS 1024
+
+/* --fec auto: acknowledgments per loss-rate sample, and the starting group
+ * size before there is one */
+#define FEC_SAMPLE 256
+#define FEC_START_SHIFT 4
+
+/* --compress: after this many chunks in a row fail to shrink, the stream
+ * only tries every ZPROBE_EVERY-th one until one does */
+#define ZMISS_MAX 8
+#define ZPROBE_EVERY 16
+
+/* One flow: a socket with its own 5-tuple, so ECMP and bonded links may
+ * hash it onto its own path. Shared by every stream on it: one batch of
+ * outgoing datagrams and one congestion window over the sum of their pipes.
+ * All flows run on one event loop. */
+typedef struct {
+    const Args* args;
+    SOCKET_TYPE sock;
+    struct sockaddr_storage peer;
+    int peerlen;
+    EvLoop* loop;
+    UdpTx tx;
+    UdpRx rx;
+    CcState cc;
+    size_t inflight;        /* packets believed in the network, all streams */
+    uint64_t loss_until;    /* further losses before this belong to the same event */
+    RttEstimator rtt;       /* latest path estimate, seeds new streams */
+    uint16_t next_stream;
+    void* zctx;             /* --compress state and output, made on first use */
+    uint8_t* zbuf;
+    Pacer pacer;            /* spaces out every stream's DATA on this flow */
+    /* Streams and their slot rings are recycled, so a run of many files
+     * allocates only for the most streams ever live at once */
+    Slab senders;
+    Slab slot_rings;        /* window SendSlots each */
+    uint16_t port;          /* local port, names the flow in a --trace */
+    /* For --stats-interval */
+    uint64_t sent_packets;  /* DATA, resends included */
+    uint64_t sent_bytes;
+    uint64_t reported_bytes; /* sent_bytes at the last summary */
+    uint64_t resent;
+    uint64_t timeouts;
+} Conn;
+
+/* One file: a single stream, or one stream per flow when striped */
+typedef struct {
+    const char* path;
+    const char* name;
+    uint64_t size;
+    size_t total;
+    int nstreams;
+    int done;               /* streams finished */
+    int rc;                 /* first failure, 0 = delivered */
+    uint64_t raw_sent;      /* DATA bytes before and after compression */
+    uint64_t wire_sent;
+    size_t resent;          /* DATA packets sent again after a loss */
+} Job;
+
+typedef enum {
+    ST_HANDSHAKE,
+    ST_DATA,
+    ST_FIN,
+    ST_DONE
+} StreamState;
+
+/* Selective-repeat sender for the chunks [lo, hi) of a file: the window of
+ * slots from base to nextseq and the timers that drive it. The handshake and
+ * FIN are resent from ctl until their reply arrives. */
+typedef struct {
+    Conn* c;
+    Job* job;
+    uint16_t id;            /* header stream id */
+    int flow;               /* index within a striped job */
+    const char* path;
+    const char* name;
+    StreamState state;
+    int rc;                 /* exit status once done, 0 = delivered */
+    FileSource src;
+    size_t total;
+    size_t lo;
+    size_t hi;
+    uint16_t window;        /* slot ring size, our upper bound on the window */
+    uint16_t rwnd;          /* receiver's window from its latest SACK */
+    uint16_t rwnd_max;      /* and from the handshake, the most it will offer */
+    int early_fin;          /* a FIN went out behind the early DATA */
+    SendSlot* slots;
+    size_t base;
+    size_t nextseq;
+    size_t nlost;
+    size_t recovery;        /* losses below this seq belong to the current event */
+    int retries;
+    int timer_running;
+    uint64_t timer_t0;
+    RttEstimator rtt;
+    Bitmap skip;            /* chunks the receiver kept from an earlier attempt */
+    /* FEC (fec.h): the XOR of the group being sent and the loss rate the
+     * parity has to cover, counting chunks the receiver rebuilt */
+    int fec;                /* receiver agreed to parity, and its SACKs lead with a rebuilt count */
+    int parity_on;          /* and we have the memory to send it */
+    int fec_shift;          /* size of the next group */
+    int grp_shift;          /* current group's, 0 = sent without parity */
+    size_t grp_start;
+    size_t grp_end;
+    size_t grp_len;         /* longest chunk folded in */
+    uint8_t* parity;
+    double loss_rate;
+    uint32_t delivered;     /* outcomes since the last loss-rate sample */
+    uint32_t missed;
+    uint32_t recovered;     /* receiver's count from the latest SACK */
+    const Codec* codec;     /* receiver accepted compressed chunks */
+    int zmiss;              /* chunks in a row that did not shrink */
+    uint64_t digest;        /* digest.h sum over the chunks below nextseq */
+    int undigested;         /* a chunk could not be read for it, the FIN goes without */
+    uint8_t ctl[HEADER_SIZE + META_MAX]; /* packed HANDSHAKE or FIN awaiting its reply */
+    size_t ctl_len;
+    int ctl_tries;
+    uint64_t ctl_sent;
+} Sender;
+
+static void conn_send(Conn* c, const uint8_t* pkt, size_t len) {
+    uint8_t* out = udp_tx_reserve(&c->tx, len);
+    if (out) {
+        memcpy(out, pkt, len);
+        udp_tx_commit(&c->tx, len, &c->peer, (SOCKLEN_TYPE)c->peerlen);
+    }
+}
+
+/* One window reduction per loss event, however many streams notice it */
+static void conn_on_loss(Conn* c, uint64_t now, int timeout) {
+    if (now < c->loss_until) return;
+    if (timeout) {
+        c->cc.ops->on_timeout(&c->cc, now);
+    } else {
+        c->cc.ops->on_loss(&c->cc, now);
+    }
+    c->loss_until = now + (c->rtt.has_sample ? c->rtt.srtt : rtt_rto(&c->rtt));
+}
+
+static void send_chunk(Sender* sn, size_t seq) {
+    if (seq < sn->base) return; /* already acknowledged */
+    size_t len;
+    const uint8_t* chunk = fsrc_chunk(&sn->src, seq, &len);
+    if (!chunk) {
+        fprintf(stderr, "Failed to read chunk %zu of %s\n", seq, sn->path);
+        return;
+    }
+
+    Packet d;
+    memset(&d, 0, sizeof(d));
+    d.magic0 = 'R';
+    d.magic1 = 'U';
+    d.version = VERSION;
+    d.ptype = PT_DATA;
+    d.seq = (uint32_t)seq;
+    d.total = (uint32_t)sn->total;
+    d.window = sn->window;
+    d.stream = sn->id;
+    d.flags = sn->slots[seq % sn->window].fec;
+    if (sn->state == ST_HANDSHAKE) d.flags |= PF_EARLY;
+    d.payload = (uint8_t*)chunk;
+    d.payload_size = len;
+
+    /* Each chunk is compressed on its own; one that does not shrink goes
+     * out raw, and after a run of those only every ZPROBE_EVERY-th is tried */
+    Conn* c = sn->c;
+    if (sn->codec && (sn->zmiss < ZMISS_MAX || seq % ZPROBE_EVERY == 0)) {
+        size_t n = sn->codec->compress(c->zctx, c->zbuf, len - len / 16, chunk, len);
+        if (n) {
+            d.payload = c->zbuf;
+            d.payload_size = n;
+            d.flags |= PF_COMPRESSED;
+            sn->zmiss = 0;
+        } else {
+            sn->zmiss++;
+        }
+    }
+    if (sn->codec) {
+        sn->job->raw_sent += len;
+        sn->job->wire_sent += d.payload_size;
+    }
+
+    UdpTx* tx = &sn->c->tx;
+    uint8_t* out = udp_tx_reserve(tx, HEADER_SIZE + len);
+    size_t d_packed_size = out ? pack_into(out, HEADER_SIZE + len, &d) : 0;
+    if (d_packed_size) {
+        udp_tx_commit(tx, d_packed_size, &sn->c->peer, (SOCKLEN_TYPE)sn->c->peerlen);
+        pacer_spend(&c->pacer, d_packed_size);
+        c->sent_packets++;
+        c->sent_bytes += d_packed_size;
+        TRACE(TR_PACKET_SENT, PT_DATA | (sn->slots[seq % sn->window].retx ? TRACE_RETX : 0), c->port,
+              sn->id, d.seq, (uint32_t)d.payload_size, d.window, 0);
+    }
+}
+
+static void transmit(Sender* sn, size_t seq, uint64_t now) {
+    SendSlot* sl = &sn->slots[seq % sn->window];
+    send_chunk(sn, seq);
+    sl->sent_us = now;
+    if (!sl->in_flight) {
+        sl->in_flight = 1;
+        sn->c->inflight++;
+    }
+    if (!sn->timer_running) {
+        sn->timer_running = 1;
+        sn->timer_t0 = now;
+    }
+}
+
+static void mark_lost(Sender* sn, SendSlot* sl) {
+    if (sl->lost || sl->sacked) return;
+    if (sl->in_flight) {
+        sl->in_flight = 0;
+        sn->c->inflight--;
+    }
+    sl->lost = 1;
+    sn->nlost++;
+}
+
+/* Opens the parity group at seq when the previous one ended there: the
+ * largest the loss rate allows that still starts at seq. A resumed stream
+ * may start mid-group, which is then sent without parity. */
+static void fec_begin(Sender* sn, size_t seq) {
+    if (seq < sn->grp_end) return;
+    int shift = sn->fec_shift;
+    size_t start, end;
+    fec_group_bounds(seq, shift, sn->lo, sn->hi, &start, &end);
+    while (start != seq && shift > FEC_MIN_SHIFT) {
+        fec_group_bounds(seq, --shift, sn->lo, sn->hi, &start, &end);
+    }
+    sn->grp_shift = start == seq ? shift : 0;
+    sn->grp_start = start;
+    sn->grp_end = end;
+    memset(sn->parity, 0, sn->grp_len);
+    sn->grp_len = 0;
+}
+
+/* Folds a first transmission into the group; after its last chunk the
+ * group's parity goes out */
+static void fec_fold(Sender* sn, size_t seq) {
+    size_t len;
+    const uint8_t* chunk = fsrc_chunk(&sn->src, seq, &len);
+    if (!chunk) {
+        sn->grp_shift = 0;
+        return;
+    }
+    fec_xor(sn->parity, chunk, len);
+    if (len > sn->grp_len) sn->grp_len = len;
+    if (seq + 1 < sn->grp_end) return;
+
+    Packet p;
+    memset(&p, 0, sizeof(p));
+    p.magic0 = 'R';
+    p.magic1 = 'U';
+    p.version = VERSION;
+    p.ptype = PT_PARITY;
+    p.seq = (uint32_t)sn->grp_start;
+    p.total = (uint32_t)sn->total;
+    p.checksum = ru_crc32(sn->parity, sn->grp_len);
+    p.stream = sn->id;
+    p.flags = (uint8_t)sn->grp_shift;
+    p.payload = sn->parity;
+    p.payload_size = sn->grp_len;
+
+    UdpTx* tx = &sn->c->tx;
+    uint8_t* out = udp_tx_reserve(tx, HEADER_SIZE + sn->grp_len);
+    size_t n = out ? pack_into(out, HEADER_SIZE + sn->grp_len, &p) : 0;
+    if (n) {
+        udp_tx_commit(tx, n, &sn->c->peer, (SOCKLEN_TYPE)sn->c->peerlen);
+        pacer_spend(&sn->c->pacer, n);
+        TRACE(TR_PACKET_SENT, PT_PARITY, sn->c->port, sn->id, p.seq, (uint32_t)sn->grp_len, 0, 0);
+    }
+}
+
+/* Tracks the loss rate before parity repair, losses still marked plus
+ * chunks the receiver rebuilt, and with --fec auto sizes later groups to it */
+static void fec_on_sack(Sender* sn, uint32_t recovered, uint32_t acked, uint32_t lost) {
+    uint32_t rebuilt = 0;
+    if ((int32_t)(recovered - sn->recovered) > 0) { /* reordered SACKs may run behind */
+        rebuilt = recovered - sn->recovered;
+        sn->recovered = recovered;
+    }
+    sn->delivered += acked;
+    sn->missed += lost + rebuilt;
+    if (sn->delivered + sn->missed < FEC_SAMPLE) return;
+    double rate = (double)sn->missed / (double)(sn->delivered + sn->missed);
+    sn->loss_rate = sn->loss_rate * 0.75 + rate * 0.25;
+    sn->delivered = 0;
+    sn->missed = 0;
+    if (sn->c->args->fec < 0) sn->fec_shift = fec_shift_for_loss(sn->loss_rate);
+}
+
+/* Adds chunk seq to the FIN's digest, once, as nextseq passes it */
+static void digest_fold(Sender* sn, size_t seq) {
+    size_t len;
+    const uint8_t* chunk = fsrc_chunk(&sn->src, seq, &len);
+    if (chunk) sn->digest += digest_chunk(chunk, len, seq);
+    else sn->undigested = 1;
+}
+
+/* Whether the stream has packets the congestion window would let out now */
+static int sender_wants_send(const Sender* sn) {
+    if (sn->state != ST_DATA || sn->c->inflight >= cc_window(&sn->c->cc)) return 0;
+    size_t limit = sn->window < sn->rwnd ? sn->window : sn->rwnd;
+    return sn->nlost > 0 || (sn->nextseq < sn->hi && sn->nextseq < sn->base + limit);
+}
+
+/* Send as much as the shared congestion window and the pacer allow: lost
+ * packets first, then new data, never past what the receiver or our slot
+ * ring can hold. */
+static void sender_fill(Sender* sn, uint64_t now) {
+    Conn* c = sn->c;
+    size_t limit = sn->window < sn->rwnd ? sn->window : sn->rwnd;
+    size_t cwnd = cc_window(&c->cc);
+
+    for (size_t s = sn->base; sn->nlost > 0 && s < sn->nextseq && c->inflight < cwnd &&
+                              pacer_ready(&c->pacer, now); s++) {
+        SendSlot* sl = &sn->slots[s % sn->window];
+        if (sl->lost) {
+            sl->lost = 0;
+            sl->retx = 1;
+            sn->nlost--;
+            sn->job->resent++;
+            c->resent++;
+            transmit(sn, s, now);
+        }
+    }
+
+    while (sn->nextseq < sn->hi && sn->nextseq < sn->base + limit && c->inflight < cwnd &&
+           pacer_ready(&c->pacer, now)) {
+        SendSlot* sl = &sn->slots[sn->nextseq % sn->window];
+        memset(sl, 0, sizeof(SendSlot));
+        if (sn->parity_on) fec_begin(sn, sn->nextseq);
+        digest_fold(sn, sn->nextseq);
+        if (bm_test(&sn->skip, sn->nextseq)) {
+            /* Resumed: the receiver already has it, treat it as SACKed */
+            sl->sacked = 1;
+            sn->grp_shift = 0;
+            sn->nextseq++;
+            continue;
+        }
+        sl->fec = (uint8_t)sn->grp_shift;
+        transmit(sn, sn->nextseq, now);
+        if (sl->fec) fec_fold(sn, sn->nextseq);
+        sn->nextseq++;
+    }
+}
+
+static void sender_on_sack(Sender* sn, const Packet* sack) {
+    Packet view = *sack;
+    const Packet* p = &view;
+    uint32_t recovered = 0;
+    if (sn->fec && !sack_take_recovered(&view, &recovered)) return;
+    if (p->seq > sn->nextseq) return;
+    /* The live window counts from p->seq; an older server sends 0 and
+     * keeps the handshake's. A SACK overtaken by a newer one is stale. */
+    if (p->window && p->seq >= sn->base) sn->rwnd = p->window;
+
+    Conn* c = sn->c;
+    uint64_t now = us_now();
+    uint64_t newest_sent = 0; /* newest never-resent packet this ACK covers */
+    uint32_t acked = 0;
+
+    if (p->seq > sn->base) {
+        /* Move base forward; the source may drop what is acknowledged */
+        for (size_t s = sn->base; s < p->seq; s++) {
+            SendSlot* sl = &sn->slots[s % sn->window];
+            if (!sl->sacked) {
+                acked++;
+                if (!sl->retx && sl->sent_us > newest_sent) newest_sent = sl->sent_us;
+            }
+            if (sl->in_flight) c->inflight--;
+            if (sl->lost) sn->nlost--;
+        }
+        sn->base = p->seq;
+        fsrc_release(&sn->src, sn->base);
+        sn->retries = 0;
+        rtt_progress(&sn->rtt);
+
+        if (sn->base == sn->nextseq) {
+            sn->timer_running = 0;
+        } else {
+            sn->timer_running = 1;
+            sn->timer_t0 = now;
+        }
+    }
+
+    /* Walk the window top-down so we know how many packets the receiver holds
+     * above each hole; a hole with DUP_THRESH of them is deemed lost. */
+    size_t above = 0;
+    int loss = 0;
+    uint32_t newly_lost = 0;
+    for (size_t s = sn->nextseq; s-- > sn->base; ) {
+        SendSlot* sl = &sn->slots[s % sn->window];
+        if (!sl->sacked && sack_has(p, (uint32_t)s)) {
+            if (sl->in_flight) {
+                sl->in_flight = 0;
+                c->inflight--;
+            }
+            if (sl->lost) {
+                sl->lost = 0;
+                sn->nlost--;
+            }
+            sl->sacked = 1;
+            acked++;
+            if (!sl->retx && sl->sent_us > newest_sent) newest_sent = sl->sent_us;
+        }
+        if (sl->sacked) {
+            above++;
+        } else if (above >= DUP_THRESH && !sl->retx && !sl->lost) {
+            mark_lost(sn, sl);
+            newly_lost++;
+            TRACE(TR_PACKET_LOST, TL_REORDER, c->port, sn->id, (uint32_t)s, 0, 0, 0);
+            if (s >= sn->recovery) loss = 1;
+        }
+    }
+
+    uint64_t sample = 0;
+    if (newest_sent) {
+        sample = now - newest_sent;
+        rtt_sample(&sn->rtt, sample);
+        rtt_sample(&c->rtt, sample);
+    }
+    if (sn->parity_on) fec_on_sack(sn, recovered, acked, newly_lost);
+    if (loss) {
+        sn->recovery = sn->nextseq;
+        conn_on_loss(c, now, 0);
+    } else if (acked) {
+        c->cc.ops->on_ack(&c->cc, acked, sample, now);
+    }
+    TRACE(TR_PACKETS_ACKED, 0, c->port, sn->id, (uint32_t)sn->base, acked, 0, sample);
+    TRACE(TR_METRICS, 0, c->port, sn->id, (uint32_t)c->inflight, cc_window(&c->cc), 0, c->rtt.srtt);
+}
+
+static void sender_free(Sender* sn) {
+    if (sn->slots) {
+        /* Whatever is still in flight no longer counts against the window */
+        for (size_t s = sn->base; s < sn->nextseq; s++) {
+            if (sn->slots[s % sn->window].in_flight) sn->c->inflight--;
+        }
+    }
+    slab_free(&sn->c->slot_rings, sn->slots);
+    free(sn->parity);
+    bm_free(&sn->skip);
+    fsrc_close(&sn->src);
+    slab_free(&sn->c->senders, sn);
+}
+
+static int sender_timed_out(const Sender* sn, uint64_t now) {
+    return sn->timer_running && now - sn->timer_t0 >= rtt_rto(&sn->rtt);
+}
+
+/* Retransmission timeout: back off, collapse the window and queue for
+ * resending the oldest unacknowledged packet and any sent at least an srtt
+ * ago. Younger packets cannot have been acknowledged yet; the next SACK or
+ * timeout decides them. */
+static void sender_on_timeout(Sender* sn, uint64_t now) {
+    sn->retries++;
+    sn->c->timeouts++;
+    TRACE(TR_TIMER_EXPIRED, 0, sn->c->port, sn->id, (uint32_t)sn->base,
+          (uint32_t)(sn->nextseq - sn->base), 0, rtt_rto(&sn->rtt));
+    rtt_backoff(&sn->rtt);
+    uint64_t srtt = sn->rtt.srtt;
+    int oldest = 1, young = 0;
+    for (size_t s = sn->base; s < sn->nextseq; s++) {
+        SendSlot* sl = &sn->slots[s % sn->window];
+        if (sl->sacked) continue;
+        if (oldest || now - sl->sent_us >= srtt) mark_lost(sn, sl);
+        else young = 1;
+        oldest = 0;
+    }
+    sn->recovery = sn->nextseq;
+    conn_on_loss(sn->c, now, 1);
+    /* Packets left in flight may hold the collapsed window shut, so the
+     * resends wait on them: keep timing them rather than stall */
+    sn->timer_running = young;
+    sn->timer_t0 = now;
+}
+
+/* Content fingerprint for resuming: CRC-32 over the size and RESUME_SAMPLES
+ * evenly spaced 4 KiB samples, cheap even for huge files. It only guards
+ * against resuming onto a different file of the same name and size. Returns
+ * 0 when the file cannot be sampled. */
+#define RESUME_SAMPLES 16
+#define RESUME_SAMPLE_BYTES 4096
+
+static int content_id(const char* path, uint64_t size, uint32_t* id) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    uint8_t* buf = malloc(8 + RESUME_SAMPLES * RESUME_SAMPLE_BYTES);
+    if (!buf) {
+        fclose(f);
+        return 0;
+    }
+    for (int i = 0; i < 8; i++) buf[i] = (uint8_t)(size >> (8 * i));
+    size_t n = 8;
+    int ok = 1;
+    for (int i = 0; i < RESUME_SAMPLES && ok; i++) {
+        uint64_t span = size > RESUME_SAMPLE_BYTES ? size - RESUME_SAMPLE_BYTES : 0;
+        uint64_t off = span * (uint64_t)i / (RESUME_SAMPLES - 1);
+#ifdef _WIN32
+        ok = _fseeki64(f, (long long)off, SEEK_SET) == 0;
+#else
+        ok = fseeko(f, (off_t)off, SEEK_SET) == 0;
+#endif
+        if (ok) n += fread(buf + n, 1, RESUME_SAMPLE_BYTES, f);
+    }
+    if (ok) *id = ru_crc32(buf, n);
+    free(buf);
+    fclose(f);
+    return ok;
+}
+
+/* Packs a control packet into sn->ctl and sends it; the main loop resends
+ * it on every RTO until the reply arrives */
+static int sender_send_ctl(Sender* sn, uint8_t ptype, const uint8_t* payload, size_t len,
+                           uint64_t now) {
+    Packet p;
+    memset(&p, 0, sizeof(p));
+    p.magic0 = 'R';
+    p.magic1 = 'U';
+    p.version = VERSION;
+    p.ptype = ptype;
+    p.stream = sn->id;
+    p.total = (uint32_t)sn->total;
+    p.window = sn->window;
+    p.payload = (uint8_t*)payload;
+    p.payload_size = len;
+
+    sn->ctl_len = pack_into(sn->ctl, sizeof(sn->ctl), &p);
+    if (!sn->ctl_len) return 0;
+    sn->ctl_tries = 1;
+    sn->ctl_sent = now;
+    conn_send(sn->c, sn->ctl, sn->ctl_len);
+    TRACE(TR_PACKET_SENT, ptype, sn->c->port, sn->id, 0, (uint32_t)len, p.window, 0);
+    return 1;
+}
+
+static void sender_finish(Sender* sn, int rc) {
+    sn->state = ST_DONE;
+    sn->rc = rc;
+}
+
+/* --early: the first packets go out right behind the handshake, raw and
+ * without parity since the options are not agreed yet. A server that has
+ * the session by then takes them like any DATA, one that does not drops
+ * them quietly and they are resent as lost. If that was the whole stream a
+ * FIN follows as well; the server only acts on it once it holds every
+ * chunk, so a small file can be done in one round trip. */
+static void sender_send_early(Sender* sn, uint64_t now) {
+    sn->slots = slab_alloc(&sn->c->slot_rings);
+    if (!sn->slots) return; /* the ACK tries again */
+    sn->base = sn->nextseq = sn->lo;
+    sn->rwnd = sn->window < sn->c->args->early ? sn->window : (uint16_t)sn->c->args->early;
+    sender_fill(sn, now);
+    if (sn->nextseq < sn->hi) return;
+
+    Packet p;
+    memset(&p, 0, sizeof(p));
+    p.magic0 = 'R';
+    p.magic1 = 'U';
+    p.version = VERSION;
+    p.ptype = PT_FIN;
+    p.stream = sn->id;
+    p.total = (uint32_t)sn->total;
+    p.flags = PF_EARLY;
+    uint8_t digest[FIN_DIGEST_SIZE];
+    put_be64(digest, sn->digest);
+    if (!sn->undigested) {
+        p.payload = digest;
+        p.payload_size = sizeof(digest);
+    }
+    uint8_t fin[HEADER_SIZE + FIN_DIGEST_SIZE];
+    size_t n = pack_into(fin, sizeof(fin), &p);
+    if (n) {
+        conn_send(sn->c, fin, n);
+        TRACE(TR_PACKET_SENT, PT_FIN, sn->c->port, sn->id, 0, (uint32_t)p.payload_size, 0, 0);
+        sn->early_fin = 1;
+    }
+}
+
+/* A new stream for chunks [lo, hi) of the job's file, sending its handshake
+ * with the hs options. The file is opened per stream so each reads at its
+ * own pace. */
+static Sender* sender_start(Conn* c, Job* job, int flow, size_t lo, size_t hi,
+                            const Handshake* hs, uint64_t now) {
+    const Args* args = c->args;
+    Sender* sn = slab_alloc(&c->senders);  /* Zeroed */
+    if (!sn) return NULL;
+    sn->c = c;
+    sn->job = job;
+    sn->flow = flow;
+    sn->path = job->path;
+    sn->name = job->name;
+    sn->window = args->window;
+    sn->lo = lo;
+    sn->hi = hi;
+    sn->total = job->total;
+    sn->rtt = c->rtt;
+    sn->rtt.backoff = 0;
+    if (++c->next_stream == 0) c->next_stream = 1; /* ids recycle after 65535 files */
+    sn->id = c->next_stream;
+
+    /* Open the file for streaming; chunks are read as the window reaches them */
+    if (!fsrc_open(&sn->src, job->path, args->chunk, args->window) || sn->src.size != job->size) {
+        fprintf(stderr, "Cannot open file: %s\n", job->path);
+        sender_finish(sn, 1);
+        return sn;
+    }
+    /* Only a whole-file stream can resume */
+    if (!bm_init(&sn->skip, job->nstreams == 1 ? sn->total : 0)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        sender_finish(sn, 1);
+        return sn;
+    }
+
+    sn->state = ST_HANDSHAKE;
+    uint8_t opts[META_MAX];
+    size_t len = hs_encode(opts, sizeof(opts), hs);
+    if (!len || !sender_send_ctl(sn, PT_HANDSHAKE, opts, len, now)) {
+        fprintf(stderr, "Failed to pack handshake\n");
+        sender_finish(sn, 1);
+        return sn;
+    }
+    if (args->early) sender_send_early(sn, now);
+    return sn;
+}
+
+/* Random id naming a striped transfer across its flows */
+static uint64_t new_xfer_id(void) {
+    static uint64_t counter;
+    uint64_t k = us_now() ^ ((uint64_t)(uintptr_t)&counter << 16) ^ ++counter * 0x9e3779b97f4a7c15ULL;
+    k ^= k >> 30;
+    k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27;
+    k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return k;
+}
+
+/* Starts a file's streams: striped over every flow when it is large enough,
+ * else one stream on flow `home`. Returns the number of streams added to
+ * out. The file is only opened by the streams themselves. */
+static int job_start(Conn* conns, int nconns, int home, Job* job, Sender** out, uint64_t now) {
+    const Args* args = conns[0].args;
+    if (!fsrc_stat(job->path, &job->size)) {
+        fprintf(stderr, "Cannot open file: %s\n", job->path);
+        return 0;
+    }
+    job->total = (size_t)((job->size + args->chunk - 1) / args->chunk);
+
+    job->nstreams = nconns > 1 &&
+                    job->total >= (size_t)nconns * STRIPE_MIN_CHUNKS ? nconns : 1;
+
+    char time_str[TIME_STR_SIZE];
+    now_time(time_str, sizeof(time_str));
+    printf("[%s] Sending %s as %s (%llu bytes, %zu packets%s)\n",
+           time_str, job->path, job->name, (unsigned long long)job->size, job->total,
+           job->nstreams > 1 ? ", striped" : "");
+
+    Handshake hs;
+    memset(&hs, 0, sizeof(hs));
+    if (strlen(job->name) > HS_FIELD_MAX) {
+        fprintf(stderr, "File name too long: %s\n", job->name);
+        return 0;
+    }
+    strcpy(hs.name, job->name);
+    hs.size = job->size;
+    hs.chunk = (uint32_t)args->chunk;
+    hs.caps |= CAP_DIGEST;
+    if (args->fec) hs.caps |= CAP_FEC;
+    if (args->codec) {
+        hs.caps |= CAP_COMPRESS;
+        hs.codecs[hs.ncodecs++] = (uint8_t)args->codec->id;
+    }
+
+    if (job->nstreams == 1) {
+        if (content_id(job->path, job->size, &hs.id)) hs.caps |= CAP_RESUME;
+        out[0] = sender_start(&conns[home], job, 0, 0, job->total, &hs, now);
+        return out[0] ? 1 : 0;
+    }
+
+    hs.caps |= CAP_STRIPE;
+    hs.xfer = new_xfer_id();
+    hs.nflows = (uint8_t)job->nstreams;
+    int n = 0;
+    for (int i = 0; i < job->nstreams; i++) {
+        hs.flow = (uint8_t)i;
+        size_t lo = (size_t)((uint64_t)job->total * (uint64_t)i / (uint64_t)job->nstreams);
+        size_t hi = (size_t)((uint64_t)job->total * (uint64_t)(i + 1) / (uint64_t)job->nstreams);
+        Sender* sn = sender_start(&conns[i], job, i, lo, hi, &hs, now);
+        if (sn) out[n++] = sn;
+    }
+    job->nstreams = n;
+    return n;
+}
+
+/* Data is all acknowledged (or there was none): close with FIN, carrying
+ * the digest of the stream's chunks for the server to check the file by */
+static void sender_start_fin(Sender* sn, uint64_t now) {
+    sn->timer_running = 0;
+    sn->state = ST_FIN;
+    uint8_t digest[FIN_DIGEST_SIZE];
+    put_be64(digest, sn->digest);
+    if (!sender_send_ctl(sn, PT_FIN, digest, sn->undigested ? 0 : sizeof(digest), now)) {
+        fprintf(stderr, "Failed to pack FIN\n");
+        sender_finish(sn, 1);
+    }
+}
+
+static void sender_on_handshake_ack(Sender* sn, const Packet* p, uint64_t now) {
+    if (sn->ctl_tries == 1) rtt_sample(&sn->rtt, now - sn->ctl_sent); /* Karn: first try only */
+    sn->rwnd = p->window ? p->window : sn->window;
+    sn->rwnd_max = sn->rwnd;
+    /* The server's answer: the requested features it accepted, the codec
+     * it chose and any chunks it kept from an earlier attempt */
+    uint32_t caps = 0;
+    int codec = -1;
+    const uint8_t* ranges = NULL;
+    size_t nranges = 0, off = 0;
+    Tlv t;
+    while (tlv_next(p->payload, p->payload_size, &off, &t) > 0) {
+        if (t.type == HS_CAPS && t.len == 4) caps = tlv_u32(&t);
+        else if (t.type == HS_CODEC && t.len == 1) codec = t.val[0];
+        else if (t.type == HS_RANGES) {
+            ranges = t.val;
+            nranges = t.len;
+        }
+    }
+    if (caps & CAP_RESUME) resume_decode(p->seq, ranges, nranges, &sn->skip);
+    const Args* args = sn->c->args;
+    if (args->fec && (caps & CAP_FEC)) {
+        sn->fec = 1;
+        sn->parity = calloc(1, args->chunk);
+        sn->parity_on = sn->parity != NULL;
+        sn->fec_shift = args->fec > 0 ? args->fec : FEC_START_SHIFT;
+        sn->loss_rate = 1.0 / (double)(4 << FEC_START_SHIFT);
+    }
+    Conn* c = sn->c;
+    if (args->codec && (caps & CAP_COMPRESS) && codec == args->codec->id) {
+        if (!c->zctx) c->zctx = args->codec->ctx_new();
+        if (!c->zbuf) c->zbuf = malloc(args->chunk);
+        if (c->zctx && c->zbuf) sn->codec = args->codec;
+    }
+
+    char time_str[TIME_STR_SIZE];
+    now_time(time_str, sizeof(time_str));
+    if (sn->job->nstreams > 1) {
+        printf("[%s] Handshake ACK received for %s flow %d/%d\n",
+               time_str, sn->name, sn->flow + 1, sn->job->nstreams);
+    } else if (sn->skip.count) {
+        printf("[%s] Handshake ACK received for %s, resuming: %zu of %zu packets already there\n",
+               time_str, sn->name, sn->skip.count, sn->total);
+    } else {
+        printf("[%s] Handshake ACK received for %s\n", time_str, sn->name);
+    }
+
+    int early = sn->slots != NULL;
+    if (early && sn->skip.count) {
+        /* Early DATA overlapped a resumed file: start over from what the
+         * server still needs, the early packets were at most duplicates */
+        for (size_t s = sn->base; s < sn->nextseq; s++) {
+            if (sn->slots[s % sn->window].in_flight) c->inflight--;
+        }
+        memset(sn->slots, 0, sn->window * sizeof(SendSlot));
+        sn->nlost = 0;
+        sn->timer_running = 0;
+        sn->early_fin = 0;
+        sn->digest = 0;
+        sn->undigested = 0;
+        early = 0;
+    } else if (!sn->slots) {
+        sn->slots = slab_alloc(&c->slot_rings);
+        if (!sn->slots) {
+            fprintf(stderr, "Memory allocation failed\n");
+            sender_finish(sn, 1);
+            return;
+        }
+    }
+    if (!early) {
+        sn->base = sn->nextseq = sn->skip.nbits ? bm_next_clear(&sn->skip, 0) : sn->lo;
+        /* The digest still covers the prefix the server kept */
+        for (size_t s = sn->lo; s < sn->base; s++) {
+            digest_fold(sn, s);
+            fsrc_release(&sn->src, s + 1);
+        }
+        fsrc_release(&sn->src, sn->base);
+    }
+    sn->ctl_len = 0;
+    sn->state = ST_DATA;
+    if (sn->base >= sn->hi) sender_start_fin(sn, now);
+}
+
+static void sender_on_reply(Sender* sn, const Packet* p, uint64_t now) {
+    if (p->ptype == PT_ERROR) {
+        fprintf(stderr, "Server error for %s: %.*s\n", sn->name, (int)p->payload_size,
+                p->payload ? (const char*)p->payload : "");
+        sender_finish(sn, 5);
+    } else if (sn->state == ST_HANDSHAKE && p->ptype == PT_HANDSHAKE_ACK) {
+        sender_on_handshake_ack(sn, p, now);
+    } else if (sn->state == ST_DATA && p->ptype == PT_SACK) {
+        sender_on_sack(sn, p);
+        if (sn->base >= sn->hi) sender_start_fin(sn, now);
+    } else if ((sn->state == ST_FIN || sn->early_fin) && p->ptype == PT_FIN_ACK) {
+        sender_finish(sn, 0);
+    }
+    /* anything else is a late duplicate */
+}
+
+/* Drive the retransmission timers; returns the next deadline */
+static uint64_t sender_on_timer(Sender* sn, uint64_t now) {
+    const Args* args = sn->c->args;
+    if (sn->state == ST_HANDSHAKE || sn->state == ST_FIN) {
+        uint64_t due = sn->ctl_sent + rtt_rto(&sn->rtt);
+        if (now < due) return due;
+        if (sn->ctl_tries >= args->max_retries) {
+            if (sn->state == ST_HANDSHAKE) {
+                fprintf(stderr, "Handshake failed for %s\n", sn->name);
+                sender_finish(sn, 2);
+            } else {
+                fprintf(stderr, "FIN not acknowledged for %s\n", sn->name);
+                sender_finish(sn, 4);
+            }
+            return UINT64_MAX;
+        }
+        rtt_backoff(&sn->rtt);
+        sn->ctl_tries++;
+        sn->ctl_sent = now;
+        conn_send(sn->c, sn->ctl, sn->ctl_len);
+        TRACE(TR_PACKET_SENT, (sn->state == ST_HANDSHAKE ? PT_HANDSHAKE : PT_FIN) | TRACE_RETX, sn->c->port,
+              sn->id, 0, (uint32_t)(sn->ctl_len - HEADER_SIZE), sn->window, 0);
+        return now + rtt_rto(&sn->rtt);
+    }
+    if (sn->state == ST_DATA && sender_timed_out(sn, now)) {
+        sender_on_timeout(sn, now);
+        if (sn->retries > args->max_retries) {
+            fprintf(stderr, "Max retries exceeded for %s\n", sn->name);
+            sender_finish(sn, 3);
+            return UINT64_MAX;
+        }
+    }
+    if (sn->state == ST_DATA && sn->timer_running) return sn->timer_t0 + rtt_rto(&sn->rtt);
+    return UINT64_MAX;
+}
+
+/* Opens flow i's socket, bound to its --bind address if any, connected to
+ * nothing: datagrams go to the resolved --host via sendto */
+static int conn_open(Conn* c, const Args* args, int i, EvLoop* loop) {
+    memset(c, 0, sizeof(*c));
+    c->args = args;
+    c->loop = loop;
+    c->sock = INVALID_SOCKET_TYPE;
+    slab_init(&c->senders, sizeof(Sender), 8);
+    slab_init(&c->slot_rings, args->window * sizeof(SendSlot), 8);
+
+    /* Resolve host */
+    const char* host = args->hosts[i % args->nhosts];
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    char port_str[16];
+    snprintf(port_str, sizeof(port_str), "%d", args->port);
+
+    if (getaddrinfo(host, port_str, &hints, &res) != 0) {
+        fprintf(stderr, "Failed to resolve host %s\n", host);
+        return 0;
+    }
+    memcpy(&c->peer, res->ai_addr, res->ai_addrlen);
+    c->peerlen = (int)res->ai_addrlen;
+
+    c->sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    freeaddrinfo(res);
+    if (c->sock == INVALID_SOCKET_TYPE) {
+#ifdef _WIN32
+        fprintf(stderr, "socket failed: %d\n", WSAGetLastError());
+#else
+        fprintf(stderr, "socket failed: %s\n", strerror(errno));
+#endif
+        return 0;
+    }
+
+    if (args->nbinds > 0) {
+        const char* local = args->binds[i % args->nbinds];
+        struct sockaddr_in la;
+        memset(&la, 0, sizeof(la));
+        la.sin_family = AF_INET;
+        if (inet_pton(AF_INET, local, &la.sin_addr) != 1 ||
+            bind(c->sock, (struct sockaddr*)&la, sizeof(la)) != 0) {
+            fprintf(stderr, "Cannot bind to %s\n", local);
+            return 0;
+        }
+    }
+
+    if (trace_on) {
+        /* Bound now rather than by the first send, so the trace knows the port */
+        struct sockaddr_in la;
+        SOCKLEN_TYPE lalen = sizeof(la);
+        memset(&la, 0, sizeof(la));
+        la.sin_family = AF_INET;
+        if (args->nbinds == 0) bind(c->sock, (struct sockaddr*)&la, sizeof(la));
+        if (getsockname(c->sock, (struct sockaddr*)&la, &lalen) == 0) c->port = ntohs(la.sin_port);
+    }
+
+    /* Non-blocking receive */
+#ifdef _WIN32
+    u_long mode = 1;
+    if (ioctlsocket(c->sock, FIONBIO, &mode) == SOCKET_ERROR) {
+        fprintf(stderr, "ioctlsocket failed: %d\n", WSAGetLastError());
+        return 0;
+    }
+#else
+    int flags = fcntl(c->sock, F_GETFL, 0);
+    if (flags == -1) {
+        fprintf(stderr, "fcntl F_GETFL failed: %s\n", strerror(errno));
+        return 0;
+    }
+    if (fcntl(c->sock, F_SETFL, flags | O_NONBLOCK) == -1) {
+        fprintf(stderr, "fcntl F_SETFL failed: %s\n", strerror(errno));
+        return 0;
+    }
+#endif
+    udp_tune_buffers(c->sock, UDP_SOCKET_BUFFER);
+    if (!ev_add(loop, c->sock)) {
+        fprintf(stderr, "event loop setup failed\n");
+        return 0;
+    }
+
+    rtt_init(&c->rtt, (uint64_t)args->timeout_ms * 1000, (uint64_t)args->min_rto_ms * 1000,
+             (uint64_t)args->max_rto_ms * 1000);
+    pacer_init(&c->pacer);
+    if (args->rate > 0) udp_set_pacing_rate(c->sock, (uint64_t)args->rate);
+    cc_init(&c->cc, cc_find(args->cc), args->window);
+    size_t dgram = args->chunk ? args->chunk : PROBE_MAX;
+    if (dgram < META_MAX) dgram = META_MAX;
+    if (!udp_tx_init(&c->tx, c->sock, UDP_BATCH_MAX * (HEADER_SIZE + dgram)) ||
+        !udp_rx_init(&c->rx, c->sock, REPLY_MAX, UDP_BATCH_MAX)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void conn_close(Conn* c) {
+    if (c->zctx) c->args->codec->ctx_free(c->zctx);
+    free(c->zbuf);
+    udp_tx_free(&c->tx);
+    udp_rx_free(&c->rx);
+    slab_destroy(&c->senders);
+    slab_destroy(&c->slot_rings);
+    if (c->sock != INVALID_SOCKET_TYPE) CLOSE_SOCKET(c->sock);
+    c->sock = INVALID_SOCKET_TYPE;
+}
+
+/* Pacing rate: --rate as given, else the congestion window per smoothed RTT
+ * with headroom for growth, twice that in slow start as Linux TCP does.
+ * Until there is an RTT sample the flow is unpaced. */
+static void conn_pace(Conn* c) {
+    const Args* args = c->args;
+    size_t dgram = HEADER_SIZE + args->chunk;
+    if (args->rate > 0) {
+        if (c->pacer.rate != args->rate) pacer_set_rate(&c->pacer, args->rate, dgram);
+    } else if (args->rate == 0 && c->rtt.has_sample && c->rtt.srtt > 0) {
+        double gain = c->cc.cwnd < c->cc.ssthresh ? 2.0 : 1.25;
+        pacer_set_rate(&c->pacer, gain * cc_window(&c->cc) * (double)dgram * 1e6 / (double)c->rtt.srtt,
+                       dgram);
+    }
+}
+
+/* The shared window of each flow may grow to what its sending streams can use */
+static void update_windows(Conn* conns, int nconns, Sender** active, int nactive) {
+    uint32_t usable[MAX_FLOWS];
+    memset(usable, 0, sizeof(usable));
+    for (int i = 0; i < nactive; i++) {
+        Sender* sn = active[i];
+        if (sn->state == ST_DATA) {
+            usable[sn->c - conns] += sn->window < sn->rwnd_max ? sn->window : sn->rwnd_max;
+        }
+    }
+    for (int f = 0; f < nconns; f++) {
+        if (usable[f] && usable[f] != conns[f].cc.max_cwnd) cc_set_max(&conns[f].cc, usable[f]);
+    }
+}
+
+/* Drain every queued reply (non-blocking) and hand each to its stream */
+static void conn_receive(Conn* c, Sender** active, int nactive) {
+    if (udp_rx_recv(&c->rx) <= 0) return;
+    uint64_t now = us_now();
+    UdpMsg m;
+    while (udp_rx_next(&c->rx, &m)) {
+        Packet p;
+        if (unpack_view(m.data, m.len, &p) != 0) continue;
+        TRACE(TR_PACKET_RECEIVED, p.ptype, c->port, p.stream, p.seq, (uint32_t)p.payload_size, p.window, 0);
+        for (int i = 0; i < nactive; i++) {
+            Sender* sn = active[i];
+            if (sn->c == c && sn->id == p.stream && sn->state != ST_DONE) {
+                sender_on_reply(sn, &p, now);
+                break;
+            }
+        }
+    }
+}
+
+/* --chunk auto: every flow sends don't-fragment probes of each candidate
+ * size and the largest datagram all of them got acknowledged, less our
+ * header, becomes the chunk. This runs before any handshake since the chunk
+ * fixes each file's packet count. The server answers each probe as it
+ * arrives, so after the first answer the larger probes get twice that round
+ * trip to follow. A server that never answers leaves the default chunk. */
+static size_t probe_chunk(Conn* conns, int nconns, EvLoop* loop) {
+    static const uint8_t pad[PROBE_MAX];
+    const Args* args = conns[0].args;
+    size_t best[MAX_FLOWS];
+    int df = 1;
+    for (int f = 0; f < nconns; f++) {
+        best[f] = 0;
+        if (!udp_set_dontfrag(conns[f].sock, 1)) df = 0;
+    }
+
+    size_t largest = 0;
+    if (df) {
+        Packet p;
+        memset(&p, 0, sizeof(p));
+        p.magic0 = 'R';
+        p.magic1 = 'U';
+        p.version = VERSION;
+        p.ptype = PT_PROBE;
+        p.payload = (uint8_t*)pad;
+        /* Sizes interleaved so no two equal datagrams are coalesced by GSO */
+        for (int f = 0; f < nconns; f++) {
+            for (int copy = 0; copy < PROBE_COPIES; copy++) {
+                for (size_t k = 0; k < NPROBE_SIZES; k++) {
+                    size_t len = probe_sizes[k];
+                    if (len > largest) largest = len;
+                    p.payload_size = len - HEADER_SIZE;
+                    uint8_t* out = udp_tx_reserve(&conns[f].tx, len);
+                    size_t n = out ? pack_into(out, len, &p) : 0;
+                    if (n) udp_tx_commit(&conns[f].tx, n, &conns[f].peer, (SOCKLEN_TYPE)conns[f].peerlen);
+                }
+            }
+            udp_tx_flush(&conns[f].tx);
+        }
+
+        uint64_t start = us_now();
+        uint64_t deadline = start + (uint64_t)args->timeout_ms * 1000;
+        int answered = 0;
+        EvTimer wake;
+        ev_timer_init(&wake, NULL, NULL);
+        for (;;) {
+            int all = 1;
+            for (int f = 0; f < nconns; f++) {
+                if (best[f] < largest) all = 0;
+            }
+            if (all || us_now() >= deadline) break;
+            ev_timer_start(loop, &wake, deadline);
+            SOCKET_TYPE ready[MAX_FLOWS];
+            int nready = ev_wait(loop, ready, nconns);
+            for (int r = 0; r < nready; r++) {
+                for (int f = 0; f < nconns; f++) {
+                    if (conns[f].sock != ready[r] || udp_rx_recv(&conns[f].rx) <= 0) continue;
+                    UdpMsg m;
+                    while (udp_rx_next(&conns[f].rx, &m)) {
+                        Packet a;
+                        if (unpack_view(m.data, m.len, &a) != 0 || a.ptype != PT_PROBE_ACK ||
+                            a.stream != 0 || a.seq > largest) {
+                            continue;
+                        }
+                        if (a.seq > best[f]) best[f] = a.seq;
+                        if (!answered) {
+                            uint64_t now = us_now();
+                            uint64_t settle = 2 * (now - start);
+                            if (settle < PROBE_SETTLE_US) settle = PROBE_SETTLE_US;
+                            if (now + settle < deadline) deadline = now + settle;
+                            answered = 1;
+                        }
+                    }
+                }
+            }
+        }
+        ev_timer_stop(loop, &wake);
+    }
+    for (int f = 0; f < nconns; f++) udp_set_dontfrag(conns[f].sock, 0);
+
+    size_t dgram = best[0];
+    for (int f = 1; f < nconns; f++) {
+        if (best[f] < dgram) dgram = best[f];
+    }
+    char time_str[TIME_STR_SIZE];
+    now_time(time_str, sizeof(time_str));
+    if (!df) {
+        dgram = PROBE_FALLBACK;
+        printf("[%s] Path MTU probing unsupported, assuming %zu-byte datagrams\n", time_str, dgram);
+    } else if (dgram == 0) {
+        printf("[%s] No answer to path MTU probes, using --chunk %d\n", time_str, DEFAULT_CHUNK);
+    } else {
+        printf("[%s] Path MTU probe: %zu-byte datagrams get through, using --chunk %zu\n",
+               time_str, dgram, dgram - HEADER_SIZE);
+    }
+    return dgram ? dgram - HEADER_SIZE : DEFAULT_CHUNK;
+}
+
+/* --stats-interval: one line per flow */
+static void print_stats(Conn* conns, int nconns, int nactive, uint64_t interval_us) {
+    char time_str[TIME_STR_SIZE];
+    now_time(time_str, sizeof(time_str));
+    for (int f = 0; f < nconns; f++) {
+        Conn* c = &conns[f];
+        char flow[16] = "";
+        if (nconns > 1) snprintf(flow, sizeof(flow), " flow %d", f + 1);
+        printf("[%s] stats%s: %.1f Mbit/s, %d streams, %llu sent (%llu resent, %llu timeouts), "
+               "srtt %.2f ms, rto %.1f ms, cwnd %zu, inflight %zu\n",
+               time_str, flow, (double)(c->sent_bytes - c->reported_bytes) * 8 / (double)interval_us,
+               nactive, (unsigned long long)c->sent_packets, (unsigned long long)c->resent,
+               (unsigned long long)c->timeouts, (double)c->rtt.srtt / 1000.0,
+               (double)c->rtt.rto / 1000.0, (size_t)cc_window(&c->cc), c->inflight);
+        c->reported_bytes = c->sent_bytes;
+    }
+    fflush(stdout);
+}
+
+/* Sends every file, up to --parallel of them at a time, each as one stream
+ * or striped over all flows. Returns 0 if all arrived, else the status of
+ * the first failure. */
+static int run_transfers(Conn* conns, int nconns, EvLoop* loop, const FileList* files) {
+    const Args* args = conns[0].args;
+    static Sender* active[MAX_PARALLEL * MAX_FLOWS];
+    int nactive = 0;
+    int njobs = 0;          /* files in flight */
+    size_t next_file = 0;
+    size_t rr = 0;          /* round-robin start for sharing the windows */
+    size_t sent = 0;
+    int rc = 0;
+
+    uint64_t stats_every = (uint64_t)args->stats_interval * 1000000;
+    uint64_t stats_due = stats_every ? us_now() + stats_every : UINT64_MAX;
+
+    EvTimer wake;
+    ev_timer_init(&wake, NULL, NULL);
+    while (next_file < files->count || nactive > 0) {
+        uint64_t now = us_now();
+        if (now >= stats_due) {
+            print_stats(conns, nconns, nactive, stats_every);
+            stats_due += stats_every;
+        }
+        while (njobs < args->parallel && next_file < files->count) {
+            Job* job = calloc(1, sizeof(Job));
+            int home = (int)(next_file % (size_t)nconns);
+            if (job) {
+                job->path = files->paths[next_file];
+                job->name = files->names[next_file];
+            }
+            next_file++;
+            int n = job ? job_start(conns, nconns, home, job, active + nactive, now) : 0;
+            if (n == 0) {
+                if (!job) fprintf(stderr, "Memory allocation failed\n");
+                free(job);
+                if (!rc) rc = 1;
+                continue;
+            }
+            nactive += n;
+            njobs++;
+        }
+
+        uint64_t deadline = stats_due;
+        for (int i = 0; i < nactive; i++) {
+            uint64_t due = sender_on_timer(active[i], now);
+            if (due < deadline) deadline = due;
+        }
+        for (int f = 0; f < nconns; f++) conn_pace(&conns[f]);
+        for (int k = 0; k < nactive; k++) {
+            Sender* sn = active[(rr + (size_t)k) % (size_t)nactive];
+            if (sn->state == ST_DATA) sender_fill(sn, now);
+        }
+        rr++;
+        for (int f = 0; f < nconns; f++) udp_tx_flush(&conns[f].tx);
+
+        /* Retire finished streams; a file is done with its last stream */
+        for (int i = 0; i < nactive; ) {
+            Sender* sn = active[i];
+            if (sn->state != ST_DONE) {
+                i++;
+                continue;
+            }
+            Job* job = sn->job;
+            if (sn->rc && !job->rc) job->rc = sn->rc;
+            if (++job->done == job->nstreams) {
+                if (job->rc == 0) {
+                    char time_str[TIME_STR_SIZE];
+                    now_time(time_str, sizeof(time_str));
+                    if (job->wire_sent) {
+                        printf("[%s] Transfer complete: %s (%zu packets, %zu resent, %.2fx compressed)\n",
+                               time_str, job->name, job->total, job->resent,
+                               (double)job->raw_sent / (double)job->wire_sent);
+                    } else {
+                        printf("[%s] Transfer complete: %s (%zu packets, %zu resent)\n",
+                               time_str, job->name, job->total, job->resent);
+                    }
+                    sent++;
+                } else if (!rc) {
+                    rc = job->rc;
+                }
+                free(job);
+                njobs--;
+            }
+            sender_free(sn);
+            active[i] = active[--nactive];
+        }
+        if (njobs < args->parallel && next_file < files->count) continue;
+        if (nactive == 0) break;
+
+        update_windows(conns, nconns, active, nactive);
+
+        /* Data timers may have been (re)armed by the fill above; streams held
+         * back by the pacer wake when it has tokens again */
+        for (int i = 0; i < nactive; i++) {
+            if (active[i]->state == ST_DATA && active[i]->timer_running) {
+                uint64_t due = active[i]->timer_t0 + rtt_rto(&active[i]->rtt);
+                if (due < deadline) deadline = due;
+            }
+            if (sender_wants_send(active[i])) {
+                uint64_t due = pacer_next(&active[i]->c->pacer, now);
+                if (due < deadline) deadline = due;
+            }
+        }
+        if (deadline != UINT64_MAX) {
+            ev_timer_start(loop, &wake, deadline);
+        } else {
+            ev_timer_stop(loop, &wake);
+        }
+        SOCKET_TYPE ready[MAX_FLOWS];
+        int nready = ev_wait(loop, ready, nconns);
+        for (int r = 0; r < nready; r++) {
+            for (int f = 0; f < nconns; f++) {
+                if (conns[f].sock == ready[r]) conn_receive(&conns[f], active, nactive);
+            }
+        }
+    }
+    ev_timer_stop(loop, &wake);
+
+    if (files->count > 1) {
+        char time_str[TIME_STR_SIZE];
+        now_time(time_str, sizeof(time_str));
+        printf("[%s] Sent %zu of %zu files\n", time_str, sent, files->count);
+    }
+    return rc;
+}
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    // Initialize Winsock
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (result != 0) {
+        fprintf(stderr, "WSAStartup failed: %d\n", result);
+        return 1;
+    }
+#endif
+
+    Args args;
+    FileList files;
+    memset(&files, 0, sizeof(files));
+    int listed = parse_args(argc, argv, &args);
+    for (int i = 0; listed && i < args.nfiles; i++) {
+        char name[1024];
+        base_name(args.files[i], name, sizeof(name));
+        listed = list_add(&files, args.files[i], name, 1);
+    }
+    free(args.files);
+    if (listed && args.trace && !trace_open(args.trace, "client")) {
+        fprintf(stderr, "Cannot write trace %s\n", args.trace);
+        listed = 0;
+    }
+    if (!listed) {
+        list_free(&files);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
+
+    EvLoop loop;
+    Conn conns[MAX_FLOWS];
+    int nconns = 0;
+    int ok = ev_init(&loop);
+    if (!ok) fprintf(stderr, "event loop setup failed\n");
+    while (ok && nconns < args.flows) {
+        ok = conn_open(&conns[nconns], &args, nconns, &loop);
+        nconns++;
+    }
+
+    if (ok && args.chunk == 0) args.chunk = probe_chunk(conns, nconns, &loop);
+
+    int rc = 1;
+    if (ok) {
+        char time_str[TIME_STR_SIZE];
+        now_time(time_str, sizeof(time_str));
+        printf("[%s] Client connecting to %s:%d sending %zu file(s) over %d flow(s)\n",
+               time_str, args.hosts[0], args.port, files.count, nconns);
+        rc = run_transfers(conns, nconns, &loop, &files);
+    }
+
+    /* Cleanup */
+    for (int i = 0; i < nconns; i++) conn_close(&conns[i]);
+    ev_close(&loop);
+    list_free(&files);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return rc;
+}
@@ -0,0 +1,159 @@
+#include "bitmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_BITS 64
+
+static size_t word_count(size_t nbits) {
+    return (nbits + WORD_BITS - 1) / WORD_BITS;
+}
+
+int bm_init(Bitmap* b, size_t nbits) {
+    size_t nwords = word_count(nbits);
+    b->words = calloc(nwords ? nwords : 1, sizeof(uint64_t));
+    b->nbits = nbits;
+    b->count = 0;
+    return b->words != NULL;
+}
+
+void bm_free(Bitmap* b) {
+    free(b->words);
+    memset(b, 0, sizeof(*b));
+}
+
+int bm_test(const Bitmap* b, size_t i) {
+    if (i >= b->nbits) return 0;
+    return (int)((b->words[i / WORD_BITS] >> (i % WORD_BITS)) & 1u);
+}
+
+/* Returns 1 if the bit was newly set, 0 if it was already set or out of range */
+int bm_set(Bitmap* b, size_t i) {
+    if (i >= b->nbits) return 0;
+    uint64_t mask = (uint64_t)1 << (i % WORD_BITS);
+    uint64_t* w = &b->words[i / WORD_BITS];
+    if (*w & mask) return 0;
+    *w |= mask;
+    b->count++;
+    return 1;
+}
+
+static int lowest_bit(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(v);
+#else
+    int n = 0;
+    while (!(v & 1u)) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static int popcount(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(v);
+#else
+    int n = 0;
+    while (v) {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* First clear bit at or after from, or nbits when everything is set.
+ * Skips whole words of received chunks at a time. */
+size_t bm_next_clear(const Bitmap* b, size_t from) {
+    if (from >= b->nbits) return b->nbits;
+    size_t wi = from / WORD_BITS;
+    uint64_t w = ~b->words[wi] & (~(uint64_t)0 << (from % WORD_BITS));
+    size_t nwords = word_count(b->nbits);
+    while (!w) {
+        if (++wi >= nwords) return b->nbits;
+        w = ~b->words[wi];
+    }
+    size_t i = wi * WORD_BITS + (size_t)lowest_bit(w);
+    return i < b->nbits ? i : b->nbits;
+}
+
+/* First set bit at or after from, or nbits when there is none */
+size_t bm_next_set(const Bitmap* b, size_t from) {
+    if (from >= b->nbits) return b->nbits;
+    size_t wi = from / WORD_BITS;
+    uint64_t w = b->words[wi] & (~(uint64_t)0 << (from % WORD_BITS));
+    size_t nwords = word_count(b->nbits);
+    while (!w) {
+        if (++wi >= nwords) return b->nbits;
+        w = b->words[wi];
+    }
+    size_t i = wi * WORD_BITS + (size_t)lowest_bit(w);
+    return i < b->nbits ? i : b->nbits;
+}
+
+/* Copies bits [from, from + n) into out, LSB first, one byte per eight
+ * bits; out must hold (n + 7) / 8 bytes. Bits past nbits read as clear.
+ * Stores the number of set bits in *held and returns the length of out
+ * up to its last non-zero byte. Works a word at a time. */
+size_t bm_extract(const Bitmap* b, size_t from, size_t n, uint8_t* out, size_t* held) {
+    size_t len = 0;
+    *held = 0;
+    memset(out, 0, (n + 7) / 8);
+    if (from >= b->nbits) return 0;
+    if (n > b->nbits - from) n = b->nbits - from;
+    size_t nwords = word_count(b->nbits);
+    for (size_t k = 0; k < n; k += WORD_BITS) {
+        size_t i = from + k;
+        size_t wi = i / WORD_BITS;
+        unsigned sh = (unsigned)(i % WORD_BITS);
+        uint64_t w = b->words[wi] >> sh;
+        if (sh && wi + 1 < nwords) w |= b->words[wi + 1] << (WORD_BITS - sh);
+        if (n - k < WORD_BITS) w &= ((uint64_t)1 << (n - k)) - 1;
+        if (!w) continue;
+        *held += (size_t)popcount(w);
+        for (int j = 0; j < 8 && w; j++, w >>= 8) {
+            out[k / 8 + (size_t)j] = (uint8_t)w;
+            if ((uint8_t)w) len = k / 8 + (size_t)j + 1;
+        }
+    }
+    return len;
+}
+
+int bm_copy(Bitmap* dst, const Bitmap* src) {
+    if (!bm_init(dst, src->nbits)) return 0;
+    memcpy(dst->words, src->words, word_count(src->nbits) * sizeof(uint64_t));
+    dst->count = src->count;
+    return 1;
+}
+
+int bm_write(const Bitmap* b, FILE* fp) {
+    for (size_t i = 0; i < word_count(b->nbits); i++) {
+        uint8_t le[8];
+        for (int k = 0; k < 8; k++) le[k] = (uint8_t)(b->words[i] >> (8 * k));
+        if (fwrite(le, 1, sizeof(le), fp) != sizeof(le)) return 0;
+    }
+    return 1;
+}
+
+/* Reads exactly the words for b->nbits (already set by bm_init) and
+ * recounts; bits past nbits in the last word must be clear */
+int bm_read(Bitmap* b, FILE* fp) {
+    size_t nwords = word_count(b->nbits);
+    b->count = 0;
+    for (size_t i = 0; i < nwords; i++) {
+        uint8_t le[8];
+        if (fread(le, 1, sizeof(le), fp) != sizeof(le)) return 0;
+        uint64_t w = 0;
+        for (int k = 0; k < 8; k++) w |= (uint64_t)le[k] << (8 * k);
+        b->words[i] = w;
+    }
+    if (b->nbits % WORD_BITS && nwords &&
+        (b->words[nwords - 1] >> (b->nbits % WORD_BITS)) != 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < nwords; i++) {
+        b->count += (size_t)popcount(b->words[i]);
+    }
+    return 1;
+}
@@ -0,0 +1,29 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Dense bitmap over [0, nbits), one bit per chunk of a file */
+typedef struct {
+    uint64_t* words;
+    size_t nbits;
+    size_t count;           /* bits currently set */
+} Bitmap;
+
+/* Function declarations */
+int bm_init(Bitmap* b, size_t nbits);
+void bm_free(Bitmap* b);
+int bm_test(const Bitmap* b, size_t i);
+int bm_set(Bitmap* b, size_t i);
+size_t bm_next_clear(const Bitmap* b, size_t from);
+size_t bm_next_set(const Bitmap* b, size_t from);
+size_t bm_extract(const Bitmap* b, size_t from, size_t n, uint8_t* out, size_t* held);
+int bm_copy(Bitmap* dst, const Bitmap* src);
+
+/* Little-endian 64-bit words, so a saved bitmap reads back on any host */
+int bm_write(const Bitmap* b, FILE* fp);
+int bm_read(Bitmap* b, FILE* fp);
+
+#endif /* BITMAP_H */
@@ -0,0 +1,162 @@
+#include "cc.h"
+#include <string.h>
+#include <math.h>
+
+#define CC_INITIAL_WINDOW 10.0  /* RFC 6928 */
+#define CC_MIN_WINDOW 2.0
+#define CUBIC_C 0.4
+#define CUBIC_BETA 0.7
+
+static void clamp_cwnd(CcState* cc) {
+    if (cc->cwnd < 1.0) cc->cwnd = 1.0;
+    if (cc->cwnd > cc->max_cwnd) cc->cwnd = cc->max_cwnd;
+}
+
+static void note_rtt(CcState* cc, uint64_t rtt_us) {
+    if (rtt_us && (cc->min_rtt == 0 || rtt_us < cc->min_rtt)) cc->min_rtt = rtt_us;
+}
+
+/* ---- fixed: the old static window, kept as a baseline ---- */
+
+static void fixed_init(CcState* cc) {
+    cc->cwnd = cc->max_cwnd;
+    cc->ssthresh = HUGE_VAL;
+}
+
+static void fixed_on_ack(CcState* cc, uint32_t acked, uint64_t rtt_us, uint64_t now_us) {
+    (void)acked; (void)now_us;
+    note_rtt(cc, rtt_us);
+    cc->cwnd = cc->max_cwnd;
+}
+
+static void fixed_on_loss(CcState* cc, uint64_t now_us) {
+    (void)cc; (void)now_us;
+}
+
+/* ---- reno: slow start, then additive increase / multiplicative decrease ---- */
+
+/* ssthresh starts unbounded: only a loss sets it, never the window limit */
+static void reno_init(CcState* cc) {
+    cc->cwnd = CC_INITIAL_WINDOW;
+    cc->ssthresh = HUGE_VAL;
+    clamp_cwnd(cc);
+}
+
+static void reno_on_ack(CcState* cc, uint32_t acked, uint64_t rtt_us, uint64_t now_us) {
+    (void)now_us;
+    note_rtt(cc, rtt_us);
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += acked;
+    } else {
+        cc->cwnd += (double)acked / cc->cwnd;
+    }
+    clamp_cwnd(cc);
+}
+
+static void reno_on_loss(CcState* cc, uint64_t now_us) {
+    (void)now_us;
+    cc->ssthresh = cc->cwnd / 2;
+    if (cc->ssthresh < CC_MIN_WINDOW) cc->ssthresh = CC_MIN_WINDOW;
+    cc->cwnd = cc->ssthresh;
+    clamp_cwnd(cc);
+}
+
+static void reno_on_timeout(CcState* cc, uint64_t now_us) {
+    reno_on_loss(cc, now_us);
+    cc->cwnd = 1.0;
+}
+
+/* ---- cubic: RFC 8312 window growth with the Reno-friendly region ---- */
+
+static void cubic_init(CcState* cc) {
+    reno_init(cc);
+    cc->w_max = 0;
+    cc->w_est = 0;
+    cc->k = 0;
+    cc->epoch_start = 0;
+}
+
+static void cubic_on_ack(CcState* cc, uint32_t acked, uint64_t rtt_us, uint64_t now_us) {
+    note_rtt(cc, rtt_us);
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += acked;
+        clamp_cwnd(cc);
+        return;
+    }
+
+    if (cc->epoch_start == 0) {
+        cc->epoch_start = now_us;
+        cc->k = cc->cwnd < cc->w_max ? cbrt((cc->w_max - cc->cwnd) / CUBIC_C) : 0;
+        if (cc->w_max < cc->cwnd) cc->w_max = cc->cwnd;
+        cc->w_est = cc->cwnd;
+    }
+
+    /* Target is W_cubic one RTT from now */
+    double t = (double)(now_us - cc->epoch_start + cc->min_rtt) / 1e6;
+    double target = CUBIC_C * pow(t - cc->k, 3) + cc->w_max;
+    if (target > cc->cwnd) {
+        cc->cwnd += (target - cc->cwnd) / cc->cwnd * acked;
+    } else {
+        cc->cwnd += 0.01 * acked / cc->cwnd;
+    }
+
+    /* Never grow slower than standard AIMD would */
+    cc->w_est += 3.0 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * acked / cc->cwnd;
+    if (cc->w_est > cc->cwnd) cc->cwnd = cc->w_est;
+    clamp_cwnd(cc);
+}
+
+static void cubic_on_loss(CcState* cc, uint64_t now_us) {
+    (void)now_us;
+    cc->epoch_start = 0;
+    /* Fast convergence: release bandwidth if we lost before reaching w_max */
+    if (cc->cwnd < cc->w_max) {
+        cc->w_max = cc->cwnd * (1 + CUBIC_BETA) / 2;
+    } else {
+        cc->w_max = cc->cwnd;
+    }
+    cc->ssthresh = cc->cwnd * CUBIC_BETA;
+    if (cc->ssthresh < CC_MIN_WINDOW) cc->ssthresh = CC_MIN_WINDOW;
+    cc->cwnd = cc->ssthresh;
+    clamp_cwnd(cc);
+}
+
+static void cubic_on_timeout(CcState* cc, uint64_t now_us) {
+    cubic_on_loss(cc, now_us);
+    cc->cwnd = 1.0;
+}
+
+static const CcOps cc_table[] = {
+    { "cubic", cubic_init, cubic_on_ack, cubic_on_loss, cubic_on_timeout },
+    { "reno",  reno_init,  reno_on_ack,  reno_on_loss,  reno_on_timeout },
+    { "fixed", fixed_init, fixed_on_ack, fixed_on_loss, fixed_on_loss },
+};
+
+const CcOps* cc_find(const char* name) {
+    for (size_t i = 0; i < sizeof(cc_table) / sizeof(cc_table[0]); i++) {
+        if (strcmp(cc_table[i].name, name) == 0) return &cc_table[i];
+    }
+    return NULL;
+}
+
+const char* cc_names(void) {
+    return "cubic|reno|fixed";
+}
+
+void cc_init(CcState* cc, const CcOps* ops, uint32_t max_cwnd) {
+    memset(cc, 0, sizeof(*cc));
+    cc->ops = ops;
+    cc->max_cwnd = max_cwnd ? max_cwnd : 1;
+    ops->init(cc);
+}
+
+/* The limit follows the streams' usable windows and may shrink for a
+ * while; it caps cwnd but leaves ssthresh, the loss history, alone */
+void cc_set_max(CcState* cc, uint32_t max_cwnd) {
+    cc->max_cwnd = max_cwnd ? max_cwnd : 1;
+    clamp_cwnd(cc);
+}
+
+uint32_t cc_window(const CcState* cc) {
+    return (uint32_t)cc->cwnd;
+}
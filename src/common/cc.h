@@ -0,0 +1,39 @@
+#ifndef CC_H
+#define CC_H
+
+#include <stdint.h>
+
+/* Congestion control. The sender reports ACK and loss signals and asks for
+ * the current congestion window (in packets); the algorithm behind it is
+ * picked by name from a table of CcOps so variants can be compared. */
+typedef struct CcState CcState;
+
+typedef struct {
+    const char* name;
+    void (*init)(CcState* cc);
+    void (*on_ack)(CcState* cc, uint32_t acked, uint64_t rtt_us, uint64_t now_us);
+    void (*on_loss)(CcState* cc, uint64_t now_us);    /* at most once per window */
+    void (*on_timeout)(CcState* cc, uint64_t now_us);
+} CcOps;
+
+struct CcState {
+    const CcOps* ops;
+    double cwnd;            /* packets */
+    double ssthresh;        /* HUGE_VAL until the first loss */
+    uint32_t max_cwnd;      /* receiver window / local limit */
+    uint64_t min_rtt;       /* microseconds, 0 until sampled */
+    /* CUBIC state */
+    double w_max;
+    double w_est;
+    double k;
+    uint64_t epoch_start;
+};
+
+/* Function declarations */
+const CcOps* cc_find(const char* name);
+const char* cc_names(void);
+void cc_init(CcState* cc, const CcOps* ops, uint32_t max_cwnd);
+void cc_set_max(CcState* cc, uint32_t max_cwnd);
+uint32_t cc_window(const CcState* cc);
+
+#endif /* CC_H */
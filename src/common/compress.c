@@ -0,0 +1,164 @@
+#include "compress.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef RU_HAVE_LZ4
+#include <lz4.h>
+
+/* Only the compressor has state; LZ4_decompress_safe() needs none */
+static void* lz4_ctx_new(void) {
+    return malloc((size_t)LZ4_sizeofState());
+}
+
+static void lz4_ctx_free(void* ctx) {
+    free(ctx);
+}
+
+static size_t lz4_compress(void* ctx, uint8_t* dst, size_t cap, const uint8_t* src, size_t len) {
+    if (len > INT_MAX || cap > INT_MAX) return 0;
+    int n = LZ4_compress_fast_extState(ctx, (const char*)src, (char*)dst, (int)len, (int)cap, 1);
+    return n > 0 ? (size_t)n : 0;
+}
+
+static int lz4_decompress(void* ctx, uint8_t* dst, size_t len, const uint8_t* src, size_t srclen) {
+    (void)ctx;
+    if (len > INT_MAX || srclen > INT_MAX) return 0;
+    return LZ4_decompress_safe((const char*)src, (char*)dst, (int)srclen, (int)len) == (int)len;
+}
+#endif
+
+#ifdef RU_HAVE_ZSTD
+#include <zstd.h>
+
+#define ZSTD_CHUNK_LEVEL 3      /* zstd's default trade-off */
+
+typedef struct {
+    ZSTD_CCtx* c;
+    ZSTD_DCtx* d;
+} ZstdCtx;
+
+static void zstd_ctx_free(void* ctx) {
+    ZstdCtx* z = ctx;
+    if (!z) return;
+    ZSTD_freeCCtx(z->c);
+    ZSTD_freeDCtx(z->d);
+    free(z);
+}
+
+static void* zstd_ctx_new(void) {
+    ZstdCtx* z = calloc(1, sizeof(ZstdCtx));
+    if (!z) return NULL;
+    z->c = ZSTD_createCCtx();
+    z->d = ZSTD_createDCtx();
+    if (!z->c || !z->d) {
+        zstd_ctx_free(z);
+        return NULL;
+    }
+    return z;
+}
+
+static size_t zstd_compress(void* ctx, uint8_t* dst, size_t cap, const uint8_t* src, size_t len) {
+    size_t n = ZSTD_compressCCtx(((ZstdCtx*)ctx)->c, dst, cap, src, len, ZSTD_CHUNK_LEVEL);
+    return ZSTD_isError(n) ? 0 : n;
+}
+
+static int zstd_decompress(void* ctx, uint8_t* dst, size_t len, const uint8_t* src, size_t srclen) {
+    size_t n = ZSTD_decompressDCtx(((ZstdCtx*)ctx)->d, dst, len, src, srclen);
+    return !ZSTD_isError(n) && n == len;
+}
+#endif
+
+#ifdef RU_HAVE_ZLIB
+#include <zlib.h>
+
+/* Raw deflate at level 1: no zlib header or trailer, the packet CRC
+ * already covers the payload */
+typedef struct {
+    z_stream c;
+    z_stream d;
+} ZlibCtx;
+
+static void zlib_ctx_free(void* ctx) {
+    ZlibCtx* z = ctx;
+    if (!z) return;
+    deflateEnd(&z->c);
+    inflateEnd(&z->d);
+    free(z);
+}
+
+static void* zlib_ctx_new(void) {
+    ZlibCtx* z = calloc(1, sizeof(ZlibCtx));
+    if (!z) return NULL;
+    int ok = deflateInit2(&z->c, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (inflateInit2(&z->d, -15) != Z_OK) ok = 0;
+    if (!ok) {
+        zlib_ctx_free(z);
+        return NULL;
+    }
+    return z;
+}
+
+static size_t zlib_compress(void* ctx, uint8_t* dst, size_t cap, const uint8_t* src, size_t len) {
+    z_stream* s = &((ZlibCtx*)ctx)->c;
+    if (len > UINT_MAX || cap > UINT_MAX || deflateReset(s) != Z_OK) return 0;
+    s->next_in = (Bytef*)src;
+    s->avail_in = (uInt)len;
+    s->next_out = dst;
+    s->avail_out = (uInt)cap;
+    return deflate(s, Z_FINISH) == Z_STREAM_END ? (size_t)s->total_out : 0;
+}
+
+static int zlib_decompress(void* ctx, uint8_t* dst, size_t len, const uint8_t* src, size_t srclen) {
+    z_stream* s = &((ZlibCtx*)ctx)->d;
+    if (len > UINT_MAX || srclen > UINT_MAX || inflateReset(s) != Z_OK) return 0;
+    s->next_in = (Bytef*)src;
+    s->avail_in = (uInt)srclen;
+    s->next_out = dst;
+    s->avail_out = (uInt)len;
+    return inflate(s, Z_FINISH) == Z_STREAM_END && s->total_out == len;
+}
+#endif
+
+static const Codec codec_table[] = {
+#ifdef RU_HAVE_LZ4
+    { "lz4", 0, lz4_ctx_new, lz4_ctx_free, lz4_compress, lz4_decompress },
+#endif
+#ifdef RU_HAVE_ZSTD
+    { "zstd", 1, zstd_ctx_new, zstd_ctx_free, zstd_compress, zstd_decompress },
+#endif
+#ifdef RU_HAVE_ZLIB
+    { "zlib", 2, zlib_ctx_new, zlib_ctx_free, zlib_compress, zlib_decompress },
+#endif
+    { NULL, 0, NULL, NULL, NULL, NULL }
+};
+
+const Codec* codec_find(const char* name) {
+    for (const Codec* c = codec_table; c->name; c++) {
+        if (strcmp(c->name, name) == 0) return c;
+    }
+    return NULL;
+}
+
+/* Codec ids are fixed across builds, so peers can name codecs by id */
+const Codec* codec_by_id(int id) {
+    for (const Codec* c = codec_table; c->name; c++) {
+        if (c->id == id) return c;
+    }
+    return NULL;
+}
+
+/* The --compress choices this build offers */
+const char* codec_names(void) {
+    return "off"
+#ifdef RU_HAVE_LZ4
+        "|lz4"
+#endif
+#ifdef RU_HAVE_ZSTD
+        "|zstd"
+#endif
+#ifdef RU_HAVE_ZLIB
+        "|zlib"
+#endif
+        ;
+}
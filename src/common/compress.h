@@ -0,0 +1,31 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Per-chunk compression. Each DATA payload is compressed on its own, so a
+ * lost or resent packet never depends on any other; chunks that do not
+ * shrink go out raw. The codecs are whichever of lz4, zstd and zlib the
+ * build found, picked by name from a table like the congestion controls.
+ * A context belongs to one thread and is reused for every chunk. */
+
+#define CODEC_MAX 3
+
+typedef struct {
+    const char* name;
+    int id;                     /* fixed wire id (HS_CODEC), < CODEC_MAX */
+    void* (*ctx_new)(void);
+    void (*ctx_free)(void* ctx);
+    /* Returns the compressed size, or 0 if it does not fit in cap */
+    size_t (*compress)(void* ctx, uint8_t* dst, size_t cap, const uint8_t* src, size_t len);
+    /* Returns 1 if src expands to exactly len bytes */
+    int (*decompress)(void* ctx, uint8_t* dst, size_t len, const uint8_t* src, size_t srclen);
+} Codec;
+
+/* Function declarations */
+const Codec* codec_find(const char* name);
+const Codec* codec_by_id(int id);
+const char* codec_names(void);
+
+#endif /* COMPRESS_H */
@@ -1,25 +1,245 @@
-#include "crc32.h"
-
-static uint32_t table[256];
-static int table_init = 0;
-
-static void init_table(void) {
-    for (uint32_t i = 0; i < 256; i++) {
-        uint32_t c = i;
-        for (int j = 0; j < 8; j++) {
-            if (c & 1) c = 0xEDB88320u ^ (c >> 1);
-            else       c >>= 1;
-        }
-        table[i] = c;
-    }
-    table_init = 1;
-}
-
-uint32_t ru_crc32(const uint8_t* data, size_t len) {
-    if (!table_init) init_table();
-    uint32_t c = 0xFFFFFFFFu;
-    for (size_t i = 0; i < len; i++) {
-        c = table[(c ^ data[i]) & 0xFFu] ^ (c >> 8);
-    }
-    return c ^ 0xFFFFFFFFu;
-}
+#include "crc32.h"
+#include "crc32_tables.h"
+#include <string.h>
+
+/* CRC-32 (IEEE 802.3, reflected 0xEDB88320). The portable path is
+ * slicing-by-8 over precomputed tables; x86 PCLMULQDQ folding and the ARMv8
+ * CRC32 instructions are used when the CPU has them. The kernel is picked
+ * once at load time, so ru_crc32() is safe to call from any thread. */
+
+typedef uint32_t (*crc32_fn)(uint32_t c, const uint8_t* p, size_t len);
+
+static uint32_t crc32_bytes(uint32_t c, const uint8_t* p, size_t len) {
+    while (len--) {
+        c = crc32_tables[0][(c ^ *p++) & 0xFFu] ^ (c >> 8);
+    }
+    return c;
+}
+
+static uint32_t load_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t crc32_slice8(uint32_t c, const uint8_t* p, size_t len) {
+    while (len >= 8) {
+        uint32_t one = load_le32(p) ^ c;
+        uint32_t two = load_le32(p + 4);
+        c = crc32_tables[7][one & 0xFFu] ^
+            crc32_tables[6][(one >> 8) & 0xFFu] ^
+            crc32_tables[5][(one >> 16) & 0xFFu] ^
+            crc32_tables[4][one >> 24] ^
+            crc32_tables[3][two & 0xFFu] ^
+            crc32_tables[2][(two >> 8) & 0xFFu] ^
+            crc32_tables[1][(two >> 16) & 0xFFu] ^
+            crc32_tables[0][two >> 24];
+        p += 8;
+        len -= 8;
+    }
+    return crc32_bytes(c, p, len);
+}
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64)) && \
+    (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define RU_CRC32_PCLMUL 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PCLMUL_TARGET
+#else
+#include <cpuid.h>
+#define PCLMUL_TARGET __attribute__((target("pclmul,sse4.1")))
+#endif
+
+/* Fold 64-byte blocks with carry-less multiplication, then Barrett-reduce to
+ * 32 bits ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ",
+ * Intel, 2009). The constants are the bit-reflected x^k mod P values from
+ * that paper. Needs len >= 64; only whole 16-byte blocks are consumed. */
+PCLMUL_TARGET
+static uint32_t crc32_pclmul_blocks(uint32_t crc, const uint8_t* buf, size_t len) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = k1k2;
+    buf += 64;
+    len -= 64;
+
+    /* Four lanes folded in parallel */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    /* Fold the four lanes into one */
+    x0 = k3k4;
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Remaining 16-byte blocks */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* 128 -> 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = k5k0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = poly;
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t c, const uint8_t* p, size_t len) {
+    if (len >= 64) {
+        size_t blocks = len & ~(size_t)15;
+        c = crc32_pclmul_blocks(c, p, blocks);
+        p += blocks;
+        len -= blocks;
+    }
+    return crc32_slice8(c, p, len);
+}
+
+static int cpu_has_pclmul(void) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) && (info[2] & (1 << 19));
+#else
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+    return (c & bit_PCLMUL) && (c & bit_SSE4_1);
+#endif
+}
+#endif /* x86 */
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define RU_CRC32_ARMV8 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#ifdef __clang__
+#define ARMV8_CRC_TARGET __attribute__((target("crc")))
+#else
+#define ARMV8_CRC_TARGET __attribute__((target("+crc")))
+#endif
+
+ARMV8_CRC_TARGET
+static uint32_t crc32_armv8(uint32_t c, const uint8_t* p, size_t len) {
+    while (len && ((uintptr_t)p & 7)) {
+        c = __crc32b(c, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __crc32d(c, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        c = __crc32b(c, *p++);
+    }
+    return c;
+}
+
+static int cpu_has_armv8_crc(void) {
+#if defined(__APPLE__)
+    return 1; /* every Apple arm64 core has the CRC extension */
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return 0;
+#endif
+}
+#endif /* aarch64 */
+
+static crc32_fn crc32_impl = crc32_slice8;
+static const char* crc32_impl_name = "slice8";
+
+static void crc32_select(void) {
+#ifdef RU_CRC32_PCLMUL
+    if (cpu_has_pclmul()) {
+        crc32_impl = crc32_pclmul;
+        crc32_impl_name = "pclmul";
+    }
+#endif
+#ifdef RU_CRC32_ARMV8
+    if (cpu_has_armv8_crc()) {
+        crc32_impl = crc32_armv8;
+        crc32_impl_name = "armv8";
+    }
+#endif
+}
+
+/* Run crc32_select() before main() so no thread ever sees it change */
+#if defined(_MSC_VER)
+#pragma section(".CRT$XCU", read)
+__declspec(allocate(".CRT$XCU")) static void (*crc32_select_ctor)(void) = crc32_select;
+#else
+__attribute__((constructor)) static void crc32_select_ctor(void) {
+    crc32_select();
+}
+#endif
+
+uint32_t ru_crc32(const uint8_t* data, size_t len) {
+    return crc32_impl(0xFFFFFFFFu, data, len) ^ 0xFFFFFFFFu;
+}
+
+uint32_t ru_crc32_portable(const uint8_t* data, size_t len) {
+    return crc32_slice8(0xFFFFFFFFu, data, len) ^ 0xFFFFFFFFu;
+}
+
+const char* ru_crc32_impl(void) {
+    return crc32_impl_name;
+}
@@ -5,5 +5,9 @@
 #include <stddef.h>
 
 uint32_t ru_crc32(const uint8_t* data, size_t len);
+/* Slicing-by-8 only, whatever the CPU supports; for tests and benchmarks */
+uint32_t ru_crc32_portable(const uint8_t* data, size_t len);
+/* Name of the kernel ru_crc32() dispatches to: "slice8", "pclmul" or "armv8" */
+const char* ru_crc32_impl(void);
 
 #endif /* CRC32_H */
@@ -0,0 +1,18 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Whole-file digest for end-to-end verification: the sum, modulo 2^64, of
+ * every chunk's XXH64 seeded with the chunk's index. Each term depends only
+ * on a chunk's bytes and position, so the sum can be built in any order,
+ * by several threads or flows, and resumed from 8 bytes of saved state:
+ * the server folds chunks in as its writers store them and never reads the
+ * file back. It catches corruption, not tampering. */
+
+/* Function declarations */
+uint64_t xxh64(const void* data, size_t len, uint64_t seed);
+uint64_t digest_chunk(const uint8_t* data, size_t len, size_t seq);
+
+#endif /* DIGEST_H */
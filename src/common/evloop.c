@@ -0,0 +1,260 @@
+#include "evloop.h"
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#if defined(RU_HAVE_EPOLL)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#elif defined(RU_HAVE_KQUEUE)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <time.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+/* Timer heap */
+
+static void heap_set(EvLoop* loop, size_t i, EvTimer* t) {
+    loop->heap[i] = t;
+    t->slot = i + 1;
+}
+
+static void heap_up(EvLoop* loop, size_t i) {
+    EvTimer* t = loop->heap[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (loop->heap[parent]->deadline <= t->deadline) break;
+        heap_set(loop, i, loop->heap[parent]);
+        i = parent;
+    }
+    heap_set(loop, i, t);
+}
+
+static void heap_down(EvLoop* loop, size_t i) {
+    EvTimer* t = loop->heap[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= loop->nheap) break;
+        if (child + 1 < loop->nheap &&
+            loop->heap[child + 1]->deadline < loop->heap[child]->deadline) {
+            child++;
+        }
+        if (t->deadline <= loop->heap[child]->deadline) break;
+        heap_set(loop, i, loop->heap[child]);
+        i = child;
+    }
+    heap_set(loop, i, t);
+}
+
+void ev_timer_init(EvTimer* t, EvTimerFn fn, void* arg) {
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+}
+
+int ev_timer_active(const EvTimer* t) {
+    return t->slot != 0;
+}
+
+int ev_timer_start(EvLoop* loop, EvTimer* t, uint64_t deadline_us) {
+    if (t->slot) {
+        /* Reschedule in place */
+        uint64_t old = t->deadline;
+        t->deadline = deadline_us;
+        if (deadline_us < old) heap_up(loop, t->slot - 1);
+        else heap_down(loop, t->slot - 1);
+        return 1;
+    }
+    if (loop->nheap == loop->capheap) {
+        size_t cap = loop->capheap ? loop->capheap * 2 : 16;
+        EvTimer** heap = realloc(loop->heap, cap * sizeof(EvTimer*));
+        if (!heap) return 0;
+        loop->heap = heap;
+        loop->capheap = cap;
+    }
+    t->deadline = deadline_us;
+    loop->heap[loop->nheap++] = t;
+    heap_up(loop, loop->nheap - 1);
+    return 1;
+}
+
+void ev_timer_stop(EvLoop* loop, EvTimer* t) {
+    if (!t->slot) return;
+    size_t i = t->slot - 1;
+    t->slot = 0;
+    EvTimer* last = loop->heap[--loop->nheap];
+    if (i == loop->nheap) return;
+    heap_set(loop, i, last);
+    heap_up(loop, i);
+    heap_down(loop, last->slot - 1);
+}
+
+static void run_timers(EvLoop* loop) {
+    uint64_t now = us_now();
+    while (loop->nheap > 0 && loop->heap[0]->deadline <= now) {
+        EvTimer* t = loop->heap[0];
+        ev_timer_stop(loop, t);
+        /* The callback may restart this timer or any other */
+        if (t->fn) t->fn(t, now);
+    }
+}
+
+/* Microseconds until the earliest timer, or -1 to wait for I/O only */
+static int64_t next_timeout(const EvLoop* loop) {
+    if (loop->nheap == 0) return -1;
+    uint64_t now = us_now();
+    uint64_t due = loop->heap[0]->deadline;
+    return due > now ? (int64_t)(due - now) : 0;
+}
+
+#if !defined(RU_HAVE_EPOLL) && !defined(RU_HAVE_KQUEUE)
+/* poll() only has millisecond resolution: round up, never wake up early */
+static int timeout_ms(int64_t us) {
+    if (us < 0) return -1;
+    if (us > 86400000000LL) return 86400000;
+    return (int)((us + 999) / 1000);
+}
+#endif
+
+int ev_init(EvLoop* loop) {
+    memset(loop, 0, sizeof(*loop));
+#if defined(RU_HAVE_EPOLL)
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) return 0;
+    loop->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (loop->tfd < 0) {
+        close(loop->epfd);
+        return 0;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = loop->tfd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->tfd, &ev) < 0) {
+        close(loop->tfd);
+        close(loop->epfd);
+        return 0;
+    }
+#elif defined(RU_HAVE_KQUEUE)
+    loop->kq = kqueue();
+    if (loop->kq < 0) return 0;
+#endif
+    return 1;
+}
+
+int ev_add(EvLoop* loop, SOCKET_TYPE sock) {
+    if (loop->nsocks == EV_MAX_SOCKETS) return 0;
+#if defined(RU_HAVE_EPOLL)
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = sock;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, sock, &ev) < 0) return 0;
+#elif defined(RU_HAVE_KQUEUE)
+    struct kevent kev;
+    EV_SET(&kev, sock, EVFILT_READ, EV_ADD, 0, 0, NULL);
+    if (kevent(loop->kq, &kev, 1, NULL, 0, NULL) < 0) return 0;
+#endif
+    loop->socks[loop->nsocks++] = sock;
+    return 1;
+}
+
+void ev_close(EvLoop* loop) {
+#if defined(RU_HAVE_EPOLL)
+    if (loop->tfd > 0) close(loop->tfd);
+    if (loop->epfd > 0) close(loop->epfd);
+#elif defined(RU_HAVE_KQUEUE)
+    if (loop->kq > 0) close(loop->kq);
+#endif
+    free(loop->heap);
+    memset(loop, 0, sizeof(*loop));
+}
+
+#if defined(RU_HAVE_EPOLL)
+/* Point the timerfd at the earliest deadline; it is absolute on the same
+ * CLOCK_MONOTONIC that us_now() reads, so no conversion drift creeps in */
+static void arm_timerfd(EvLoop* loop) {
+    uint64_t due = loop->nheap ? loop->heap[0]->deadline : 0;
+    if (due == loop->armed) return;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (due) {
+        its.it_value.tv_sec = (time_t)(due / 1000000);
+        its.it_value.tv_nsec = (long)(due % 1000000) * 1000;
+    }
+    timerfd_settime(loop->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+    loop->armed = due;
+}
+#endif
+
+int ev_wait(EvLoop* loop, SOCKET_TYPE* ready, int max) {
+    int nready = 0;
+    int64_t wait_us = next_timeout(loop);
+#if defined(RU_HAVE_EPOLL)
+    struct epoll_event evs[EV_MAX_SOCKETS + 1];
+    int timeout = 0;
+    if (wait_us != 0) {
+        arm_timerfd(loop);
+        timeout = -1;
+    }
+    int n = epoll_wait(loop->epfd, evs, EV_MAX_SOCKETS + 1, timeout);
+    if (n < 0 && errno != EINTR) return -1;
+    for (int i = 0; i < n; i++) {
+        if (evs[i].data.fd == loop->tfd) {
+            uint64_t expirations;
+            ssize_t rd = read(loop->tfd, &expirations, sizeof(expirations));
+            (void)rd;
+            loop->armed = 0;
+        } else if (nready < max) {
+            ready[nready++] = evs[i].data.fd;
+        }
+    }
+#elif defined(RU_HAVE_KQUEUE)
+    struct kevent evs[EV_MAX_SOCKETS];
+    struct timespec ts;
+    struct timespec* tsp = NULL;
+    if (wait_us >= 0) {
+        ts.tv_sec = (time_t)(wait_us / 1000000);
+        ts.tv_nsec = (long)(wait_us % 1000000) * 1000;
+        tsp = &ts;
+    }
+    int n = kevent(loop->kq, NULL, 0, evs, EV_MAX_SOCKETS, tsp);
+    if (n < 0 && errno != EINTR) return -1;
+    for (int i = 0; i < n && nready < max; i++) {
+        ready[nready++] = (SOCKET_TYPE)evs[i].ident;
+    }
+#elif defined(_WIN32)
+    WSAPOLLFD pfd[EV_MAX_SOCKETS];
+    for (size_t i = 0; i < loop->nsocks; i++) {
+        pfd[i].fd = loop->socks[i];
+        pfd[i].events = POLLRDNORM;
+        pfd[i].revents = 0;
+    }
+    int n = 0;
+    if (loop->nsocks == 0) {
+        /* WSAPoll() rejects an empty set */
+        Sleep(wait_us < 0 ? INFINITE : (DWORD)timeout_ms(wait_us));
+    } else {
+        n = WSAPoll(pfd, (ULONG)loop->nsocks, timeout_ms(wait_us));
+        if (n == SOCKET_ERROR) return -1;
+    }
+    for (size_t i = 0; i < loop->nsocks && n > 0 && nready < max; i++) {
+        if (pfd[i].revents) ready[nready++] = pfd[i].fd;
+    }
+#else
+    struct pollfd pfd[EV_MAX_SOCKETS];
+    for (size_t i = 0; i < loop->nsocks; i++) {
+        pfd[i].fd = loop->socks[i];
+        pfd[i].events = POLLIN;
+        pfd[i].revents = 0;
+    }
+    int n = poll(pfd, (nfds_t)loop->nsocks, timeout_ms(wait_us));
+    if (n < 0 && errno != EINTR) return -1;
+    for (size_t i = 0; i < loop->nsocks && n > 0 && nready < max; i++) {
+        if (pfd[i].revents) ready[nready++] = pfd[i].fd;
+    }
+#endif
+    run_timers(loop);
+    return nready;
+}
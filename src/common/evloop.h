@@ -0,0 +1,55 @@
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "platform.h"
+
+/* Readiness-based event loop: epoll (with a timerfd for microsecond timers)
+ * on Linux, kqueue on the BSDs and macOS, poll()/WSAPoll() elsewhere. Timers
+ * live in a binary heap keyed by us_now() deadlines, so a wait never sleeps
+ * past the next timer and never wakes up without work to do. */
+
+#define EV_MAX_SOCKETS 8
+
+typedef struct EvTimer EvTimer;
+typedef void (*EvTimerFn)(EvTimer* t, uint64_t now_us);
+
+struct EvTimer {
+    uint64_t deadline;      /* us_now() time it fires at */
+    EvTimerFn fn;
+    void* arg;
+    size_t slot;            /* heap position + 1, 0 while stopped */
+};
+
+typedef struct {
+#if defined(RU_HAVE_EPOLL)
+    int epfd;
+    int tfd;
+    uint64_t armed;         /* deadline the timerfd is set to, 0 if disarmed */
+#elif defined(RU_HAVE_KQUEUE)
+    int kq;
+#endif
+    SOCKET_TYPE socks[EV_MAX_SOCKETS];
+    size_t nsocks;
+    EvTimer** heap;
+    size_t nheap;
+    size_t capheap;
+} EvLoop;
+
+/* Function declarations */
+int ev_init(EvLoop* loop);
+int ev_add(EvLoop* loop, SOCKET_TYPE sock);
+void ev_close(EvLoop* loop);
+
+void ev_timer_init(EvTimer* t, EvTimerFn fn, void* arg);
+int ev_timer_start(EvLoop* loop, EvTimer* t, uint64_t deadline_us);
+void ev_timer_stop(EvLoop* loop, EvTimer* t);
+int ev_timer_active(const EvTimer* t);
+
+/* Blocks until a registered socket is readable or the earliest timer is due,
+ * then runs every expired timer. Returns the number of readable sockets
+ * stored in ready (0 when only timers fired), or -1 on error. */
+int ev_wait(EvLoop* loop, SOCKET_TYPE* ready, int max);
+
+#endif /* EVLOOP_H */
@@ -0,0 +1,217 @@
+#include "fec.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* XOR kernels. The portable path works a 64-bit word at a time; x86 uses
+ * SSE2 (always there on x86-64) or AVX2 when the CPU has it, arm64 uses
+ * NEON. Picked once at load time like the CRC kernel. */
+
+typedef void (*xor_fn)(uint8_t* dst, const uint8_t* src, size_t len);
+
+static void xor_portable(uint8_t* dst, const uint8_t* src, size_t len) {
+    while (len >= 8) {
+        uint64_t a, b;
+        memcpy(&a, dst, 8);
+        memcpy(&b, src, 8);
+        a ^= b;
+        memcpy(dst, &a, 8);
+        dst += 8;
+        src += 8;
+        len -= 8;
+    }
+    while (len--) *dst++ ^= *src++;
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RU_XOR_SSE2 1
+#include <emmintrin.h>
+
+static void xor_sse2(uint8_t* dst, const uint8_t* src, size_t len) {
+    while (len >= 64) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)dst);
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(dst + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(dst + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i*)(dst + 48));
+        a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i*)src));
+        a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i*)(src + 16)));
+        a2 = _mm_xor_si128(a2, _mm_loadu_si128((const __m128i*)(src + 32)));
+        a3 = _mm_xor_si128(a3, _mm_loadu_si128((const __m128i*)(src + 48)));
+        _mm_storeu_si128((__m128i*)dst, a0);
+        _mm_storeu_si128((__m128i*)(dst + 16), a1);
+        _mm_storeu_si128((__m128i*)(dst + 32), a2);
+        _mm_storeu_si128((__m128i*)(dst + 48), a3);
+        dst += 64;
+        src += 64;
+        len -= 64;
+    }
+    xor_portable(dst, src, len);
+}
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RU_XOR_AVX2 1
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static void xor_avx2(uint8_t* dst, const uint8_t* src, size_t len) {
+    while (len >= 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)dst);
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(dst + 32));
+        a0 = _mm256_xor_si256(a0, _mm256_loadu_si256((const __m256i*)src));
+        a1 = _mm256_xor_si256(a1, _mm256_loadu_si256((const __m256i*)(src + 32)));
+        _mm256_storeu_si256((__m256i*)dst, a0);
+        _mm256_storeu_si256((__m256i*)(dst + 32), a1);
+        dst += 64;
+        src += 64;
+        len -= 64;
+    }
+    xor_portable(dst, src, len);
+}
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define RU_XOR_NEON 1
+#include <arm_neon.h>
+
+static void xor_neon(uint8_t* dst, const uint8_t* src, size_t len) {
+    while (len >= 32) {
+        uint8x16_t a0 = veorq_u8(vld1q_u8(dst), vld1q_u8(src));
+        uint8x16_t a1 = veorq_u8(vld1q_u8(dst + 16), vld1q_u8(src + 16));
+        vst1q_u8(dst, a0);
+        vst1q_u8(dst + 16, a1);
+        dst += 32;
+        src += 32;
+        len -= 32;
+    }
+    xor_portable(dst, src, len);
+}
+#endif
+
+static xor_fn xor_impl = xor_portable;
+static const char* xor_impl_name = "portable";
+
+static void xor_select(void) {
+#ifdef RU_XOR_SSE2
+    xor_impl = xor_sse2;
+    xor_impl_name = "sse2";
+#endif
+#ifdef RU_XOR_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        xor_impl = xor_avx2;
+        xor_impl_name = "avx2";
+    }
+#endif
+#ifdef RU_XOR_NEON
+    xor_impl = xor_neon;
+    xor_impl_name = "neon";
+#endif
+}
+
+#if defined(_MSC_VER)
+#pragma section(".CRT$XCU", read)
+__declspec(allocate(".CRT$XCU")) static void (*xor_select_ctor)(void) = xor_select;
+#else
+__attribute__((constructor)) static void xor_select_ctor(void) {
+    xor_select();
+}
+#endif
+
+/* dst ^= src over len bytes */
+void fec_xor(uint8_t* dst, const uint8_t* src, size_t len) {
+    xor_impl(dst, src, len);
+}
+
+const char* fec_xor_impl(void) {
+    return xor_impl_name;
+}
+
+/* Largest group that keeps the chance of two losses in one group low:
+ * about one loss per four groups' worth of chunks */
+int fec_shift_for_loss(double loss) {
+    int shift = FEC_MAX_SHIFT;
+    while (shift > FEC_MIN_SHIFT && (double)((size_t)1 << shift) * loss * 4.0 > 1.0) shift--;
+    return shift;
+}
+
+/* The group of seq: its aligned block of 2^shift chunks, clipped to [lo, hi) */
+void fec_group_bounds(size_t seq, int shift, size_t lo, size_t hi, size_t* start, size_t* end) {
+    size_t base = seq & ~(((size_t)1 << shift) - 1);
+    *start = base > lo ? base : lo;
+    *end = base + ((size_t)1 << shift);
+    if (*end > hi) *end = hi;
+}
+
+int fec_dec_init(FecDecoder* d, size_t chunk) {
+    d->chunk = chunk;
+    d->mem = calloc(FEC_SLOTS, chunk);
+    for (int i = 0; i < FEC_SLOTS; i++) {
+        d->groups[i].start = SIZE_MAX;
+        d->groups[i].acc = d->mem ? d->mem + (size_t)i * chunk : NULL;
+    }
+    return d->mem != NULL;
+}
+
+void fec_dec_free(FecDecoder* d) {
+    if (!d) return;
+    free(d->mem);
+    d->mem = NULL;
+}
+
+static void group_reset(FecDecoder* d, FecGroup* g, size_t start, size_t end) {
+    g->start = start;
+    g->end = end;
+    g->folded = 0;
+    g->nfolded = 0;
+    g->parity = 0;
+    memset(g->acc, 0, d->chunk);
+}
+
+/* Folds a received chunk (or, with parity set, the parity packet of seq's
+ * group) into its group. Returns the group once it holds the parity and
+ * all chunks but one, so fec_dec_missing() can rebuild that one. */
+FecGroup* fec_dec_add(FecDecoder* d, size_t seq, int shift, size_t lo, size_t hi, int parity,
+                      const uint8_t* data, size_t len) {
+    if (shift < FEC_MIN_SHIFT || shift > FEC_MAX_SHIFT || len > d->chunk || seq < lo || seq >= hi) {
+        return NULL;
+    }
+    size_t start, end;
+    fec_group_bounds(seq, shift, lo, hi, &start, &end);
+    /* Numbered in units of their own size, so consecutive groups of any
+     * size take consecutive slots */
+    FecGroup* g = &d->groups[(start >> shift) % FEC_SLOTS];
+    if (g->start != start || g->end != end) group_reset(d, g, start, end);
+
+    if (parity) {
+        if (g->parity) return NULL;
+        g->parity = 1;
+    } else {
+        uint64_t bit = (uint64_t)1 << (seq - start);
+        if (g->folded & bit) return NULL;
+        g->folded |= bit;
+        g->nfolded++;
+    }
+    fec_xor(g->acc, data, len);
+
+    size_t n = end - start;
+    if ((size_t)g->nfolded == n) {
+        fec_dec_release(d, g); /* nothing left to rebuild */
+        return NULL;
+    }
+    return g->parity && (size_t)g->nfolded + 1 == n ? g : NULL;
+}
+
+/* The chunk a recoverable group lacks: its sequence number and contents,
+ * zero-padded to the chunk size */
+const uint8_t* fec_dec_missing(const FecGroup* g, size_t* seq) {
+    size_t i = 0;
+    while (g->folded & ((uint64_t)1 << i)) i++;
+    *seq = g->start + i;
+    return g->acc;
+}
+
+void fec_dec_release(FecDecoder* d, FecGroup* g) {
+    (void)d;
+    g->start = SIZE_MAX;
+    g->end = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* XOR parity forward error correction. A stream's chunks are split into
+ * aligned groups of 2^shift sequence numbers, clipped to the stream's chunk
+ * range [lo, hi). Once every chunk of a group has been sent the sender
+ * follows it with one PT_PARITY packet holding the XOR of those chunks,
+ * each zero-padded to the longest. A receiver holding all but one chunk of
+ * the group rebuilds the missing one as the XOR of the parity and the
+ * others, instead of waiting a round trip for its retransmission. The
+ * group size may change from group to group, so every DATA packet carries
+ * its group's shift. */
+
+#define FEC_MIN_SHIFT 2         /* groups of 4, 25% parity overhead */
+#define FEC_MAX_SHIFT 6         /* groups of 64, under 2% */
+#define FEC_SLOTS 32            /* groups a receiver assembles at once */
+
+/* Receive side: XOR accumulators for the FEC_SLOTS most recent groups,
+ * whatever their size. A group's slot is its index in units of its own
+ * size; a new group takes over the slot from whichever older group still
+ * holds it. */
+typedef struct {
+    size_t start;               /* first chunk, SIZE_MAX when the slot is free */
+    size_t end;
+    uint64_t folded;            /* bit i: chunk start + i is in the accumulator */
+    int nfolded;
+    int parity;                 /* the parity packet is in too */
+    uint8_t* acc;
+} FecGroup;
+
+typedef struct {
+    size_t chunk;
+    FecGroup groups[FEC_SLOTS];
+    uint8_t* mem;
+} FecDecoder;
+
+/* Function declarations */
+void fec_xor(uint8_t* dst, const uint8_t* src, size_t len);
+/* Kernel fec_xor() dispatches to: "portable", "sse2", "avx2" or "neon" */
+const char* fec_xor_impl(void);
+
+int fec_shift_for_loss(double loss);
+void fec_group_bounds(size_t seq, int shift, size_t lo, size_t hi, size_t* start, size_t* end);
+
+int fec_dec_init(FecDecoder* d, size_t chunk);
+void fec_dec_free(FecDecoder* d);
+FecGroup* fec_dec_add(FecDecoder* d, size_t seq, int shift, size_t lo, size_t hi, int parity,
+                      const uint8_t* data, size_t len);
+const uint8_t* fec_dec_missing(const FecGroup* g, size_t* seq);
+void fec_dec_release(FecDecoder* d, FecGroup* g);
+
+#endif /* FEC_H */
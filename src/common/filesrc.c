@@ -0,0 +1,145 @@
+#include "filesrc.h"
+#include "platform.h"
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/* Chunks fetched per read when the ring has room ahead of the request */
+#define READ_AHEAD 32
+/* Give mapped pages back to the kernel in steps of this many bytes */
+#define DROP_STEP (8u * 1024u * 1024u)
+
+static int ring_init(FileSource* src, const char* path, size_t ring_slots) {
+    src->fp = fopen(path, "rb");
+    if (!src->fp) return 0;
+    src->ring_slots = ring_slots ? ring_slots : 1;
+    src->ring = malloc(src->ring_slots * src->chunk);
+    src->ring_seq = malloc(src->ring_slots * sizeof(size_t));
+    src->ring_len = calloc(src->ring_slots, sizeof(size_t));
+    if (!src->ring || !src->ring_seq || !src->ring_len) return 0;
+    for (size_t i = 0; i < src->ring_slots; i++) src->ring_seq[i] = SIZE_MAX;
+    return 1;
+}
+
+/* The size of path without opening it; fails unless it is a regular file */
+int fsrc_stat(const char* path, uint64_t* size) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path, &st) != 0 || !(st.st_mode & _S_IFREG)) return 0;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+#endif
+    *size = (uint64_t)st.st_size;
+    return 1;
+}
+
+int fsrc_open(FileSource* src, const char* path, size_t chunk, size_t ring_slots) {
+    memset(src, 0, sizeof(*src));
+    src->chunk = chunk;
+    if (!fsrc_stat(path, &src->size)) return 0;
+    src->total = (size_t)((src->size + chunk - 1) / chunk);
+
+#ifndef _WIN32
+    if (src->size > 0 && (uint64_t)(size_t)src->size == src->size) {
+        int fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            void* m = mmap(NULL, (size_t)src->size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (m != MAP_FAILED) {
+                madvise(m, (size_t)src->size, MADV_SEQUENTIAL);
+                src->map = m;
+                return 1;
+            }
+        }
+    }
+#endif
+
+    if (!ring_init(src, path, ring_slots)) {
+        fsrc_close(src);
+        return 0;
+    }
+    return 1;
+}
+
+static size_t chunk_len(const FileSource* src, size_t seq) {
+    uint64_t off = (uint64_t)seq * src->chunk;
+    return (off + src->chunk > src->size) ? (size_t)(src->size - off) : src->chunk;
+}
+
+/* Load seq, and the chunks after it that have free ring slots, with one read */
+static int ring_load(FileSource* src, size_t seq) {
+    size_t slot = seq % src->ring_slots;
+    size_t n = 1;
+    while (n < READ_AHEAD && slot + n < src->ring_slots && seq + n < src->total &&
+           seq + n < src->released + src->ring_slots) {
+        size_t held = src->ring_seq[slot + n];
+        if (held != SIZE_MAX && held >= src->released) break; /* still in flight */
+        n++;
+    }
+
+    uint64_t off = (uint64_t)seq * src->chunk;
+#ifdef _WIN32
+    if (_fseeki64(src->fp, (__int64)off, SEEK_SET) != 0) return 0;
+#else
+    if (fseeko(src->fp, (off_t)off, SEEK_SET) != 0) return 0;
+#endif
+
+    size_t want = 0;
+    for (size_t i = 0; i < n; i++) want += chunk_len(src, seq + i);
+    size_t got = fread(src->ring + slot * src->chunk, 1, want, src->fp);
+
+    for (size_t i = 0; i < n; i++) {
+        size_t len = chunk_len(src, seq + i);
+        if (got < len) break;
+        src->ring_seq[slot + i] = seq + i;
+        src->ring_len[slot + i] = len;
+        got -= len;
+    }
+    return src->ring_seq[slot] == seq;
+}
+
+const uint8_t* fsrc_chunk(FileSource* src, size_t seq, size_t* len) {
+    if (seq >= src->total) return NULL;
+    if (src->map) {
+        *len = chunk_len(src, seq);
+        return src->map + (uint64_t)seq * src->chunk;
+    }
+
+    size_t slot = seq % src->ring_slots;
+    if (src->ring_seq[slot] != seq && !ring_load(src, seq)) return NULL;
+    *len = src->ring_len[slot];
+    return src->ring + slot * src->chunk;
+}
+
+void fsrc_release(FileSource* src, size_t upto) {
+    if (upto <= src->released) return;
+    src->released = upto;
+#ifndef _WIN32
+    if (src->map) {
+        /* Drop acknowledged pages so resident memory tracks the window */
+        uint64_t done = (uint64_t)upto * src->chunk;
+        if (done > src->size) done = src->size;
+        size_t edge = (size_t)(done / DROP_STEP) * DROP_STEP;
+        if (edge > src->dropped) {
+            madvise((uint8_t*)src->map + src->dropped, edge - src->dropped, MADV_DONTNEED);
+            src->dropped = edge;
+        }
+    }
+#endif
+}
+
+void fsrc_close(FileSource* src) {
+#ifndef _WIN32
+    if (src->map) munmap((void*)src->map, (size_t)src->size);
+#endif
+    if (src->fp) fclose(src->fp);
+    free(src->ring);
+    free(src->ring_seq);
+    free(src->ring_len);
+    memset(src, 0, sizeof(*src));
+}
@@ -0,0 +1,38 @@
+#ifndef FILESRC_H
+#define FILESRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Chunked read access to a file being sent. Only regular files are taken:
+ * a pipe or device has no size to announce, and opening a FIFO blocks until
+ * a writer attaches. They are mmapped on POSIX systems so chunks are served
+ * straight from the page cache; elsewhere (Windows, files that refuse to
+ * map) chunks are read into a ring of
+ * ring_slots buffers, so memory stays bounded by the send window either way.
+ * Only chunks in [released, released + ring_slots) may be requested. */
+typedef struct {
+    uint64_t size;
+    size_t chunk;
+    size_t total;
+    size_t released;        /* chunks below this are no longer needed */
+    /* mmap path */
+    const uint8_t* map;
+    size_t dropped;         /* bytes of the mapping already handed back */
+    /* read-ahead ring fallback */
+    FILE* fp;
+    uint8_t* ring;
+    size_t ring_slots;
+    size_t* ring_seq;       /* chunk held by each slot, SIZE_MAX when empty */
+    size_t* ring_len;
+} FileSource;
+
+/* Function declarations */
+int fsrc_stat(const char* path, uint64_t* size);
+int fsrc_open(FileSource* src, const char* path, size_t chunk, size_t ring_slots);
+const uint8_t* fsrc_chunk(FileSource* src, size_t seq, size_t* len);
+void fsrc_release(FileSource* src, size_t upto);
+void fsrc_close(FileSource* src);
+
+#endif /* FILESRC_H */
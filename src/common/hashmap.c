@@ -0,0 +1,99 @@
+#include "hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* splitmix64 finalizer: keys are often packed addresses whose low bits
+ * barely differ (ports), so mix every input bit into the slot index */
+static size_t hash_u64(uint64_t k) {
+    k ^= k >> 30;
+    k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27;
+    k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return (size_t)k;
+}
+
+int hmap_init(HashMap* m, size_t initial) {
+    size_t cap = 16;
+    while (cap < initial) cap <<= 1;
+    m->slots = calloc(cap, sizeof(HashEntry));
+    m->cap = m->slots ? cap : 0;
+    m->count = 0;
+    return m->slots != NULL;
+}
+
+void* hmap_get(const HashMap* m, uint64_t key) {
+    if (m->cap == 0) return NULL;
+    size_t mask = m->cap - 1;
+    for (size_t i = hash_u64(key) & mask; m->slots[i].val; i = (i + 1) & mask) {
+        if (m->slots[i].key == key) return m->slots[i].val;
+    }
+    return NULL;
+}
+
+static void insert_slot(HashEntry* slots, size_t cap, uint64_t key, void* val) {
+    size_t mask = cap - 1;
+    size_t i = hash_u64(key) & mask;
+    while (slots[i].val && slots[i].key != key) i = (i + 1) & mask;
+    slots[i].key = key;
+    slots[i].val = val;
+}
+
+static int grow(HashMap* m) {
+    size_t cap = m->cap ? m->cap * 2 : 16;
+    HashEntry* slots = calloc(cap, sizeof(HashEntry));
+    if (!slots) return 0;
+    for (size_t i = 0; i < m->cap; i++) {
+        if (m->slots[i].val) insert_slot(slots, cap, m->slots[i].key, m->slots[i].val);
+    }
+    free(m->slots);
+    m->slots = slots;
+    m->cap = cap;
+    return 1;
+}
+
+int hmap_put(HashMap* m, uint64_t key, void* val) {
+    if (!val) return 0;
+    if ((m->count + 1) * 10 > m->cap * 7 && !grow(m)) return 0;
+    size_t mask = m->cap - 1;
+    size_t i = hash_u64(key) & mask;
+    while (m->slots[i].val) {
+        if (m->slots[i].key == key) {
+            m->slots[i].val = val;
+            return 1;
+        }
+        i = (i + 1) & mask;
+    }
+    m->slots[i].key = key;
+    m->slots[i].val = val;
+    m->count++;
+    return 1;
+}
+
+void* hmap_remove(HashMap* m, uint64_t key) {
+    if (m->cap == 0) return NULL;
+    size_t mask = m->cap - 1;
+    size_t i = hash_u64(key) & mask;
+    while (m->slots[i].val && m->slots[i].key != key) i = (i + 1) & mask;
+    void* val = m->slots[i].val;
+    if (!val) return NULL;
+
+    /* Backward-shift: pull later entries of the probe run into the hole
+     * unless that would move them in front of their home slot */
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; m->slots[j].val; j = (j + 1) & mask) {
+        size_t home = hash_u64(m->slots[j].key) & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            m->slots[hole] = m->slots[j];
+            hole = j;
+        }
+    }
+    m->slots[hole].val = NULL;
+    m->count--;
+    return val;
+}
+
+void hmap_free(HashMap* m) {
+    free(m->slots);
+    memset(m, 0, sizeof(*m));
+}
@@ -0,0 +1,29 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Open-addressing hash table from 64-bit keys to non-NULL pointers. Linear
+ * probing with backward-shift deletion, so there are no tombstones and a
+ * lookup touches one or two cache lines at the usual load. The capacity is
+ * a power of two and doubles once the table is 70% full. */
+typedef struct {
+    uint64_t key;
+    void* val;              /* NULL marks an empty slot */
+} HashEntry;
+
+typedef struct {
+    HashEntry* slots;
+    size_t cap;
+    size_t count;
+} HashMap;
+
+/* Function declarations */
+int hmap_init(HashMap* m, size_t initial);
+void* hmap_get(const HashMap* m, uint64_t key);
+int hmap_put(HashMap* m, uint64_t key, void* val);
+void* hmap_remove(HashMap* m, uint64_t key);
+void hmap_free(HashMap* m);
+
+#endif /* HASHMAP_H */
@@ -0,0 +1,234 @@
+#include "netem.h"
+#include "thread.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct Held {
+    struct Held* next;
+    uint64_t due;
+    SOCKET_TYPE sock;
+    struct sockaddr_storage addr;
+    SOCKLEN_TYPE addrlen;
+    size_t len;
+    uint8_t data[];
+} Held;
+
+static struct {
+    NetemSpec spec;
+    int on;
+    ru_mutex lock;
+    ru_cond wake;
+    Held* head;
+    Held* tail;
+    size_t held;
+    uint64_t last_due;          /* held datagrams leave in order */
+    uint64_t link_free;         /* when the emulated link finishes its backlog */
+    uint64_t rng;
+    ru_thread thread;
+    int started;
+} ne;
+
+/* "1%" or "0.01" */
+static int parse_prob(const char* v, double* out) {
+    char* end;
+    double x = strtod(v, &end);
+    if (*end == '%') x /= 100, end++;
+    if (*end != '\0' || x < 0 || x > 1) return 0;
+    *out = x;
+    return 1;
+}
+
+/* "20ms", "500us", "1s"; a bare number is milliseconds */
+static int parse_time(const char* v, uint64_t* out) {
+    char* end;
+    double x = strtod(v, &end);
+    double scale = 1000;
+    if (strcmp(end, "us") == 0) scale = 1;
+    else if (strcmp(end, "s") == 0) scale = 1000000;
+    else if (*end != '\0' && strcmp(end, "ms") != 0) return 0;
+    if (x < 0) return 0;
+    *out = (uint64_t)(x * scale);
+    return 1;
+}
+
+/* Bits per second with an optional k, M or G, like --rate */
+static int parse_rate(const char* v, double* out) {
+    char* end;
+    double bits = strtod(v, &end);
+    if (*end == 'k' || *end == 'K') bits *= 1e3, end++;
+    else if (*end == 'M') bits *= 1e6, end++;
+    else if (*end == 'G') bits *= 1e9, end++;
+    if (*end != '\0' || bits < 0) return 0;
+    *out = bits / 8;
+    return 1;
+}
+
+/* Comma-separated key=value pairs: loss, dup, reorder, delay, jitter, rate,
+ * limit and seed. Returns 0 on anything it does not understand. */
+int netem_parse(NetemSpec* s, const char* spec) {
+    memset(s, 0, sizeof(*s));
+    s->limit = NETEM_DEFAULT_LIMIT;
+    s->seed = 1;
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)) return 0;
+    strcpy(buf, spec);
+    for (char* kv = strtok(buf, ","); kv; kv = strtok(NULL, ",")) {
+        char* eq = strchr(kv, '=');
+        if (!eq) return 0;
+        *eq = '\0';
+        const char* v = eq + 1;
+        int ok;
+        if (strcmp(kv, "loss") == 0) ok = parse_prob(v, &s->loss);
+        else if (strcmp(kv, "dup") == 0) ok = parse_prob(v, &s->dup);
+        else if (strcmp(kv, "reorder") == 0) ok = parse_prob(v, &s->reorder);
+        else if (strcmp(kv, "delay") == 0) ok = parse_time(v, &s->delay_us);
+        else if (strcmp(kv, "jitter") == 0) ok = parse_time(v, &s->jitter_us);
+        else if (strcmp(kv, "rate") == 0) ok = parse_rate(v, &s->rate);
+        else if (strcmp(kv, "limit") == 0) ok = (s->limit = (size_t)atol(v)) > 0;
+        else if (strcmp(kv, "seed") == 0) ok = (s->seed = (uint64_t)strtoull(v, NULL, 10)) != 0;
+        else ok = 0;
+        if (!ok) return 0;
+    }
+    if (s->jitter_us > s->delay_us) s->jitter_us = s->delay_us;
+    return 1;
+}
+
+static void netem_init(void) {
+    const char* spec = getenv(NETEM_ENV);
+    if (!spec || !*spec) return;
+    if (!netem_parse(&ne.spec, spec)) {
+        fprintf(stderr, "Ignoring bad %s: %s\n", NETEM_ENV, spec);
+        return;
+    }
+    mutex_init(&ne.lock);
+    cond_init(&ne.wake);
+    ne.rng = ne.spec.seed;
+    ne.on = 1;
+    fprintf(stderr, "%s: impairing outgoing datagrams (%s)\n", NETEM_ENV, spec);
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK netem_init_once(PINIT_ONCE once, PVOID arg, PVOID* ctx) {
+    (void)once; (void)arg; (void)ctx;
+    netem_init();
+    return TRUE;
+}
+#endif
+
+/* Whether RUFT_NETEM is set, read once per process */
+int netem_enabled(void) {
+#ifdef _WIN32
+    static INIT_ONCE once = INIT_ONCE_STATIC_INIT;
+    InitOnceExecuteOnce(&once, netem_init_once, NULL, NULL);
+#else
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, netem_init);
+#endif
+    return ne.on;
+}
+
+/* xorshift64*, uniform in [0, 1) */
+static double netem_rand(void) {
+    ne.rng ^= ne.rng >> 12;
+    ne.rng ^= ne.rng << 25;
+    ne.rng ^= ne.rng >> 27;
+    return (double)((ne.rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static void sleep_us(uint64_t us) {
+#ifdef _WIN32
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/* Sends held datagrams as they fall due; the FIFO is ordered by due time */
+static void netem_thread(void* arg) {
+    (void)arg;
+    mutex_lock(&ne.lock);
+    for (;;) {
+        while (!ne.head) cond_wait(&ne.wake, &ne.lock);
+        Held* h = ne.head;
+        uint64_t now = us_now();
+        if (h->due > now) {
+            mutex_unlock(&ne.lock);
+            sleep_us(h->due - now);
+            mutex_lock(&ne.lock);
+            continue;
+        }
+        ne.head = h->next;
+        if (!ne.head) ne.tail = NULL;
+        ne.held--;
+        mutex_unlock(&ne.lock);
+        sendto(h->sock, (const char*)h->data, (int)h->len, 0,
+               (const struct sockaddr*)&h->addr, h->addrlen);
+        free(h);
+        mutex_lock(&ne.lock);
+    }
+}
+
+/* Queues a copy of datagram i to leave after the link and delay allow */
+static void hold(const UdpTx* tx, size_t i, uint64_t now) {
+    if (ne.held >= ne.spec.limit) return; /* tail drop */
+    if (!ne.started) {
+        if (!thread_start(&ne.thread, netem_thread, NULL)) return;
+        ne.started = 1;
+    }
+    Held* h = malloc(sizeof(Held) + tx->len[i]);
+    if (!h) return;
+    uint64_t t = now;
+    if (ne.spec.rate > 0) {
+        if (ne.link_free < now) ne.link_free = now;
+        ne.link_free += (uint64_t)((double)tx->len[i] * 1e6 / ne.spec.rate);
+        t = ne.link_free;
+    }
+    t += ne.spec.delay_us;
+    if (ne.spec.jitter_us) {
+        t -= ne.spec.jitter_us;
+        t += (uint64_t)(netem_rand() * 2.0 * (double)ne.spec.jitter_us);
+    }
+    h->due = t > ne.last_due ? t : ne.last_due;
+    ne.last_due = h->due;
+    h->next = NULL;
+    h->sock = tx->sock;
+    memcpy(&h->addr, &tx->addr[i], (size_t)tx->addrlen[i]);
+    h->addrlen = tx->addrlen[i];
+    h->len = tx->len[i];
+    memcpy(h->data, tx->data + tx->off[i], tx->len[i]);
+    if (ne.tail) ne.tail->next = h;
+    else ne.head = h;
+    ne.tail = h;
+    ne.held++;
+    cond_signal(&ne.wake);
+}
+
+/* Applies the impairment to a batch about to be flushed: datagrams that go
+ * out now stay in the batch, the rest are dropped or held. */
+void netem_shape(UdpTx* tx) {
+    int immediate = ne.spec.delay_us == 0 && ne.spec.rate <= 0;
+    uint64_t now = us_now();
+    size_t keep = 0;
+    mutex_lock(&ne.lock);
+    for (size_t i = 0; i < tx->count; i++) {
+        if (ne.spec.loss > 0 && netem_rand() < ne.spec.loss) continue;
+        if (ne.spec.dup > 0 && netem_rand() < ne.spec.dup) hold(tx, i, now);
+        if (!immediate && !(ne.spec.reorder > 0 && netem_rand() < ne.spec.reorder)) {
+            hold(tx, i, now);
+            continue;
+        }
+        tx->off[keep] = tx->off[i];
+        tx->len[keep] = tx->len[i];
+        if (keep != i) {
+            memcpy(&tx->addr[keep], &tx->addr[i], (size_t)tx->addrlen[i]);
+            tx->addrlen[keep] = tx->addrlen[i];
+        }
+        keep++;
+    }
+    mutex_unlock(&ne.lock);
+    tx->count = keep;
+}
@@ -0,0 +1,37 @@
+#ifndef NETEM_H
+#define NETEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "udpio.h"
+
+/* Link impairment for testing, in the spirit of Linux netem but inside the
+ * process: every datagram udp_tx_flush() hands over may be dropped,
+ * duplicated, held back by a fixed delay plus jitter, serialised behind a
+ * bandwidth limit, or let through early so it overtakes the queue. Held
+ * datagrams wait in one FIFO per process and are sent by a helper thread
+ * when due. It is off unless the RUFT_NETEM environment variable holds a
+ * spec such as "loss=1%,delay=10ms,jitter=1ms,rate=100M", so the client
+ * and server binaries need no flag for it. Each process shapes only what
+ * it sends: give both ends half the round trip as delay. */
+
+#define NETEM_ENV "RUFT_NETEM"
+#define NETEM_DEFAULT_LIMIT 1000    /* datagrams held at once, like netem's */
+
+typedef struct {
+    double loss;                /* probability a datagram is dropped */
+    double dup;                 /* probability it is sent twice */
+    double reorder;             /* probability it skips the delay queue */
+    uint64_t delay_us;
+    uint64_t jitter_us;         /* delay varies uniformly by up to this much */
+    double rate;                /* bytes per second of the emulated link, 0 = unlimited */
+    size_t limit;               /* held datagrams beyond this are dropped */
+    uint64_t seed;
+} NetemSpec;
+
+/* Function declarations */
+int netem_parse(NetemSpec* s, const char* spec);
+int netem_enabled(void);
+void netem_shape(UdpTx* tx);
+
+#endif /* NETEM_H */
@@ -0,0 +1,38 @@
+#include "pacer.h"
+#include <string.h>
+
+void pacer_init(Pacer* p) {
+    memset(p, 0, sizeof(*p));
+}
+
+/* The burst scales with the rate so fast paths still send whole batches,
+ * but never drops below PACE_MIN_BURST datagrams */
+void pacer_set_rate(Pacer* p, double bytes_per_sec, size_t dgram) {
+    p->rate = bytes_per_sec > 0 ? bytes_per_sec : 0;
+    p->burst = p->rate * PACE_BURST_US / 1e6;
+    if (p->burst < (double)(PACE_MIN_BURST * dgram)) p->burst = (double)(PACE_MIN_BURST * dgram);
+    if (p->tokens > p->burst) p->tokens = p->burst;
+}
+
+/* Refills for the time since the last call; returns 1 if a datagram may go */
+int pacer_ready(Pacer* p, uint64_t now_us) {
+    if (p->rate <= 0) return 1;
+    if (p->last_us == 0) {
+        p->tokens = p->burst;
+    } else if (now_us > p->last_us) {
+        p->tokens += p->rate * (double)(now_us - p->last_us) / 1e6;
+        if (p->tokens > p->burst) p->tokens = p->burst;
+    }
+    p->last_us = now_us;
+    return p->tokens > 0;
+}
+
+void pacer_spend(Pacer* p, size_t bytes) {
+    if (p->rate > 0) p->tokens -= (double)bytes;
+}
+
+/* Earliest time pacer_ready() can succeed */
+uint64_t pacer_next(const Pacer* p, uint64_t now_us) {
+    if (p->rate <= 0 || p->tokens > 0) return now_us;
+    return p->last_us + (uint64_t)(-p->tokens * 1e6 / p->rate) + 1;
+}
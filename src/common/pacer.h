@@ -0,0 +1,30 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Token-bucket pacing. Every datagram spends its size in tokens, which
+ * refill at the pacing rate up to a small burst, so a window goes out
+ * spread over the round trip instead of back to back at line rate. The
+ * bucket may run into debt by one datagram; the sender waits until
+ * pacer_next() before sending again. */
+
+#define PACE_BURST_US 500       /* refill held back for at most this long */
+#define PACE_MIN_BURST 2        /* datagrams, at any rate */
+
+typedef struct {
+    double rate;                /* bytes per second, 0 = unpaced */
+    double tokens;              /* bytes that may go out now, negative = debt */
+    double burst;
+    uint64_t last_us;
+} Pacer;
+
+/* Function declarations */
+void pacer_init(Pacer* p);
+void pacer_set_rate(Pacer* p, double bytes_per_sec, size_t dgram);
+int pacer_ready(Pacer* p, uint64_t now_us);
+void pacer_spend(Pacer* p, size_t bytes);
+uint64_t pacer_next(const Pacer* p, uint64_t now_us);
+
+#endif /* PACER_H */
@@ -1,37 +1,62 @@
-#ifndef PLATFORM_H
-#define PLATFORM_H
-
-#ifdef _WIN32
-    #include <winsock2.h>
-    #include <ws2tcpip.h>
-    #include <windows.h>
-    #include <direct.h>
-    #include <sys/timeb.h>
-    #include <winsock.h>
-    #define SOCKET_TYPE SOCKET
-    #define INVALID_SOCKET_TYPE INVALID_SOCKET
-    #define CLOSE_SOCKET closesocket
-    #define MKDIR(dir) _mkdir(dir)
-    #define GET_TIME(tb) _ftime(tb)
-    #define TIME_TYPE struct _timeb
-    #define MILLISECONDS(tb) (tb.time * 1000 + tb.millitm)
-#else
-    #include <sys/socket.h>
-    #include <netinet/in.h>
-    #include <arpa/inet.h>
-    #include <netdb.h>
-    #include <unistd.h>
-    #include <sys/time.h>
-    #include <sys/stat.h>
-    #include <fcntl.h>
-    #include <errno.h>
-    #define SOCKET_TYPE int
-    #define INVALID_SOCKET_TYPE -1
-    #define CLOSE_SOCKET close
-    #define MKDIR(dir) mkdir(dir, 0755)
-    #define GET_TIME(tb) gettimeofday(&tb, NULL)
-    #define TIME_TYPE struct timeval
-    #define MILLISECONDS(tb) (tb.tv_sec * 1000 + tb.tv_usec / 1000)
-#endif
-
-#endif /* PLATFORM_H */
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <windows.h>
+    #include <direct.h>
+    #include <sys/timeb.h>
+    #include <winsock.h>
+    #define SOCKET_TYPE SOCKET
+    #define INVALID_SOCKET_TYPE INVALID_SOCKET
+    #define CLOSE_SOCKET closesocket
+    #define MKDIR(dir) _mkdir(dir)
+    #define GET_TIME(tb) _ftime(tb)
+    #define TIME_TYPE struct _timeb
+    #define MILLISECONDS(tb) (tb.time * 1000 + tb.millitm)
+    #define SOCKLEN_TYPE int
+    #define SOCKET_WOULDBLOCK() (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <netdb.h>
+    #include <unistd.h>
+    #include <sys/time.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <errno.h>
+    #define SOCKET_TYPE int
+    #define INVALID_SOCKET_TYPE -1
+    #define CLOSE_SOCKET close
+    #define MKDIR(dir) mkdir(dir, 0755)
+    #define GET_TIME(tb) gettimeofday(&tb, NULL)
+    #define TIME_TYPE struct timeval
+    #define MILLISECONDS(tb) (tb.tv_sec * 1000 + tb.tv_usec / 1000)
+    #define SOCKLEN_TYPE socklen_t
+    #define SOCKET_WOULDBLOCK() (errno == EAGAIN || errno == EWOULDBLOCK)
+#endif
+
+/* Batched datagram syscalls (sendmmsg/recvmmsg) and UDP GSO/GRO */
+#if defined(__linux__)
+    #define RU_HAVE_MMSG 1
+    #define RU_HAVE_UDP_GSO 1
+#endif
+
+/* SO_REUSEPORT groups that spread datagrams across sockets by 4-tuple hash */
+#if defined(__linux__)
+    #define RU_REUSEPORT_LB SO_REUSEPORT
+#elif defined(__FreeBSD__) && defined(SO_REUSEPORT_LB)
+    #define RU_REUSEPORT_LB SO_REUSEPORT_LB
+#endif
+
+/* Readiness backend for the event loop; everything else uses poll()/WSAPoll() */
+#if defined(__linux__)
+    #define RU_HAVE_EPOLL 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+      defined(__NetBSD__) || defined(__DragonFly__)
+    #define RU_HAVE_KQUEUE 1
+#endif
+
+#endif /* PLATFORM_H */
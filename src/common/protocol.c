@@ -1,87 +1,337 @@
-#include "protocol.h"
-#include "crc32.h"
-#include "platform.h"
-#include <string.h>
-#include <stdlib.h>
-
-uint8_t* pack(const Packet* p, size_t* packed_size) {
-    *packed_size = HEADER_SIZE + p->payload_size;
-    uint8_t* out = malloc(*packed_size);
-    if (!out) return NULL;
-
-    out[0] = p->magic0;
-    out[1] = p->magic1;
-    out[2] = p->version;
-    out[3] = p->ptype;
-
-    uint32_t seq_n = htonl(p->seq);
-    uint32_t total_n = htonl(p->total);
-    uint16_t len_n = htons((uint16_t)p->payload_size);
-    uint16_t win_n = htons(p->window);
-    uint32_t chk = p->checksum;
-
-    /* Calculate checksum for DATA packets if not already set */
-    if (p->ptype == PT_DATA && chk == 0 && p->payload && p->payload_size > 0) {
-        chk = ru_crc32(p->payload, p->payload_size);
-    }
-    uint32_t chk_n = htonl(chk);
-
-    memcpy(&out[4], &seq_n, 4);
-    memcpy(&out[8], &total_n, 4);
-    memcpy(&out[12], &len_n, 2);
-    memcpy(&out[14], &win_n, 2);
-    memcpy(&out[16], &chk_n, 4);
-
-    if (p->payload_size > 0 && p->payload) {
-        memcpy(&out[HEADER_SIZE], p->payload, p->payload_size);
-    }
-    return out;
-}
-
-int unpack(const uint8_t* buf, size_t n, Packet* p) {
-    if (n < HEADER_SIZE) return -1; /* short packet */
-    
-    p->magic0 = buf[0];
-    p->magic1 = buf[1];
-    p->version = buf[2];
-    p->ptype = buf[3];
-    
-    if (p->magic0 != 'R' || p->magic1 != 'U' || p->version != VERSION) {
-        return -2; /* bad magic/version */
-    }
-    
-    uint32_t seq_n, total_n, chk_n;
-    uint16_t len_n, win_n;
-    memcpy(&seq_n, &buf[4], 4);
-    memcpy(&total_n, &buf[8], 4);
-    memcpy(&len_n, &buf[12], 2);
-    memcpy(&win_n, &buf[14], 2);
-    memcpy(&chk_n, &buf[16], 4);
-
-    p->seq = ntohl(seq_n);
-    p->total = ntohl(total_n);
-    p->length = ntohs(len_n);
-    p->window = ntohs(win_n);
-    p->checksum = ntohl(chk_n);
-
-    if (HEADER_SIZE + p->length > n) return -3; /* length mismatch */
-    
-    p->payload_size = p->length;
-    if (p->payload_size > 0) {
-        p->payload = malloc(p->payload_size);
-        if (!p->payload) return -4; /* memory allocation failed */
-        memcpy(p->payload, &buf[HEADER_SIZE], p->payload_size);
-    } else {
-        p->payload = NULL;
-    }
-    
-    return 0; /* success */
-}
-
-void free_packet(Packet* p) {
-    if (p->payload) {
-        free(p->payload);
-        p->payload = NULL;
-    }
-    p->payload_size = 0;
-}
+#include "protocol.h"
+#include "crc32.h"
+#include "platform.h"
+#include <string.h>
+#include <stdlib.h>
+
+size_t pack_into(uint8_t* out, size_t cap, const Packet* p) {
+    size_t packed_size = HEADER_SIZE + p->payload_size;
+    if (packed_size > cap || p->payload_size > 0xFFFFu) return 0;
+
+    out[0] = p->magic0;
+    out[1] = p->magic1;
+    out[2] = p->version;
+    out[3] = p->ptype;
+
+    uint32_t seq_n = htonl(p->seq);
+    uint32_t total_n = htonl(p->total);
+    uint16_t len_n = htons((uint16_t)p->payload_size);
+    uint16_t win_n = htons(p->window);
+    uint32_t chk = p->checksum;
+
+    /* Calculate checksum for DATA packets if not already set */
+    if (p->ptype == PT_DATA && chk == 0 && p->payload && p->payload_size > 0) {
+        chk = ru_crc32(p->payload, p->payload_size);
+    }
+    uint32_t chk_n = htonl(chk);
+    uint16_t stream_n = htons(p->stream);
+
+    memcpy(&out[4], &seq_n, 4);
+    memcpy(&out[8], &total_n, 4);
+    memcpy(&out[12], &len_n, 2);
+    memcpy(&out[14], &win_n, 2);
+    memcpy(&out[16], &chk_n, 4);
+    memcpy(&out[20], &stream_n, 2);
+    out[22] = p->flags;
+    out[23] = 0; /* reserved */
+
+    if (p->payload_size > 0 && p->payload) {
+        memcpy(&out[HEADER_SIZE], p->payload, p->payload_size);
+    }
+    return packed_size;
+}
+
+/* A PT_ERROR for the sender of req, a datagram of another version, in a
+ * header that version parses: 20 bytes without a stream id for version 1,
+ * today's 24 for version 2, which only lacked the TLV handshake. Newer
+ * versions get ours, which they can be expected to know. Returns the size,
+ * 0 if req is too short for its own header or the reply does not fit. */
+size_t pack_version_error(uint8_t* out, size_t cap, const uint8_t* req, size_t n, const char* msg) {
+    size_t len = strlen(msg);
+    if (n < 4) return 0;
+    if (req[2] == 1) {
+        if (n < HEADER_SIZE_V1 || HEADER_SIZE_V1 + len > cap) return 0;
+        memset(out, 0, HEADER_SIZE_V1);
+        out[0] = 'R';
+        out[1] = 'U';
+        out[2] = 1;
+        out[3] = PT_ERROR;
+        out[12] = (uint8_t)(len >> 8);
+        out[13] = (uint8_t)len;
+        memcpy(out + HEADER_SIZE_V1, msg, len);
+        return HEADER_SIZE_V1 + len;
+    }
+    if (n < HEADER_SIZE) return 0;
+    Packet p;
+    memset(&p, 0, sizeof(p));
+    p.magic0 = 'R';
+    p.magic1 = 'U';
+    p.version = req[2] < VERSION ? req[2] : VERSION;
+    p.ptype = PT_ERROR;
+    p.stream = (uint16_t)((req[20] << 8) | req[21]);
+    p.payload = (uint8_t*)msg;
+    p.payload_size = len;
+    return pack_into(out, cap, &p);
+}
+
+uint8_t* pack(const Packet* p, size_t* packed_size) {
+    *packed_size = HEADER_SIZE + p->payload_size;
+    uint8_t* out = malloc(*packed_size);
+    if (!out) return NULL;
+    if (pack_into(out, *packed_size, p) == 0) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+int unpack_view(const uint8_t* buf, size_t n, Packet* p) {
+    if (n < HEADER_SIZE) return -1; /* short packet */
+    
+    p->magic0 = buf[0];
+    p->magic1 = buf[1];
+    p->version = buf[2];
+    p->ptype = buf[3];
+    
+    if (p->magic0 != 'R' || p->magic1 != 'U' || p->version != VERSION) {
+        return -2; /* bad magic/version */
+    }
+    
+    uint32_t seq_n, total_n, chk_n;
+    uint16_t len_n, win_n, stream_n;
+    memcpy(&seq_n, &buf[4], 4);
+    memcpy(&total_n, &buf[8], 4);
+    memcpy(&len_n, &buf[12], 2);
+    memcpy(&win_n, &buf[14], 2);
+    memcpy(&chk_n, &buf[16], 4);
+    memcpy(&stream_n, &buf[20], 2);
+
+    p->seq = ntohl(seq_n);
+    p->total = ntohl(total_n);
+    p->length = ntohs(len_n);
+    p->window = ntohs(win_n);
+    p->checksum = ntohl(chk_n);
+    p->stream = ntohs(stream_n);
+    p->flags = buf[22];
+
+    if (HEADER_SIZE + p->length > n) return -3; /* length mismatch */
+    
+    p->payload_size = p->length;
+    p->payload = p->payload_size > 0 ? (uint8_t*)&buf[HEADER_SIZE] : NULL;
+    return 0; /* success */
+}
+
+int unpack(const uint8_t* buf, size_t n, Packet* p) {
+    int rc = unpack_view(buf, n, p);
+    if (rc != 0) return rc;
+    
+    if (p->payload_size > 0) {
+        uint8_t* copy = malloc(p->payload_size);
+        if (!copy) return -4; /* memory allocation failed */
+        memcpy(copy, p->payload, p->payload_size);
+        p->payload = copy;
+    }
+    
+    return 0; /* success */
+}
+
+void free_packet(Packet* p) {
+    if (p->payload) {
+        free(p->payload);
+        p->payload = NULL;
+    }
+    p->payload_size = 0;
+}
+
+int sack_has(const Packet* p, uint32_t seq) {
+    if (seq < p->seq) return 1;
+    if (seq == p->seq) return 0;
+    size_t bit = (size_t)(seq - p->seq - 1);
+    if (bit / 8 >= p->payload_size) return 0;
+    return (p->payload[bit / 8] >> (bit % 8)) & 1;
+}
+
+void put_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+uint32_t get_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* CAP_FEC SACK: reads the rebuilt count and leaves p's payload at the
+ * bitmap behind it; 0 if the payload is too short to hold the count */
+int sack_take_recovered(Packet* p, uint32_t* recovered) {
+    if (p->payload_size < SACK_RECOVERED_SIZE) return 0;
+    *recovered = get_be32(p->payload);
+    p->payload += SACK_RECOVERED_SIZE;
+    p->payload_size -= SACK_RECOVERED_SIZE;
+    return 1;
+}
+
+void put_be64(uint8_t* p, uint64_t v) {
+    put_be32(p, (uint32_t)(v >> 32));
+    put_be32(p + 4, (uint32_t)v);
+}
+
+uint64_t get_be64(const uint8_t* p) {
+    return ((uint64_t)get_be32(p) << 32) | get_be32(p + 4);
+}
+
+/* Writes the set ranges of have at or after from; returns the bytes used */
+size_t resume_encode(uint8_t* out, size_t cap, const Bitmap* have, size_t from) {
+    size_t n = 0;
+    size_t i = bm_next_set(have, from);
+    while (i < have->nbits && n + 8 <= cap) {
+        size_t end = bm_next_clear(have, i);
+        put_be32(out + n, (uint32_t)i);
+        put_be32(out + n + 4, (uint32_t)end);
+        n += 8;
+        i = bm_next_set(have, end);
+    }
+    return n;
+}
+
+/* Sets every chunk below first and in the listed ranges */
+void resume_decode(uint32_t first, const uint8_t* ranges, size_t len, Bitmap* have) {
+    for (size_t i = 0; i < first && i < have->nbits; i++) bm_set(have, i);
+    for (size_t off = 0; off + 8 <= len; off += 8) {
+        uint32_t start = get_be32(ranges + off);
+        uint32_t end = get_be32(ranges + off + 4);
+        for (size_t i = start; i < end && i < have->nbits; i++) bm_set(have, i);
+    }
+}
+
+void tlv_init(TlvBuf* b, uint8_t* buf, size_t cap) {
+    b->buf = buf;
+    b->cap = cap;
+    b->len = 0;
+    b->overflow = 0;
+}
+
+void tlv_put(TlvBuf* b, uint8_t type, const void* val, size_t len) {
+    if (len > 0xFFFFu || b->cap - b->len < 3 + len) {
+        b->overflow = 1;
+        return;
+    }
+    uint8_t* o = b->buf + b->len;
+    o[0] = type;
+    o[1] = (uint8_t)(len >> 8);
+    o[2] = (uint8_t)len;
+    if (len) memcpy(o + 3, val, len);
+    b->len += 3 + len;
+}
+
+void tlv_put_u32(TlvBuf* b, uint8_t type, uint32_t v) {
+    uint8_t be[4];
+    put_be32(be, v);
+    tlv_put(b, type, be, 4);
+}
+
+void tlv_put_u64(TlvBuf* b, uint8_t type, uint64_t v) {
+    uint8_t be[8];
+    put_be64(be, v);
+    tlv_put(b, type, be, 8);
+}
+
+/* The option at *off, which is then moved past it. Returns 1 for an
+ * option, 0 at the end of buf and -1 if the last option is cut short. */
+int tlv_next(const uint8_t* buf, size_t n, size_t* off, Tlv* t) {
+    if (*off >= n) return 0;
+    if (n - *off < 3) return -1;
+    const uint8_t* o = buf + *off;
+    t->type = o[0];
+    t->len = ((size_t)o[1] << 8) | o[2];
+    if (n - *off - 3 < t->len) return -1;
+    t->val = o + 3;
+    *off += 3 + t->len;
+    return 1;
+}
+
+uint32_t tlv_u32(const Tlv* t) {
+    return get_be32(t->val);
+}
+
+uint64_t tlv_u64(const Tlv* t) {
+    return get_be64(t->val);
+}
+
+/* PT_HANDSHAKE payload for hs; returns its size, 0 if it does not fit */
+size_t hs_encode(uint8_t* out, size_t cap, const Handshake* hs) {
+    TlvBuf b;
+    tlv_init(&b, out, cap);
+    tlv_put(&b, HS_NAME, hs->name, strlen(hs->name));
+    tlv_put_u64(&b, HS_SIZE, hs->size);
+    tlv_put_u32(&b, HS_CHUNK, hs->chunk);
+    if (hs->caps) tlv_put_u32(&b, HS_CAPS, hs->caps);
+    if (hs->caps & CAP_RESUME) tlv_put_u32(&b, HS_ID, hs->id);
+    if (hs->caps & CAP_STRIPE) {
+        uint8_t flow[10];
+        put_be32(flow, (uint32_t)(hs->xfer >> 32));
+        put_be32(flow + 4, (uint32_t)hs->xfer);
+        flow[8] = hs->flow;
+        flow[9] = hs->nflows;
+        tlv_put(&b, HS_FLOW, flow, sizeof(flow));
+    }
+    if (hs->caps & CAP_COMPRESS) tlv_put(&b, HS_CODEC, hs->codecs, hs->ncodecs);
+    return b.overflow ? 0 : b.len;
+}
+
+/* Reads a PT_HANDSHAKE payload. Returns 0 if it is malformed or lacks a
+ * required option; a CAP_* bit whose parameter is missing is dropped. */
+int hs_parse(const uint8_t* buf, size_t n, Handshake* hs) {
+    memset(hs, 0, sizeof(*hs));
+    int have = 0, rc;
+    size_t off = 0;
+    Tlv t;
+    while ((rc = tlv_next(buf, n, &off, &t)) > 0) {
+        switch (t.type) {
+        case HS_NAME:
+            if (t.len == 0 || t.len > HS_FIELD_MAX || memchr(t.val, '\0', t.len)) return 0;
+            memcpy(hs->name, t.val, t.len);
+            hs->name[t.len] = '\0';
+            have |= 1;
+            break;
+        case HS_SIZE:
+            if (t.len != 8) return 0;
+            hs->size = tlv_u64(&t);
+            have |= 2;
+            break;
+        case HS_CHUNK:
+            if (t.len != 4) return 0;
+            hs->chunk = tlv_u32(&t);
+            have |= 4;
+            break;
+        case HS_CAPS:
+            if (t.len != 4) return 0;
+            hs->caps = tlv_u32(&t);
+            break;
+        case HS_ID:
+            if (t.len != 4) return 0;
+            hs->id = tlv_u32(&t);
+            have |= 8;
+            break;
+        case HS_FLOW:
+            if (t.len != 10) return 0;
+            hs->xfer = tlv_u64(&t);
+            hs->flow = t.val[8];
+            hs->nflows = t.val[9];
+            have |= 16;
+            break;
+        case HS_CODEC:
+            hs->ncodecs = t.len < sizeof(hs->codecs) ? t.len : sizeof(hs->codecs);
+            memcpy(hs->codecs, t.val, hs->ncodecs);
+            break;
+        default:
+            break; /* from a newer client */
+        }
+    }
+    if (rc < 0 || (have & 7) != 7) return 0;
+    if (!(have & 8)) hs->caps &= ~(uint32_t)CAP_RESUME;
+    if (!(have & 16)) hs->caps &= ~(uint32_t)CAP_STRIPE;
+    if (!hs->ncodecs) hs->caps &= ~(uint32_t)CAP_COMPRESS;
+    return 1;
+}
@@ -3,9 +3,12 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "bitmap.h"
 
-#define VERSION 1
-#define HEADER_SIZE 20
+#define VERSION 3
+#define HEADER_SIZE 24
+#define HEADER_SIZE_V1 20   /* version 1 had no stream or flags */
+#define MAX_PACKET (HEADER_SIZE + 65535)
 
 typedef enum {
     PT_HANDSHAKE = 0,
@@ -14,9 +17,104 @@ typedef enum {
     PT_ACK = 3,
     PT_FIN = 4,
     PT_FIN_ACK = 5,
-    PT_ERROR = 6
+    PT_ERROR = 6,
+    PT_SACK = 7,
+    PT_PROBE = 8,
+    PT_PROBE_ACK = 9,
+    PT_PARITY = 10
 } PacketType;
 
+/* Header flags */
+#define PF_FEC_MASK 0x07    /* DATA, PARITY: low bits hold log2 of the parity group size, 0 = none */
+#define PF_COMPRESSED 0x10  /* DATA: payload compressed with the transfer's codec */
+#define PF_EARLY 0x20       /* DATA, FIN: sent before the HANDSHAKE_ACK; such a FIN only closes a complete transfer */
+
+/* PT_SACK: seq is the next sequence the receiver expects (everything below it
+ * has arrived) and total the file's chunk count. The payload is a bitmap of
+ * packets received beyond that point: bit i (LSB first within each byte) set
+ * means seq + 1 + i is held. With CAP_FEC agreed the bitmap is preceded by
+ * a u32 count of the chunks rebuilt from parity so far, so the sender can
+ * tell the loss rate the parity hides. */
+#define SACK_MAX_BYTES 1024
+#define SACK_RECOVERED_SIZE 4
+
+/* PT_PARITY: seq is the first chunk of a parity group (see fec.h) and the
+ * payload the XOR of the group's chunks, checksummed like DATA. */
+
+/* PT_HANDSHAKE: total is the file's chunk count and window the most packets
+ * the client will have in flight; the payload is a run of options, each a
+ * type byte, a big-endian u16 length and that many value bytes. Integers
+ * are big-endian. Options a receiver does not know are skipped, so adding
+ * one needs no new VERSION. NAME, SIZE and CHUNK are required; the CAP_*
+ * bits in CAPS ask for features, some of which bring a parameter option.
+ * PT_HANDSHAKE_ACK: seq is the first chunk the server still needs and
+ * window the receive window it grants; its CAPS holds the requested bits it
+ * accepted, along with the parameters it chose. */
+enum {
+    HS_NAME = 1,            /* relative path, '/'-separated, no NUL */
+    HS_SIZE = 2,            /* u64 file size in bytes */
+    HS_CHUNK = 3,           /* u32 chunk size */
+    HS_CAPS = 4,            /* u32 CAP_* bits */
+    HS_ID = 5,              /* u32 content fingerprint (CAP_RESUME) */
+    HS_FLOW = 6,            /* u64 transfer id, u8 flow, u8 flow count (CAP_STRIPE) */
+    HS_CODEC = 7,           /* codec ids (compress.h) in order of preference;
+                               the ACK carries the one chosen (CAP_COMPRESS) */
+    HS_RANGES = 8           /* ACK: chunks held past seq (CAP_RESUME) */
+};
+
+#define CAP_RESUME 0x01     /* keep a partial upload to resume; ACK lists what is in */
+#define CAP_STRIPE 0x02     /* one flow of a file striped over several */
+#define CAP_FEC 0x04        /* parity packets follow each group of chunks */
+#define CAP_COMPRESS 0x08   /* DATA payloads may be compressed */
+#define CAP_DIGEST 0x10     /* the server checks the digest in the FIN */
+
+/* PT_FIN: the payload is the u64 digest (digest.h) of the chunks in the
+ * flow's range [lo, hi); with CAP_DIGEST agreed the server acknowledges it
+ * only once the file it wrote matches, and answers PT_ERROR otherwise. */
+#define FIN_DIGEST_SIZE 8
+
+#define HS_FIELD_MAX 511    /* longest option value a handshake may need */
+#define MIN_CHUNK 256       /* smallest chunk a server accepts, bounding its bitmaps */
+
+typedef struct {
+    char name[HS_FIELD_MAX + 1];
+    uint64_t size;
+    uint32_t chunk;
+    uint32_t caps;
+    uint32_t id;
+    uint64_t xfer;
+    uint8_t flow;
+    uint8_t nflows;
+    uint8_t codecs[4];      /* offered, or with an ACK the one chosen */
+    size_t ncodecs;
+} Handshake;
+
+/* HS_RANGES: further chunk ranges the server already holds as big-endian
+ * u32 (start, end) pairs, end exclusive. The list may be cut short to fit;
+ * the client then just resends chunks the server already has. */
+#define RESUME_MAX_BYTES 1200
+/* Largest PT_HANDSHAKE_ACK payload: the ranges and the other options */
+#define HS_ACK_MAX (RESUME_MAX_BYTES + 32)
+
+/* PT_PROBE: a path MTU probe sent with the don't-fragment bit set, padded to
+ * the datagram size under test. PT_PROBE_ACK: seq is the size of the probe
+ * datagram that arrived (header included). Neither belongs to a transfer. */
+
+/* Option writer over a caller's buffer; a put that does not fit sets
+ * overflow and leaves the buffer as it was */
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    int overflow;
+} TlvBuf;
+
+typedef struct {
+    uint8_t type;
+    size_t len;
+    const uint8_t* val;
+} Tlv;
+
 typedef struct {
     uint8_t magic0;
     uint8_t magic1;
@@ -27,6 +125,8 @@ typedef struct {
     uint16_t length;
     uint16_t window;
     uint32_t checksum; /* CRC32 for DATA, 0 for control */
+    uint16_t stream;   /* transfer within the client's address, echoed in replies */
+    uint8_t flags;     /* PF_* bits, 0 when unused */
     uint8_t* payload;
     size_t payload_size;
 } Packet;
@@ -36,4 +136,31 @@ uint8_t* pack(const Packet* p, size_t* packed_size);
 int unpack(const uint8_t* buf, size_t n, Packet* p);
 void free_packet(Packet* p);
 
+/* Allocation-free variants for the data path. pack_into() serializes into buf
+ * and returns the packet size, or 0 if cap is too small. unpack_view() leaves
+ * p->payload pointing into buf: it is only valid while buf is, and must not
+ * be passed to free_packet(). */
+size_t pack_into(uint8_t* buf, size_t cap, const Packet* p);
+int unpack_view(const uint8_t* buf, size_t n, Packet* p);
+size_t pack_version_error(uint8_t* out, size_t cap, const uint8_t* req, size_t n, const char* msg);
+int sack_has(const Packet* p, uint32_t seq);
+int sack_take_recovered(Packet* p, uint32_t* recovered);
+size_t resume_encode(uint8_t* out, size_t cap, const Bitmap* have, size_t from);
+void resume_decode(uint32_t first, const uint8_t* ranges, size_t len, Bitmap* have);
+
+void tlv_init(TlvBuf* b, uint8_t* buf, size_t cap);
+void tlv_put(TlvBuf* b, uint8_t type, const void* val, size_t len);
+void tlv_put_u32(TlvBuf* b, uint8_t type, uint32_t v);
+void tlv_put_u64(TlvBuf* b, uint8_t type, uint64_t v);
+int tlv_next(const uint8_t* buf, size_t n, size_t* off, Tlv* t);
+uint32_t tlv_u32(const Tlv* t);
+uint64_t tlv_u64(const Tlv* t);
+void put_be32(uint8_t* p, uint32_t v);
+uint32_t get_be32(const uint8_t* p);
+void put_be64(uint8_t* p, uint64_t v);
+uint64_t get_be64(const uint8_t* p);
+
+size_t hs_encode(uint8_t* out, size_t cap, const Handshake* hs);
+int hs_parse(const uint8_t* buf, size_t n, Handshake* hs);
+
 #endif /* PROTOCOL_H */
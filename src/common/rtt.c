@@ -0,0 +1,64 @@
+#include "rtt.h"
+
+/* Floor on the variance term, in microseconds: RFC 6298's clock
+ * granularity, raised because on a path with steady delay RTTVAR decays
+ * to almost nothing and RTO would sit a hair above srtt. The timer then
+ * fires while a hole the SACKs already reported is being resent, or
+ * behind a paced packet that has not been acknowledged yet. The floor is
+ * srtt / 2, and never less than 1 ms, so RTO stays at least 1.5 srtt. */
+#define RTT_MIN_VAR 1000u
+
+static uint64_t clamp_rto(const RttEstimator* r, uint64_t v) {
+    if (v < r->min_rto) v = r->min_rto;
+    if (v > r->max_rto) v = r->max_rto;
+    return v;
+}
+
+static uint64_t base_rto(const RttEstimator* r) {
+    uint64_t var = 4 * r->rttvar;
+    uint64_t floor = r->srtt / 2 > RTT_MIN_VAR ? r->srtt / 2 : RTT_MIN_VAR;
+    if (var < floor) var = floor;
+    return clamp_rto(r, r->srtt + var);
+}
+
+void rtt_init(RttEstimator* r, uint64_t initial_rto, uint64_t min_rto, uint64_t max_rto) {
+    r->srtt = 0;
+    r->rttvar = 0;
+    r->min_rto = min_rto;
+    r->max_rto = max_rto < min_rto ? min_rto : max_rto;
+    r->has_sample = 0;
+    r->backoff = 0;
+    r->rto = clamp_rto(r, initial_rto);
+}
+
+void rtt_sample(RttEstimator* r, uint64_t sample) {
+    if (!r->has_sample) {
+        r->srtt = sample;
+        r->rttvar = sample / 2;
+        r->has_sample = 1;
+    } else {
+        uint64_t err = r->srtt > sample ? r->srtt - sample : sample - r->srtt;
+        r->rttvar = (3 * r->rttvar + err) / 4;
+        r->srtt = (7 * r->srtt + sample) / 8;
+    }
+    r->backoff = 0;
+    r->rto = base_rto(r);
+}
+
+void rtt_backoff(RttEstimator* r) {
+    r->backoff++;
+    r->rto = clamp_rto(r, r->rto * 2);
+}
+
+/* New data was acknowledged, so the path is alive again even if every packet
+ * the ACK covered had been resent and yielded no sample: drop the backoff
+ * like TCP does rather than keep doubling until a clean sample shows up */
+void rtt_progress(RttEstimator* r) {
+    if (!r->has_sample || r->backoff == 0) return;
+    r->backoff = 0;
+    r->rto = base_rto(r);
+}
+
+uint64_t rtt_rto(const RttEstimator* r) {
+    return r->rto;
+}
@@ -0,0 +1,26 @@
+#ifndef RTT_H
+#define RTT_H
+
+#include <stdint.h>
+
+/* Smoothed RTT / RTTVAR estimator with exponential backoff (RFC 6298).
+ * All values are in microseconds. Callers must only feed samples from
+ * packets that were never retransmitted (Karn's rule). */
+typedef struct {
+    uint64_t srtt;
+    uint64_t rttvar;
+    uint64_t rto;
+    uint64_t min_rto;
+    uint64_t max_rto;
+    int has_sample;
+    unsigned backoff;   /* consecutive timeouts since the last sample */
+} RttEstimator;
+
+/* Function declarations */
+void rtt_init(RttEstimator* r, uint64_t initial_rto, uint64_t min_rto, uint64_t max_rto);
+void rtt_sample(RttEstimator* r, uint64_t sample);
+void rtt_backoff(RttEstimator* r);
+void rtt_progress(RttEstimator* r);
+uint64_t rtt_rto(const RttEstimator* r);
+
+#endif /* RTT_H */
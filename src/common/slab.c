@@ -0,0 +1,62 @@
+#include "slab.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_ALIGN 16
+
+struct SlabBlock {
+    SlabBlock* next;
+    /* keep the first object aligned after the header */
+    unsigned char pad[SLAB_ALIGN - sizeof(SlabBlock*) % SLAB_ALIGN];
+};
+
+void slab_init(Slab* s, size_t obj_size, size_t per_block) {
+    memset(s, 0, sizeof(*s));
+    if (obj_size < sizeof(void*)) obj_size = sizeof(void*);
+    s->obj_size = (obj_size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+    s->per_block = per_block ? per_block : 1;
+}
+
+static int add_block(Slab* s) {
+    SlabBlock* b = malloc(sizeof(SlabBlock) + s->obj_size * s->per_block);
+    if (!b) return 0;
+    b->next = s->blocks;
+    s->blocks = b;
+    unsigned char* objs = (unsigned char*)(b + 1);
+    /* Thread the new objects onto the free list, lowest address first */
+    for (size_t i = s->per_block; i-- > 0; ) {
+        void* obj = objs + i * s->obj_size;
+        *(void**)obj = s->free_list;
+        s->free_list = obj;
+    }
+    return 1;
+}
+
+/* Returns a zeroed object, or NULL when the heap is exhausted */
+void* slab_alloc(Slab* s) {
+    if (!s->free_list && !add_block(s)) return NULL;
+    void* obj = s->free_list;
+    s->free_list = *(void**)obj;
+    memset(obj, 0, s->obj_size);
+    s->in_use++;
+    return obj;
+}
+
+void slab_free(Slab* s, void* obj) {
+    if (!obj) return;
+    *(void**)obj = s->free_list;
+    s->free_list = obj;
+    s->in_use--;
+}
+
+void slab_destroy(Slab* s) {
+    SlabBlock* b = s->blocks;
+    while (b) {
+        SlabBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    s->blocks = NULL;
+    s->free_list = NULL;
+    s->in_use = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+/* Fixed-size object allocator: objects are carved out of blocks of
+ * per_block objects and recycled through an intrusive free list, so
+ * steady-state alloc/free never reaches malloc. Blocks are only returned
+ * to the heap by slab_destroy(). */
+typedef struct SlabBlock SlabBlock;
+
+typedef struct {
+    size_t obj_size;        /* rounded up to keep objects 16-byte aligned */
+    size_t per_block;
+    SlabBlock* blocks;
+    void* free_list;
+    size_t in_use;
+} Slab;
+
+/* Function declarations */
+void slab_init(Slab* s, size_t obj_size, size_t per_block);
+void* slab_alloc(Slab* s);
+void slab_free(Slab* s, void* obj);
+void slab_destroy(Slab* s);
+
+#endif /* SLAB_H */
@@ -0,0 +1,165 @@
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define STATS_TEXT_MAX 32768        /* one scrape's worth of metrics */
+#define STATS_POLL_MS 200           /* how soon stats_stop() is noticed */
+
+void stat_observe(StatHist* h, uint64_t v) {
+    int k = 0;
+    uint64_t bound = 1;
+    while (k < STAT_BUCKETS && v > bound) {
+        bound <<= 2;
+        k++;
+    }
+    if (k < STAT_BUCKETS) STAT_ADD(h->buckets[k], 1);
+    STAT_ADD(h->count, 1);
+    STAT_ADD(h->sum, v);
+}
+
+/* Folds another thread's histogram into a private total */
+void stat_hist_add(StatHist* total, const StatHist* h) {
+    for (int k = 0; k < STAT_BUCKETS; k++) total->buckets[k] += STAT_LOAD(h->buckets[k]);
+    total->count += STAT_LOAD(h->count);
+    total->sum += STAT_LOAD(h->sum);
+}
+
+void stat_printf(StatText* t, const char* fmt, ...) {
+    if (t->len >= t->cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    t->len += (size_t)n < t->cap - t->len ? (size_t)n : t->cap - t->len;
+}
+
+void stat_counter(StatText* t, const char* name, const char* help, uint64_t v) {
+    stat_printf(t, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name,
+                (unsigned long long)v);
+}
+
+void stat_gauge(StatText* t, const char* name, const char* help, double v) {
+    stat_printf(t, "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n", name, help, name, name, v);
+}
+
+/* Values are reported times scale, e.g. 1e-6 for microseconds as seconds */
+void stat_hist(StatText* t, const char* name, const char* help, const StatHist* h, double scale) {
+    stat_printf(t, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t cum = 0;
+    double bound = 1;
+    for (int k = 0; k < STAT_BUCKETS; k++) {
+        cum += h->buckets[k];
+        stat_printf(t, "%s_bucket{le=\"%.17g\"} %llu\n", name, bound * scale, (unsigned long long)cum);
+        bound *= 4;
+    }
+    stat_printf(t, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)h->count);
+    stat_printf(t, "%s_sum %.17g\n%s_count %llu\n", name, (double)h->sum * scale, name,
+                (unsigned long long)h->count);
+}
+
+/* Answers one scrape: any GET gets the metrics, HTTP/1.0 style */
+static void serve_one(StatServer* s, SOCKET_TYPE c, char* text) {
+    char req[1024];
+    size_t n = 0;
+    while (n < sizeof(req) - 1) {
+        int r = recv(c, req + n, (int)(sizeof(req) - 1 - n), 0);
+        if (r <= 0) break;
+        n += (size_t)r;
+        req[n] = '\0';
+        if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) break;
+    }
+    req[n] = '\0';
+
+    StatText t = { text, STATS_TEXT_MAX, 0 };
+    const char* status = "200 OK";
+    if (strncmp(req, "GET ", 4) == 0) {
+        s->render(&t, s->arg);
+    } else {
+        status = "405 Method Not Allowed";
+    }
+    char head[160];
+    int hn = snprintf(head, sizeof(head),
+                      "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                      "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, t.len);
+    send(c, head, hn, 0);
+    size_t off = 0;
+    while (off < t.len) {
+        int w = send(c, text + off, (int)(t.len - off), 0);
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+}
+
+static void stats_thread(void* arg) {
+    StatServer* s = arg;
+    char* text = malloc(STATS_TEXT_MAX);
+    if (!text) return;
+    while (!s->stop) {
+        fd_set rd;
+        FD_ZERO(&rd);
+        FD_SET(s->sock, &rd);
+        struct timeval tv = { 0, STATS_POLL_MS * 1000 };
+        if (select((int)s->sock + 1, &rd, NULL, NULL, &tv) <= 0) continue;
+        SOCKET_TYPE c = accept(s->sock, NULL, NULL);
+        if (c == INVALID_SOCKET_TYPE) continue;
+        /* A scraper that stalls must not hold up the next one for long */
+#ifdef _WIN32
+        DWORD tmo = 1000;
+#else
+        struct timeval tmo = { 1, 0 };
+#endif
+        setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tmo, sizeof(tmo));
+        setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tmo, sizeof(tmo));
+        serve_one(s, c, text);
+        CLOSE_SOCKET(c);
+    }
+    free(text);
+}
+
+/* Listens for scrapes on "[addr:]port" (address defaults to 127.0.0.1)
+ * and renders the metrics on the endpoint's own thread */
+int stats_serve(StatServer* s, const char* spec, StatRender render, void* arg) {
+    memset(s, 0, sizeof(*s));
+    s->sock = INVALID_SOCKET_TYPE;
+    s->render = render;
+    s->arg = arg;
+
+    char host[64] = "127.0.0.1";
+    const char* colon = strrchr(spec, ':');
+    const char* port = spec;
+    if (colon) {
+        size_t n = (size_t)(colon - spec);
+        if (n >= sizeof(host)) return 0;
+        memcpy(host, spec, n);
+        host[n] = '\0';
+        port = colon + 1;
+    }
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons((uint16_t)atoi(port));
+    if (atoi(port) <= 0 || inet_pton(AF_INET, host, &a.sin_addr) != 1) return 0;
+
+    s->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s->sock == INVALID_SOCKET_TYPE) return 0;
+    int on = 1;
+    setsockopt(s->sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    if (bind(s->sock, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(s->sock, 8) != 0 ||
+        !thread_start(&s->thread, stats_thread, s)) {
+        CLOSE_SOCKET(s->sock);
+        s->sock = INVALID_SOCKET_TYPE;
+        return 0;
+    }
+    return 1;
+}
+
+void stats_stop(StatServer* s) {
+    if (s->sock == INVALID_SOCKET_TYPE) return;
+    s->stop = 1;
+    thread_join(s->thread);
+    CLOSE_SOCKET(s->sock);
+    s->sock = INVALID_SOCKET_TYPE;
+}
@@ -0,0 +1,64 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "platform.h"
+#include "thread.h"
+
+/* Live metrics. Counters are single-writer: each belongs to one thread
+ * (a server worker, say), which bumps it with a plain load and store, and
+ * relaxed atomics only keep a reader on another thread from seeing a torn
+ * value. Totals are the sum of every thread's copy. A small HTTP endpoint
+ * on its own thread serves them in the Prometheus text format. */
+
+#if defined(_MSC_VER)
+/* Aligned 64-bit loads and stores are atomic on the targets MSVC builds for */
+#define STAT_LOAD(c) (*(volatile const uint64_t*)&(c))
+#define STAT_ADD(c, n) (*(volatile uint64_t*)&(c) = (c) + (uint64_t)(n))
+#else
+#define STAT_LOAD(c) __atomic_load_n(&(c), __ATOMIC_RELAXED)
+#define STAT_ADD(c, n) __atomic_store_n(&(c), __atomic_load_n(&(c), __ATOMIC_RELAXED) + (uint64_t)(n), \
+                                        __ATOMIC_RELAXED)
+#endif
+
+/* Histogram with buckets at powers of 4: bucket k counts values up to 4^k,
+ * anything larger than the last bound only shows in count and sum */
+#define STAT_BUCKETS 16
+
+typedef struct {
+    uint64_t buckets[STAT_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+} StatHist;
+
+/* Prometheus text being rendered; output past cap is cut off */
+typedef struct {
+    char* buf;
+    size_t cap;
+    size_t len;
+} StatText;
+
+typedef void (*StatRender)(StatText* t, void* arg);
+
+typedef struct {
+    SOCKET_TYPE sock;
+    ru_thread thread;
+    volatile int stop;
+    StatRender render;
+    void* arg;
+} StatServer;
+
+/* Function declarations */
+void stat_observe(StatHist* h, uint64_t v);
+void stat_hist_add(StatHist* total, const StatHist* h);
+
+void stat_printf(StatText* t, const char* fmt, ...);
+void stat_counter(StatText* t, const char* name, const char* help, uint64_t v);
+void stat_gauge(StatText* t, const char* name, const char* help, double v);
+void stat_hist(StatText* t, const char* name, const char* help, const StatHist* h, double scale);
+
+int stats_serve(StatServer* s, const char* spec, StatRender render, void* arg);
+void stats_stop(StatServer* s);
+
+#endif /* STATS_H */
@@ -0,0 +1,81 @@
+#include "thread.h"
+#include <stdlib.h>
+
+typedef struct {
+    ThreadFn fn;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI trampoline(LPVOID p) {
+#else
+static void* trampoline(void* p) {
+#endif
+    ThreadStart st = *(ThreadStart*)p;
+    free(p);
+    st.fn(st.arg);
+    return 0;
+}
+
+int thread_start(ru_thread* t, ThreadFn fn, void* arg) {
+    ThreadStart* st = malloc(sizeof(*st));
+    if (!st) return 0;
+    st->fn = fn;
+    st->arg = arg;
+#ifdef _WIN32
+    *t = CreateThread(NULL, 0, trampoline, st, 0, NULL);
+    if (*t == NULL) {
+        free(st);
+        return 0;
+    }
+#else
+    if (pthread_create(t, NULL, trampoline, st) != 0) {
+        free(st);
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+void thread_join(ru_thread t) {
+#ifdef _WIN32
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t, NULL);
+#endif
+}
+
+#ifdef _WIN32
+void mutex_init(ru_mutex* m) { InitializeSRWLock(m); }
+void mutex_destroy(ru_mutex* m) { (void)m; }
+void mutex_lock(ru_mutex* m) { AcquireSRWLockExclusive(m); }
+void mutex_unlock(ru_mutex* m) { ReleaseSRWLockExclusive(m); }
+void cond_init(ru_cond* c) { InitializeConditionVariable(c); }
+void cond_destroy(ru_cond* c) { (void)c; }
+void cond_wait(ru_cond* c, ru_mutex* m) { SleepConditionVariableSRW(c, m, INFINITE, 0); }
+void cond_signal(ru_cond* c) { WakeConditionVariable(c); }
+void cond_broadcast(ru_cond* c) { WakeAllConditionVariable(c); }
+#else
+void mutex_init(ru_mutex* m) { pthread_mutex_init(m, NULL); }
+void mutex_destroy(ru_mutex* m) { pthread_mutex_destroy(m); }
+void mutex_lock(ru_mutex* m) { pthread_mutex_lock(m); }
+void mutex_unlock(ru_mutex* m) { pthread_mutex_unlock(m); }
+void cond_init(ru_cond* c) { pthread_cond_init(c, NULL); }
+void cond_destroy(ru_cond* c) { pthread_cond_destroy(c); }
+void cond_wait(ru_cond* c, ru_mutex* m) { pthread_cond_wait(c, m); }
+void cond_signal(ru_cond* c) { pthread_cond_signal(c); }
+void cond_broadcast(ru_cond* c) { pthread_cond_broadcast(c); }
+#endif
+
+/* Online processors, at least 1 */
+int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "platform.h"
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/* Minimal portable threads: pthreads on POSIX, Win32 threads on Windows */
+#ifdef _WIN32
+typedef HANDLE ru_thread;
+typedef SRWLOCK ru_mutex;
+typedef CONDITION_VARIABLE ru_cond;
+#else
+typedef pthread_t ru_thread;
+typedef pthread_mutex_t ru_mutex;
+typedef pthread_cond_t ru_cond;
+#endif
+
+typedef void (*ThreadFn)(void* arg);
+
+/* Function declarations */
+int thread_start(ru_thread* t, ThreadFn fn, void* arg);
+void thread_join(ru_thread t);
+void mutex_init(ru_mutex* m);
+void mutex_destroy(ru_mutex* m);
+void mutex_lock(ru_mutex* m);
+void mutex_unlock(ru_mutex* m);
+void cond_init(ru_cond* c);
+void cond_destroy(ru_cond* c);
+void cond_wait(ru_cond* c, ru_mutex* m);
+void cond_signal(ru_cond* c);
+void cond_broadcast(ru_cond* c);
+int cpu_count(void);
+
+#endif /* THREAD_H */
@@ -0,0 +1,278 @@
+#include "trace.h"
+#include "platform.h"
+#include "protocol.h"
+#include "thread.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#define RING_MASK (TRACE_RING_EVENTS - 1)
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+/* MSVC's volatile accesses are acquire loads and release stores */
+#define LOAD_ACQUIRE(v) (*(volatile const uint64_t*)&(v))
+#define STORE_RELEASE(v, x) (*(volatile uint64_t*)&(v) = (x))
+#define WRITE_FENCE() _WriteBarrier()
+#define READ_FENCE() _ReadBarrier()
+#else
+#define THREAD_LOCAL __thread
+#define LOAD_ACQUIRE(v) __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define WRITE_FENCE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define READ_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+/* One thread's events. Only the owner writes, bumping head after each
+ * event; a dump copies the ring and then rereads head to throw away what
+ * the owner overwrote meanwhile, as a seqlock reader would. */
+typedef struct TraceRing {
+    struct TraceRing* next;
+    int thread;
+    uint64_t head;              /* events ever recorded */
+    TraceEvent ev[TRACE_RING_EVENTS];
+} TraceRing;
+
+int trace_on;
+
+static struct {
+    char path[1024];
+    const char* vantage;
+    ru_mutex lock;              /* guards the ring list and the file */
+    TraceRing* rings;
+    int nrings;
+    uint64_t t0;                /* ns_now() at trace_open, time 0 of the dump */
+    uint64_t wall_ms;           /* and the wall clock then */
+#ifndef _WIN32
+    sigset_t sigs;
+    ru_thread waiter;
+#endif
+} tr;
+
+static THREAD_LOCAL TraceRing* my_ring;
+
+static TraceRing* ring_attach(void) {
+    TraceRing* r = calloc(1, sizeof(TraceRing));
+    if (!r) {
+        return NULL;
+    }
+    mutex_lock(&tr.lock);
+    r->thread = tr.nrings++;
+    r->next = tr.rings;
+    tr.rings = r;
+    mutex_unlock(&tr.lock);
+    return r;
+}
+
+void trace_emit(uint8_t type, uint8_t detail, uint16_t flow, uint16_t stream,
+                uint32_t seq, uint32_t count, uint16_t window, uint64_t value) {
+    TraceRing* r = my_ring;
+    if (!r && !(r = my_ring = ring_attach())) return;
+    uint64_t h = r->head;
+    /* The last head goes out before the slot it lets us overwrite */
+    WRITE_FENCE();
+    TraceEvent* e = &r->ev[h & RING_MASK];
+    e->ns = ns_now();
+    e->value = value;
+    e->seq = seq;
+    e->count = count;
+    e->flow = flow;
+    e->stream = stream;
+    e->type = type;
+    e->detail = detail;
+    e->window = window;
+    STORE_RELEASE(r->head, h + 1);
+}
+
+/* Copies what the ring still holds intact; returns the count */
+static size_t ring_copy(const TraceRing* r, TraceEvent* out) {
+    uint64_t end = LOAD_ACQUIRE(r->head);
+    uint64_t start = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+    for (uint64_t i = start; i < end; i++) out[i - start] = r->ev[i & RING_MASK];
+    READ_FENCE();
+    /* The owner may be writing event "now" over event now - RING size */
+    uint64_t now = LOAD_ACQUIRE(r->head);
+    uint64_t valid = now + 1 > TRACE_RING_EVENTS ? now + 1 - TRACE_RING_EVENTS : 0;
+    if (valid <= start) return (size_t)(end - start);
+    if (valid >= end) return 0;
+    memmove(out, out + (valid - start), (size_t)(end - valid) * sizeof(TraceEvent));
+    return (size_t)(end - valid);
+}
+
+static const char* packet_name(uint8_t ptype) {
+    static const char* names[] = {
+        "handshake", "handshake_ack", "data", "ack", "fin", "fin_ack",
+        "error", "sack", "probe", "probe_ack", "parity"
+    };
+    return ptype < sizeof(names) / sizeof(names[0]) ? names[ptype] : "unknown";
+}
+
+static const char* drop_name(uint8_t reason) {
+    static const char* names[] = {
+        "duplicate", "beyond_window", "bad_checksum", "write_stall", "invalid", "no_session"
+    };
+    return reason < sizeof(names) / sizeof(names[0]) ? names[reason] : "unknown";
+}
+
+/* One event as a qlog line; times are milliseconds */
+static void write_event(FILE* f, const TraceEvent* e, int thread, int first) {
+    double t = (double)(int64_t)(e->ns - tr.t0) / 1e6;
+    fprintf(f, "%s\n{\"time\":%.6f,", first ? "" : ",", t);
+    switch (e->type) {
+    case TR_PACKET_SENT:
+    case TR_PACKET_RECEIVED:
+    case TR_PACKET_DROPPED:
+        fprintf(f, "\"name\":\"transport:%s\",\"data\":{\"thread\":%d,\"flow\":%u,\"stream\":%u,"
+                "\"header\":{\"packet_type\":\"%s\",\"packet_number\":%u},"
+                "\"raw\":{\"payload_length\":%u}",
+                e->type == TR_PACKET_SENT ? "packet_sent" :
+                e->type == TR_PACKET_RECEIVED ? "packet_received" : "packet_dropped",
+                thread, e->flow, e->stream,
+                packet_name(e->type == TR_PACKET_DROPPED ? PT_DATA : (uint8_t)(e->detail & ~TRACE_RETX)),
+                e->seq, e->count);
+        if (e->type == TR_PACKET_DROPPED) {
+            fprintf(f, ",\"trigger\":\"%s\"}}", drop_name(e->detail));
+        } else {
+            fprintf(f, ",\"window\":%u%s}}", e->window,
+                    e->type == TR_PACKET_SENT && (e->detail & TRACE_RETX) ? ",\"retransmit\":true" : "");
+        }
+        break;
+    case TR_PACKET_LOST:
+        fprintf(f, "\"name\":\"recovery:packet_lost\",\"data\":{\"thread\":%d,\"flow\":%u,\"stream\":%u,"
+                "\"header\":{\"packet_type\":\"data\",\"packet_number\":%u},\"trigger\":\"%s\"}}",
+                thread, e->flow, e->stream, e->seq,
+                e->detail == TL_TIMEOUT ? "pto_expired" : "reordering_threshold");
+        break;
+    case TR_PACKETS_ACKED:
+        fprintf(f, "\"name\":\"recovery:packets_acked\",\"data\":{\"thread\":%d,\"flow\":%u,\"stream\":%u,"
+                "\"cumulative_ack\":%u,\"packets\":%u",
+                thread, e->flow, e->stream, e->seq, e->count);
+        if (e->value) fprintf(f, ",\"latest_rtt\":%.3f", (double)e->value / 1000.0);
+        fprintf(f, "}}");
+        break;
+    case TR_METRICS:
+        fprintf(f, "\"name\":\"recovery:metrics_updated\",\"data\":{\"thread\":%d,\"flow\":%u,"
+                "\"congestion_window\":%u,\"packets_in_flight\":%u,\"smoothed_rtt\":%.3f}}",
+                thread, e->flow, e->count, e->seq, (double)e->value / 1000.0);
+        break;
+    case TR_TIMER_EXPIRED:
+        fprintf(f, "\"name\":\"recovery:loss_timer_updated\",\"data\":{\"thread\":%d,\"flow\":%u,"
+                "\"stream\":%u,\"event_type\":\"expired\",\"timer_type\":\"pto\","
+                "\"oldest_unacked\":%u,\"packets\":%u,\"rto\":%.3f}}",
+                thread, e->flow, e->stream, e->seq, e->count, (double)e->value / 1000.0);
+        break;
+    default:
+        fprintf(f, "\"name\":\"ruft:unknown\",\"data\":{\"thread\":%d,\"type\":%u}}", thread, e->type);
+        break;
+    }
+}
+
+/* Writes every ring, merged in time order, over the trace file */
+int trace_dump(void) {
+    if (!trace_on) return 0;
+    mutex_lock(&tr.lock);
+    int n = tr.nrings;
+    TraceEvent** evs = calloc((size_t)(n ? n : 1), sizeof(TraceEvent*));
+    size_t* len = calloc((size_t)(n ? n : 1), sizeof(size_t));
+    size_t* pos = calloc((size_t)(n ? n : 1), sizeof(size_t));
+    int* thread = calloc((size_t)(n ? n : 1), sizeof(int));
+    FILE* f = fopen(tr.path, "w");
+    int ok = evs && len && pos && thread && f;
+    int k = 0;
+    for (TraceRing* r = tr.rings; ok && r; r = r->next, k++) {
+        evs[k] = malloc(sizeof(r->ev));
+        if (!evs[k]) {
+            ok = 0;
+            break;
+        }
+        len[k] = ring_copy(r, evs[k]);
+        thread[k] = r->thread;
+    }
+    if (ok) {
+        fprintf(f, "{\"qlog_version\":\"0.3\",\"qlog_format\":\"JSON\",\"title\":\"ruft %s trace\","
+                "\"traces\":[{\"vantage_point\":{\"type\":\"%s\"},\"common_fields\":"
+                "{\"time_format\":\"relative\",\"reference_time\":%llu},\"events\":[",
+                tr.vantage, tr.vantage, (unsigned long long)tr.wall_ms);
+        /* Each ring is in time order already; a handful of threads makes
+         * a linear pick of the earliest head cheap enough */
+        for (int first = 1;; first = 0) {
+            int best = -1;
+            for (int i = 0; i < n; i++) {
+                if (pos[i] < len[i] && (best < 0 || evs[i][pos[i]].ns < evs[best][pos[best]].ns)) best = i;
+            }
+            if (best < 0) break;
+            write_event(f, &evs[best][pos[best]++], thread[best], first);
+        }
+        fprintf(f, "\n]}]}\n");
+    }
+    if (f && fclose(f) != 0) ok = 0;
+    for (int i = 0; evs && i < n; i++) free(evs[i]);
+    free(evs);
+    free(len);
+    free(pos);
+    free(thread);
+    mutex_unlock(&tr.lock);
+    if (!ok) fprintf(stderr, "Failed to write trace %s\n", tr.path);
+    return ok;
+}
+
+static void trace_at_exit(void) {
+    trace_dump();
+}
+
+#ifdef _WIN32
+static BOOL WINAPI trace_console(DWORD ev) {
+    trace_dump();
+    /* Ctrl+Break only dumps; anything else goes on to end the process */
+    return ev == CTRL_BREAK_EVENT;
+}
+#else
+/* Every other thread has the signals blocked, so they all land here */
+static void trace_signals(void* arg) {
+    (void)arg;
+    for (;;) {
+        int sig;
+        if (sigwait(&tr.sigs, &sig) != 0) continue;
+        trace_dump();
+        if (sig == SIGUSR1) continue;
+        /* End the way the signal would have without tracing */
+        signal(sig, SIG_DFL);
+        pthread_sigmask(SIG_UNBLOCK, &tr.sigs, NULL);
+        raise(sig);
+    }
+}
+#endif
+
+/* Starts recording; vantage is "client" or "server". Call before starting
+ * any thread, since the signals are blocked for the threads made later. */
+int trace_open(const char* path, const char* vantage) {
+    if (strlen(path) >= sizeof(tr.path)) return 0;
+    FILE* f = fopen(path, "w");
+    if (!f) return 0;
+    fclose(f);
+    strcpy(tr.path, path);
+    tr.vantage = vantage;
+    mutex_init(&tr.lock);
+    tr.t0 = ns_now();
+    tr.wall_ms = ms_since(0);
+#ifdef _WIN32
+    SetConsoleCtrlHandler(trace_console, TRUE);
+#else
+    sigemptyset(&tr.sigs);
+    sigaddset(&tr.sigs, SIGUSR1);
+    sigaddset(&tr.sigs, SIGINT);
+    sigaddset(&tr.sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &tr.sigs, NULL);
+    if (!thread_start(&tr.waiter, trace_signals, NULL)) {
+        pthread_sigmask(SIG_UNBLOCK, &tr.sigs, NULL);
+        return 0;
+    }
+#endif
+    atexit(trace_at_exit);
+    trace_on = 1;
+    return 1;
+}
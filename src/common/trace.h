@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Event tracing for diagnosing slow transfers: packets sent, received,
+ * dropped, declared lost and acknowledged, congestion metrics and timer
+ * expiries, stamped in nanoseconds. Each thread records into its own ring
+ * of the last TRACE_RING_EVENTS events, written without locks; a dump
+ * merges every ring in time order into a qlog-style JSON file, which
+ * replaces the previous one. Dumps happen at exit, on SIGINT/SIGTERM, and
+ * on demand with SIGUSR1 (Ctrl+Break on Windows). Until trace_open() the
+ * TRACE() hooks cost one test of a global flag. */
+
+#define TRACE_RING_EVENTS 65536     /* per thread, 32 bytes each */
+
+typedef enum {
+    TR_PACKET_SENT = 0,         /* detail: packet type | TRACE_RETX */
+    TR_PACKET_RECEIVED = 1,     /* detail: packet type */
+    TR_PACKET_DROPPED = 2,      /* detail: TraceDrop */
+    TR_PACKET_LOST = 3,         /* detail: TraceLoss */
+    TR_PACKETS_ACKED = 4,       /* seq: cumulative ACK, count: newly acknowledged, value: RTT sample us */
+    TR_METRICS = 5,             /* seq: packets in flight, count: congestion window, value: smoothed RTT us */
+    TR_TIMER_EXPIRED = 6        /* seq: oldest unacknowledged, count: packets outstanding, value: RTO us */
+} TraceType;
+
+#define TRACE_RETX 0x80         /* TR_PACKET_SENT: a retransmission */
+
+typedef enum {
+    TD_DUPLICATE = 0,
+    TD_BEYOND_WINDOW = 1,
+    TD_BAD_CHECKSUM = 2,
+    TD_WRITE_STALL = 3,         /* writer pool out of buffers */
+    TD_INVALID = 4,
+    TD_NO_SESSION = 5
+} TraceDrop;
+
+typedef enum {
+    TL_REORDER = 0,             /* DUP_THRESH later packets were SACKed */
+    TL_TIMEOUT = 1
+} TraceLoss;
+
+typedef struct {
+    uint64_t ns;
+    uint64_t value;
+    uint32_t seq;
+    uint32_t count;             /* payload bytes for packet events */
+    uint16_t flow;              /* client's UDP port, the same at both ends */
+    uint16_t stream;
+    uint8_t type;               /* TraceType */
+    uint8_t detail;
+    uint16_t window;            /* header window for packet events */
+} TraceEvent;
+
+extern int trace_on;
+
+#define TRACE(...) do { if (trace_on) trace_emit(__VA_ARGS__); } while (0)
+
+/* Function declarations */
+int trace_open(const char* path, const char* vantage);
+void trace_emit(uint8_t type, uint8_t detail, uint16_t flow, uint16_t stream,
+                uint32_t seq, uint32_t count, uint16_t window, uint64_t value);
+int trace_dump(void);
+
+#endif /* TRACE_H */
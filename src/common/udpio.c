@@ -0,0 +1,327 @@
+#ifndef _WIN32
+#define _GNU_SOURCE /* sendmmsg / recvmmsg */
+#endif
+#include "udpio.h"
+#include "netem.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef RU_HAVE_MMSG
+#include <sys/uio.h>
+#include <netinet/udp.h>
+#endif
+
+#ifdef RU_HAVE_UDP_GSO
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+/* Kernel limits for one GSO send */
+#define GSO_MAX_SEGMENTS 64
+#define GSO_MAX_BYTES 65000
+#endif
+
+void udp_tune_buffers(SOCKET_TYPE sock, int bytes) {
+    /* Best effort: the kernel caps these at its own limits */
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&bytes, sizeof(bytes));
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&bytes, sizeof(bytes));
+}
+
+/* Sets or clears the don't-fragment bit on outgoing IPv4 datagrams, so a
+ * path MTU probe that is too big is dropped instead of fragmented. On Linux
+ * "probe" mode also ignores the cached path MTU, letting the probe find out
+ * for itself. Returns 0 where the platform offers no such control. */
+int udp_set_dontfrag(SOCKET_TYPE sock, int on) {
+#if defined(IP_MTU_DISCOVER) && defined(IP_PMTUDISC_PROBE)
+    int v = on ? IP_PMTUDISC_PROBE : IP_PMTUDISC_WANT;
+    return setsockopt(sock, IPPROTO_IP, IP_MTU_DISCOVER, &v, sizeof(v)) == 0;
+#elif defined(_WIN32) && defined(IP_DONTFRAGMENT)
+    DWORD v = on ? 1 : 0;
+    return setsockopt(sock, IPPROTO_IP, IP_DONTFRAGMENT, (const char*)&v, sizeof(v)) == 0;
+#elif defined(IP_DONTFRAG)
+    int v = on ? 1 : 0;
+    return setsockopt(sock, IPPROTO_IP, IP_DONTFRAG, &v, sizeof(v)) == 0;
+#else
+    (void)sock;
+    (void)on;
+    return 0;
+#endif
+}
+
+/* Caps the kernel's send rate for the socket (Linux, honoured by the fq
+ * qdisc) as a backstop under our own pacing. Returns 0 where unsupported. */
+int udp_set_pacing_rate(SOCKET_TYPE sock, uint64_t bytes_per_sec) {
+#ifdef SO_MAX_PACING_RATE
+    uint64_t v = bytes_per_sec;
+    return setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, &v, sizeof(v)) == 0;
+#else
+    (void)sock;
+    (void)bytes_per_sec;
+    return 0;
+#endif
+}
+
+int udp_tx_init(UdpTx* tx, SOCKET_TYPE sock, size_t cap) {
+    memset(tx, 0, sizeof(*tx));
+    tx->sock = sock;
+    tx->cap = cap;
+    tx->data = malloc(cap);
+    tx->netem = netem_enabled();
+#ifdef RU_HAVE_UDP_GSO
+    tx->gso = 1;
+#endif
+    return tx->data != NULL;
+}
+
+uint8_t* udp_tx_reserve(UdpTx* tx, size_t maxlen) {
+    if (maxlen > tx->cap) return NULL;
+    if (tx->count == UDP_BATCH_MAX || tx->used + maxlen > tx->cap) {
+        udp_tx_flush(tx);
+    }
+    return tx->data + tx->used;
+}
+
+void udp_tx_commit(UdpTx* tx, size_t len, const void* addr, SOCKLEN_TYPE addrlen) {
+    size_t i = tx->count++;
+    tx->off[i] = tx->used;
+    tx->len[i] = len;
+    memcpy(&tx->addr[i], addr, (size_t)addrlen);
+    tx->addrlen[i] = addrlen;
+    tx->used += len;
+}
+
+#ifdef RU_HAVE_MMSG
+/* Send datagrams [from, to) with as few sendmmsg() calls as the kernel allows;
+ * anything left when the socket buffer fills is dropped like network loss. */
+static int send_mmsg(UdpTx* tx, size_t from, size_t to) {
+    struct mmsghdr msgs[UDP_BATCH_MAX];
+    struct iovec iov[UDP_BATCH_MAX];
+    size_t n = to - from;
+    memset(msgs, 0, n * sizeof(msgs[0]));
+    for (size_t k = 0; k < n; k++) {
+        iov[k].iov_base = tx->data + tx->off[from + k];
+        iov[k].iov_len = tx->len[from + k];
+        msgs[k].msg_hdr.msg_name = &tx->addr[from + k];
+        msgs[k].msg_hdr.msg_namelen = tx->addrlen[from + k];
+        msgs[k].msg_hdr.msg_iov = &iov[k];
+        msgs[k].msg_hdr.msg_iovlen = 1;
+    }
+    size_t done = 0;
+    while (done < n) {
+        int r = sendmmsg(tx->sock, msgs + done, (unsigned int)(n - done), 0);
+        if (r < 0) {
+            if (SOCKET_WOULDBLOCK()) break;
+            done++; /* skip the datagram the kernel rejected */
+            continue;
+        }
+        done += (size_t)r;
+    }
+    return (int)done;
+}
+#endif
+
+#ifdef RU_HAVE_UDP_GSO
+/* Length of the GSO-able run starting at i: same peer, contiguous, equal sizes
+ * with only the final datagram allowed to be shorter */
+static size_t gso_run(const UdpTx* tx, size_t i) {
+    size_t seg = tx->len[i];
+    size_t bytes = seg;
+    size_t j = i + 1;
+    while (j < tx->count && j - i < GSO_MAX_SEGMENTS && tx->len[j] <= seg &&
+           bytes + tx->len[j] <= GSO_MAX_BYTES && tx->off[j] == tx->off[j - 1] + tx->len[j - 1] &&
+           tx->addrlen[j] == tx->addrlen[i] &&
+           memcmp(&tx->addr[j], &tx->addr[i], (size_t)tx->addrlen[i]) == 0) {
+        bytes += tx->len[j];
+        j++;
+        if (tx->len[j - 1] < seg) break;
+    }
+    return j - i;
+}
+
+static int send_gso(UdpTx* tx, size_t i, size_t run) {
+    size_t bytes = tx->off[i + run - 1] + tx->len[i + run - 1] - tx->off[i];
+    struct iovec iov = { tx->data + tx->off[i], bytes };
+    char ctrl[CMSG_SPACE(sizeof(uint16_t))];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    memset(ctrl, 0, sizeof(ctrl));
+    mh.msg_name = &tx->addr[i];
+    mh.msg_namelen = tx->addrlen[i];
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctrl;
+    mh.msg_controllen = sizeof(ctrl);
+    struct cmsghdr* cm = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t seg = (uint16_t)tx->len[i];
+    memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+    return sendmsg(tx->sock, &mh, 0) == (ssize_t)bytes ? 0 : -1;
+}
+#endif
+
+int udp_tx_flush(UdpTx* tx) {
+    int sent = 0;
+    if (tx->netem && tx->count) netem_shape(tx);
+#if defined(RU_HAVE_UDP_GSO)
+    size_t pending = 0; /* first datagram not yet handed to the kernel */
+    size_t i = 0;
+    while (i < tx->count) {
+        size_t run = tx->gso ? gso_run(tx, i) : 1;
+        if (run < 2) {
+            i++;
+            continue;
+        }
+        if (pending < i) sent += send_mmsg(tx, pending, i);
+        if (send_gso(tx, i, run) == 0) {
+            sent += (int)run;
+        } else if (SOCKET_WOULDBLOCK()) {
+            /* buffer full: the run is lost, loss recovery resends it */
+        } else {
+            /* No GSO on this path (old kernel, no checksum offload) */
+            tx->gso = 0;
+            sent += send_mmsg(tx, i, i + run);
+        }
+        i += run;
+        pending = i;
+    }
+    if (pending < tx->count) sent += send_mmsg(tx, pending, tx->count);
+#elif defined(RU_HAVE_MMSG)
+    if (tx->count) sent = send_mmsg(tx, 0, tx->count);
+#else
+    for (size_t i = 0; i < tx->count; i++) {
+        int r = sendto(tx->sock, (const char*)tx->data + tx->off[i], (int)tx->len[i], 0,
+                       (const struct sockaddr*)&tx->addr[i], tx->addrlen[i]);
+        if (r >= 0) sent++;
+    }
+#endif
+    tx->count = 0;
+    tx->used = 0;
+    return sent;
+}
+
+void udp_tx_free(UdpTx* tx) {
+    free(tx->data);
+    tx->data = NULL;
+}
+
+/* A single datagram outside any batch, e.g. a writer thread's FIN_ACK;
+ * shaped by RUFT_NETEM like everything else */
+int udp_send(SOCKET_TYPE sock, const void* data, size_t len, const void* addr, SOCKLEN_TYPE addrlen) {
+    if (netem_enabled()) {
+        UdpTx one;
+        memset(&one, 0, sizeof(one));
+        one.sock = sock;
+        one.data = (uint8_t*)data;
+        udp_tx_commit(&one, len, addr, addrlen);
+        netem_shape(&one);
+        if (!one.count) return 0;
+    }
+    return sendto(sock, (const char*)data, (int)len, 0, (const struct sockaddr*)addr, addrlen) >= 0;
+}
+
+int udp_rx_init(UdpRx* rx, SOCKET_TYPE sock, size_t slot_size, size_t nslots) {
+    memset(rx, 0, sizeof(*rx));
+    rx->sock = sock;
+    rx->slot_size = slot_size;
+    rx->nslots = nslots > UDP_BATCH_MAX ? UDP_BATCH_MAX : nslots;
+    rx->data = malloc(rx->slot_size * rx->nslots);
+    if (!rx->data) return 0;
+#ifdef RU_HAVE_UDP_GSO
+    /* GRO can hand back up to 64 KiB per slot; only ask for it if that fits */
+    if (slot_size >= 65536) {
+        int on = 1;
+        rx->gro = setsockopt(sock, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+    }
+#endif
+    return 1;
+}
+
+/* Pull every datagram that is already queued, up to nslots. Returns the number
+ * of slots filled, 0 when nothing was waiting, -1 on a socket error. */
+int udp_rx_recv(UdpRx* rx) {
+    rx->count = 0;
+    rx->cur_slot = 0;
+    rx->cur_off = 0;
+#ifdef RU_HAVE_MMSG
+    struct mmsghdr msgs[UDP_BATCH_MAX];
+    struct iovec iov[UDP_BATCH_MAX];
+    char ctrl[UDP_BATCH_MAX][CMSG_SPACE(sizeof(int))];
+    memset(msgs, 0, rx->nslots * sizeof(msgs[0]));
+    for (size_t k = 0; k < rx->nslots; k++) {
+        iov[k].iov_base = rx->data + k * rx->slot_size;
+        iov[k].iov_len = rx->slot_size;
+        msgs[k].msg_hdr.msg_name = &rx->addr[k];
+        msgs[k].msg_hdr.msg_namelen = sizeof(rx->addr[k]);
+        msgs[k].msg_hdr.msg_iov = &iov[k];
+        msgs[k].msg_hdr.msg_iovlen = 1;
+        if (rx->gro) {
+            msgs[k].msg_hdr.msg_control = ctrl[k];
+            msgs[k].msg_hdr.msg_controllen = sizeof(ctrl[k]);
+        }
+    }
+    int n = recvmmsg(rx->sock, msgs, (unsigned int)rx->nslots, MSG_DONTWAIT, NULL);
+    if (n < 0) return SOCKET_WOULDBLOCK() ? 0 : -1;
+    for (int k = 0; k < n; k++) {
+        rx->len[k] = msgs[k].msg_len;
+        rx->seg[k] = msgs[k].msg_len;
+        rx->addrlen[k] = msgs[k].msg_hdr.msg_namelen;
+        if (rx->gro) {
+            struct cmsghdr* cm;
+            for (cm = CMSG_FIRSTHDR(&msgs[k].msg_hdr); cm; cm = CMSG_NXTHDR(&msgs[k].msg_hdr, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    int seg;
+                    memcpy(&seg, CMSG_DATA(cm), sizeof(seg));
+                    if (seg > 0) rx->seg[k] = (size_t)seg;
+                }
+            }
+        }
+    }
+    rx->count = (size_t)n;
+#else
+    while (rx->count < rx->nslots) {
+        size_t k = rx->count;
+        rx->addrlen[k] = sizeof(rx->addr[k]);
+        int r = recvfrom(rx->sock, (char*)rx->data + k * rx->slot_size, (int)rx->slot_size, 0,
+                         (struct sockaddr*)&rx->addr[k], &rx->addrlen[k]);
+        if (r < 0) {
+            if (SOCKET_WOULDBLOCK()) break;
+            if (rx->count == 0) return -1;
+            break;
+        }
+        rx->len[k] = (size_t)r;
+        rx->seg[k] = (size_t)r;
+        rx->count++;
+    }
+#endif
+    return (int)rx->count;
+}
+
+/* Iterate the datagrams of the last udp_rx_recv(), splitting GRO slots */
+int udp_rx_next(UdpRx* rx, UdpMsg* msg) {
+    while (rx->cur_slot < rx->count) {
+        size_t k = rx->cur_slot;
+        if (rx->cur_off < rx->len[k]) {
+            size_t left = rx->len[k] - rx->cur_off;
+            msg->data = rx->data + k * rx->slot_size + rx->cur_off;
+            msg->len = left < rx->seg[k] ? left : rx->seg[k];
+            msg->addr = &rx->addr[k];
+            msg->addrlen = rx->addrlen[k];
+            rx->cur_off += msg->len;
+            return 1;
+        }
+        rx->cur_slot++;
+        rx->cur_off = 0;
+    }
+    return 0;
+}
+
+void udp_rx_free(UdpRx* rx) {
+    free(rx->data);
+    rx->data = NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef UDPIO_H
+#define UDPIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "platform.h"
+
+/* Batched UDP I/O. On Linux a whole batch goes out with one sendmmsg(), runs
+ * of equal-sized datagrams to one peer are handed to UDP GSO (UDP_SEGMENT),
+ * and receives use recvmmsg() with UDP GRO; other platforms fall back to one
+ * sendto()/recvfrom() per datagram behind the same interface. */
+
+#define UDP_BATCH_MAX 64
+
+/* Requested SO_SNDBUF/SO_RCVBUF so a full window plus a batch fits */
+#define UDP_SOCKET_BUFFER (4 * 1024 * 1024)
+
+/* Outgoing datagrams are packed back to back into one arena so that runs of
+ * them can be sent as a single GSO super-packet. */
+typedef struct {
+    SOCKET_TYPE sock;
+    int gso;                        /* UDP_SEGMENT still usable */
+    int netem;                      /* RUFT_NETEM impairs what is flushed */
+    uint8_t* data;
+    size_t cap;
+    size_t used;
+    size_t count;
+    size_t off[UDP_BATCH_MAX];
+    size_t len[UDP_BATCH_MAX];
+    struct sockaddr_storage addr[UDP_BATCH_MAX];
+    SOCKLEN_TYPE addrlen[UDP_BATCH_MAX];
+} UdpTx;
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    const struct sockaddr_storage* addr;
+    SOCKLEN_TYPE addrlen;
+} UdpMsg;
+
+/* Incoming datagrams land in fixed slots; with GRO one slot may hold several
+ * coalesced datagrams of seg bytes each, which udp_rx_next() splits apart. */
+typedef struct {
+    SOCKET_TYPE sock;
+    int gro;
+    uint8_t* data;
+    size_t slot_size;
+    size_t nslots;
+    size_t count;                   /* slots filled by the last udp_rx_recv() */
+    size_t len[UDP_BATCH_MAX];
+    size_t seg[UDP_BATCH_MAX];
+    struct sockaddr_storage addr[UDP_BATCH_MAX];
+    SOCKLEN_TYPE addrlen[UDP_BATCH_MAX];
+    size_t cur_slot;                /* iteration state for udp_rx_next() */
+    size_t cur_off;
+} UdpRx;
+
+/* Function declarations */
+void udp_tune_buffers(SOCKET_TYPE sock, int bytes);
+int udp_set_dontfrag(SOCKET_TYPE sock, int on);
+int udp_set_pacing_rate(SOCKET_TYPE sock, uint64_t bytes_per_sec);
+
+int udp_tx_init(UdpTx* tx, SOCKET_TYPE sock, size_t cap);
+uint8_t* udp_tx_reserve(UdpTx* tx, size_t maxlen);
+void udp_tx_commit(UdpTx* tx, size_t len, const void* addr, SOCKLEN_TYPE addrlen);
+int udp_tx_flush(UdpTx* tx);
+void udp_tx_free(UdpTx* tx);
+int udp_send(SOCKET_TYPE sock, const void* data, size_t len, const void* addr, SOCKLEN_TYPE addrlen);
+
+int udp_rx_init(UdpRx* rx, SOCKET_TYPE sock, size_t slot_size, size_t nslots);
+int udp_rx_recv(UdpRx* rx);
+int udp_rx_next(UdpRx* rx, UdpMsg* msg);
+void udp_rx_free(UdpRx* rx);
+
+#endif /* UDPIO_H */
@@ -4,10 +4,12 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#define TIME_STR_SIZE 20    /* "YYYY-MM-DD HH:MM:SS" + NUL */
+
 /* Function declarations */
-char** split(const char* s, char delim, int* count);
-void free_split_result(char** result, int count);
-char* now_time(void);
+char* now_time(char* buf, size_t cap);
 uint64_t ms_since(uint64_t t0);
+uint64_t us_now(void);
+uint64_t ns_now(void);
 
 #endif /* UTIL_H */
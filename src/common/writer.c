@@ -0,0 +1,647 @@
+#ifndef _WIN32
+#define _GNU_SOURCE /* fallocate */
+#endif
+#define _FILE_OFFSET_BITS 64
+#include "writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include "util.h"
+#include "udpio.h"
+#include "protocol.h"
+#include "trace.h"
+#include "digest.h"
+#ifdef _WIN32
+#include <io.h>
+#include <share.h>
+#else
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+#define WR_MIN_CLASS_SHIFT 8
+#define WR_JOB_CLOSE -1
+#define WR_JOB_NOTIFY -2
+
+/* A queued write is its own buffer: the payload follows the header */
+struct WrJob {
+    WrJob* next;
+    WrFile* file;
+    WriterPool* pool;           /* buffers return to the pool they came from */
+    uint64_t off;
+    size_t len;
+    int cls;                    /* size class, or WR_JOB_CLOSE / WR_JOB_NOTIFY */
+    const Codec* codec;         /* payload is compressed, expands to raw_len */
+    size_t raw_len;
+    /* close and notify only */
+    int finalize;
+    struct sockaddr_storage to;
+    SOCKLEN_TYPE tolen;
+    size_t reply_len;           /* reply datagram follows the header */
+};
+
+struct WrFile {
+    WriterPool* pool;           /* owns the queue and the status */
+    int fd;
+    WrJob* close_job;           /* allocated up front so closing cannot fail */
+    int queue;
+    int refs;                   /* owner + the pending close */
+    int failed;
+    WrStatus status;
+    /* touched by the writer thread alone after open */
+    uint64_t digest;            /* of every chunk written, if chunk is set */
+    int check;                  /* finalize only if digest == expect */
+    uint64_t expect;
+    /* resumable files only */
+    int tracked;
+    char path[1024];
+    char final_path[1024];
+    char map_path[1024];
+    char* map_header;
+    size_t chunk;
+    Bitmap written;
+    int dirty;
+    uint64_t last_checkpoint;
+};
+
+static int size_class(size_t len) {
+    int cls = 0;
+    while (cls < WR_SIZE_CLASSES && ((size_t)1 << (WR_MIN_CLASS_SHIFT + cls)) < len) cls++;
+    return cls < WR_SIZE_CLASSES ? cls : -1;
+}
+
+static int write_at(int fd, const uint8_t* buf, size_t len, uint64_t off) {
+#ifdef _WIN32
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)off;
+    ov.OffsetHigh = (DWORD)(off >> 32);
+    DWORD n = 0;
+    return WriteFile(h, buf, (DWORD)len, &n, &ov) && n == len;
+#else
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, (off_t)off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        buf += n;
+        len -= (size_t)n;
+        off += (uint64_t)n;
+    }
+    return 1;
+#endif
+}
+
+/* Reserve the file's blocks up front so a multi-GB upload is laid out in
+ * as few extents as possible instead of growing in arrival order, then fix
+ * its final size */
+static void preallocate(int fd, uint64_t size) {
+    if (size == 0) return;
+#if defined(__linux__)
+    /* Unlike posix_fallocate() this fails fast where it is unsupported
+     * instead of writing zeros over the whole range */
+    if (fallocate(fd, 0, 0, (off_t)size) == 0) return;
+#elif defined(__APPLE__)
+    fstore_t fs;
+    memset(&fs, 0, sizeof(fs));
+    fs.fst_flags = F_ALLOCATECONTIG;
+    fs.fst_posmode = F_PEOFPOSMODE;
+    fs.fst_length = (off_t)size;
+    if (fcntl(fd, F_PREALLOCATE, &fs) == -1) {
+        fs.fst_flags = F_ALLOCATEALL;
+        fcntl(fd, F_PREALLOCATE, &fs);
+    }
+#elif !defined(_WIN32)
+    if (posix_fallocate(fd, 0, (off_t)size) == 0) return;
+#endif
+#ifdef _WIN32
+    _chsize_s(fd, (__int64)size);
+#else
+    if (ftruncate(fd, (off_t)size) != 0) {
+        /* Not fatal: positional writes still grow the file */
+    }
+#endif
+}
+
+static int sync_data(int fd) {
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__linux__)
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+/* Save the map atomically. The data is synced first so the map never
+ * claims a chunk that a crash could still lose. */
+static void checkpoint(WrFile* f) {
+    if (!f->tracked || !f->dirty) return;
+    if (!sync_data(f->fd)) return;
+    char tmp[1040];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", f->map_path);
+    FILE* fp = fopen(tmp, "wb");
+    if (!fp) return;
+    uint8_t be[8];
+    put_be64(be, f->digest);
+    int ok = fputs(f->map_header, fp) >= 0 && fwrite(be, 1, sizeof(be), fp) == sizeof(be) &&
+             bm_write(&f->written, fp);
+    ok = fclose(fp) == 0 && ok;
+    if (ok && replace_file(tmp, f->map_path)) {
+        f->dirty = 0;
+    } else {
+        remove(tmp);
+    }
+}
+
+static void file_free(WrFile* f) {
+    bm_free(&f->written);
+    free(f->map_header);
+    free(f->close_job);
+    free(f);
+}
+
+static void file_unref(WrFile* f) {
+    WriterPool* wp = f->pool;
+    mutex_lock(&wp->lock);
+    int last = --f->refs == 0;
+    mutex_unlock(&wp->lock);
+    if (last) file_free(f);
+}
+
+/* The FIN_ACK (or other reply) a close or notify job was given */
+static void send_reply(WriterPool* wp, WrJob* j) {
+    udp_send(wp->sock, j + 1, j->reply_len, &j->to, j->tolen);
+    Packet p;
+    if (trace_on && j->to.ss_family == AF_INET && unpack_view((const uint8_t*)(j + 1), j->reply_len, &p) == 0) {
+        trace_emit(TR_PACKET_SENT, p.ptype, ntohs(((const struct sockaddr_in*)&j->to)->sin_port), p.stream,
+                   p.seq, (uint32_t)p.payload_size, p.window, 0);
+    }
+}
+
+/* Turns the reply a close was given into a PT_ERROR for the same stream */
+static void reply_error(WrJob* j, const char* msg) {
+    Packet p;
+    if (unpack_view((const uint8_t*)(j + 1), j->reply_len, &p) != 0) {
+        j->reply_len = 0;
+        return;
+    }
+    p.ptype = PT_ERROR;
+    p.flags = 0;
+    p.payload = (uint8_t*)msg;
+    p.payload_size = strlen(msg);
+    uint8_t buf[HEADER_SIZE + 64];
+    j->reply_len = pack_into(buf, sizeof(buf), &p);
+    memcpy(j + 1, buf, j->reply_len);
+}
+
+static void run_close(WriterPool* wp, WrJob* j) {
+    WrFile* f = j->file;
+    int finalize = j->finalize && !f->failed;
+    int mismatch = finalize && f->check && f->digest != f->expect;
+    if (mismatch) {
+        /* Some chunk is not what the client sent: keep the data out of
+         * final_path, and out of any resume */
+        char time_str[TIME_STR_SIZE];
+        fprintf(stderr, "[%s] Digest mismatch, %s left as %s\n", now_time(time_str, sizeof(time_str)),
+                f->final_path[0] ? f->final_path : f->path, f->path);
+        if (f->tracked) remove(f->map_path);
+        finalize = 0;
+    } else if (f->tracked && !finalize) {
+        checkpoint(f);
+    }
+#ifdef _WIN32
+    int closed = _close(f->fd) == 0;
+#else
+    int closed = close(f->fd) == 0;  /* also drops the flock() */
+#endif
+    if (closed && finalize && f->final_path[0]) {
+        closed = replace_file(f->path, f->final_path);
+        if (closed && f->tracked) remove(f->map_path);
+    }
+    mutex_lock(&wp->lock);
+    if (!closed) f->failed = 1;
+    f->status = f->failed ? WR_FAILED : mismatch ? WR_MISMATCH : WR_DONE;
+    int ok = !f->failed;
+    mutex_unlock(&wp->lock);
+
+    /* Only acknowledge once the data is in the file */
+    if (ok && mismatch && j->reply_len) reply_error(j, "digest mismatch");
+    if (ok && j->reply_len) {
+        send_reply(wp, j);
+    }
+    file_unref(f);
+    free(j);
+}
+
+static void run_notify(WriterPool* wp, WrJob* j) {
+    WrFile* f = j->file;
+    mutex_lock(&wp->lock);
+    int ok = !f->failed;
+    mutex_unlock(&wp->lock);
+    if (ok) {
+        send_reply(wp, j);
+    }
+    file_unref(f);
+    free(j);
+}
+
+static void writer_main(void* arg) {
+    WriterPool* wp = ((void**)arg)[0];
+    WrQueue* q = ((void**)arg)[1];
+    free(arg);
+
+    /* Compressed payloads expand here, off the network thread */
+    uint8_t* scratch = NULL;
+    void* ctx[CODEC_MAX];
+    const Codec* codecs[CODEC_MAX];
+    memset(ctx, 0, sizeof(ctx));
+
+    for (;;) {
+        mutex_lock(&q->lock);
+        while (!q->head && !q->stop) cond_wait(&q->ready, &q->lock);
+        WrJob* batch = q->head;
+        q->head = q->tail = NULL;
+        int stop = q->stop;
+        mutex_unlock(&q->lock);
+
+        if (!batch && stop) break;
+
+        /* Write the whole batch, then hand its buffers back in one go */
+        WrJob* done = NULL;
+        while (batch) {
+            WrJob* j = batch;
+            batch = j->next;
+            if (j->cls == WR_JOB_CLOSE) {
+                run_close(wp, j);
+                continue;
+            }
+            if (j->cls == WR_JOB_NOTIFY) {
+                run_notify(wp, j);
+                continue;
+            }
+            WrFile* f = j->file;
+            const uint8_t* data = (const uint8_t*)(j + 1);
+            size_t len = j->len;
+            if (j->codec) {
+                if (!scratch) scratch = malloc(WR_MAX_RAW);
+                if (!ctx[j->codec->id]) {
+                    ctx[j->codec->id] = j->codec->ctx_new();
+                    codecs[j->codec->id] = j->codec;
+                }
+                if (scratch && ctx[j->codec->id] && j->raw_len <= WR_MAX_RAW &&
+                    j->codec->decompress(ctx[j->codec->id], scratch, j->raw_len, data, len)) {
+                    data = scratch;
+                    len = j->raw_len;
+                } else {
+                    data = NULL;
+                }
+            }
+            if (!data || !write_at(f->fd, data, len, j->off)) {
+                mutex_lock(&wp->lock);
+                f->failed = 1;
+                mutex_unlock(&wp->lock);
+            } else {
+                /* Hashed while the chunk is still in cache, never read back */
+                if (f->chunk) f->digest += digest_chunk(data, len, (size_t)(j->off / f->chunk));
+                if (f->tracked) {
+                    bm_set(&f->written, (size_t)(j->off / f->chunk));
+                    f->dirty = 1;
+                    uint64_t now = us_now();
+                    if (now - f->last_checkpoint >= WR_CHECKPOINT_US) {
+                        checkpoint(f);
+                        f->last_checkpoint = now;
+                    }
+                }
+            }
+            j->next = done;
+            done = j;
+        }
+        while (done) {
+            /* Usually every buffer is ours; one lock per run of the same pool */
+            WriterPool* home = done->pool;
+            mutex_lock(&home->lock);
+            while (done && done->pool == home) {
+                WrJob* j = done;
+                done = j->next;
+                j->next = home->free_bufs[j->cls];
+                home->free_bufs[j->cls] = j;
+                home->in_use -= (size_t)1 << (WR_MIN_CLASS_SHIFT + j->cls);
+            }
+            mutex_unlock(&home->lock);
+        }
+    }
+    free(scratch);
+    for (int i = 0; i < CODEC_MAX; i++) {
+        if (ctx[i]) codecs[i]->ctx_free(ctx[i]);
+    }
+}
+
+static void enqueue(WriterPool* wp, int queue, WrJob* j) {
+    WrQueue* q = &wp->queues[queue];
+    j->next = NULL;
+    mutex_lock(&q->lock);
+    if (q->tail) q->tail->next = j;
+    else q->head = j;
+    q->tail = j;
+    mutex_unlock(&q->lock);
+    cond_signal(&q->ready);
+}
+
+int wr_pool_init(WriterPool* wp, int nthreads, size_t budget, SOCKET_TYPE sock) {
+    memset(wp, 0, sizeof(*wp));
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > WR_MAX_THREADS) nthreads = WR_MAX_THREADS;
+    wp->sock = sock;
+    wp->budget = budget;
+    mutex_init(&wp->lock);
+    for (int i = 0; i < nthreads; i++) {
+        WrQueue* q = &wp->queues[i];
+        mutex_init(&q->lock);
+        cond_init(&q->ready);
+        void** arg = malloc(2 * sizeof(void*));
+        if (!arg) break;
+        arg[0] = wp;
+        arg[1] = q;
+        if (!thread_start(&q->thread, writer_main, arg)) {
+            free(arg);
+            break;
+        }
+        wp->nthreads++;
+    }
+    return wp->nthreads > 0;
+}
+
+/* Drains every queue, then stops the threads */
+void wr_pool_destroy(WriterPool* wp) {
+    if (wp->nthreads == 0) return;
+    for (int i = 0; i < wp->nthreads; i++) {
+        WrQueue* q = &wp->queues[i];
+        mutex_lock(&q->lock);
+        q->stop = 1;
+        mutex_unlock(&q->lock);
+        cond_signal(&q->ready);
+        thread_join(q->thread);
+        cond_destroy(&q->ready);
+        mutex_destroy(&q->lock);
+    }
+    for (int c = 0; c < WR_SIZE_CLASSES; c++) {
+        while (wp->free_bufs[c]) {
+            WrJob* j = wp->free_bufs[c];
+            wp->free_bufs[c] = j->next;
+            free(j);
+        }
+    }
+    mutex_destroy(&wp->lock);
+    wp->nthreads = 0;
+}
+
+uint8_t* wr_buf_get(WriterPool* wp, size_t len) {
+    int cls = size_class(len);
+    if (cls < 0) return NULL;
+    size_t size = (size_t)1 << (WR_MIN_CLASS_SHIFT + cls);
+
+    mutex_lock(&wp->lock);
+    if (wp->in_use + size > wp->budget) {
+        mutex_unlock(&wp->lock);
+        return NULL;
+    }
+    WrJob* j = wp->free_bufs[cls];
+    if (j) wp->free_bufs[cls] = j->next;
+    wp->in_use += size;
+    mutex_unlock(&wp->lock);
+
+    if (!j) {
+        j = malloc(sizeof(WrJob) + size);
+        if (!j) {
+            mutex_lock(&wp->lock);
+            wp->in_use -= size;
+            mutex_unlock(&wp->lock);
+            return NULL;
+        }
+    }
+    j->cls = cls;
+    j->pool = wp;
+    return (uint8_t*)(j + 1);
+}
+
+/* How many more len-byte buffers the budget would hand out right now */
+size_t wr_buf_room(WriterPool* wp, size_t len) {
+    int cls = size_class(len);
+    if (cls < 0) return 0;
+    size_t size = (size_t)1 << (WR_MIN_CLASS_SHIFT + cls);
+    mutex_lock(&wp->lock);
+    size_t room = wp->in_use < wp->budget ? (wp->budget - wp->in_use) / size : 0;
+    mutex_unlock(&wp->lock);
+    return room;
+}
+
+/* Give back a buffer that was never queued */
+void wr_buf_put(WriterPool* wp, uint8_t* buf) {
+    if (!buf) return;
+    WrJob* j = (WrJob*)buf - 1;
+    wp = j->pool;
+    mutex_lock(&wp->lock);
+    j->next = wp->free_bufs[j->cls];
+    wp->free_bufs[j->cls] = j;
+    wp->in_use -= (size_t)1 << (WR_MIN_CLASS_SHIFT + j->cls);
+    mutex_unlock(&wp->lock);
+}
+
+static int open_output(const char* path, int exclusive) {
+    int fd;
+#ifdef _WIN32
+    if (_sopen_s(&fd, path, _O_WRONLY | _O_CREAT | _O_BINARY,
+                 exclusive ? _SH_DENYRW : _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0) {
+        return -1;
+    }
+#else
+    fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (fd >= 0 && exclusive && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return -1;
+    }
+#endif
+    return fd;
+}
+
+/* Opens the file right away so errors surface to the caller, truncating it
+ * unless opts->resume says what it already holds, and preallocates size
+ * bytes. Files written under a temporary name are locked: a second open of
+ * the same path fails while the first is live. Returns NULL on failure. */
+WrFile* wr_open(WriterPool* wp, const char* path, uint64_t size, const WrOpenOpts* opts) {
+    WrFile* f = calloc(1, sizeof(WrFile));
+    if (!f) return NULL;
+    f->close_job = calloc(1, sizeof(WrJob) + WR_MAX_REPLY);
+    if (!f->close_job) {
+        free(f);
+        return NULL;
+    }
+    f->close_job->file = f;
+    f->close_job->cls = WR_JOB_CLOSE;
+    f->pool = wp;
+    snprintf(f->path, sizeof(f->path), "%s", path);
+    if (opts && opts->final_path) {
+        snprintf(f->final_path, sizeof(f->final_path), "%s", opts->final_path);
+    }
+    if (opts) {
+        f->chunk = opts->chunk;
+        if (opts->resume) f->digest = opts->resume_digest;
+    }
+    if (opts && opts->map_path && opts->map_header && opts->chunk) {
+        f->tracked = 1;
+        snprintf(f->map_path, sizeof(f->map_path), "%s", opts->map_path);
+        f->map_header = malloc(strlen(opts->map_header) + 1);
+        int have_bits = opts->resume ? bm_copy(&f->written, opts->resume)
+                                     : bm_init(&f->written, opts->nchunks);
+        if (!f->map_header || !have_bits) {
+            file_free(f);
+            return NULL;
+        }
+        strcpy(f->map_header, opts->map_header);
+        f->last_checkpoint = us_now();
+    }
+
+    f->fd = open_output(path, f->tracked || f->final_path[0]);
+    if (f->fd < 0) {
+        file_free(f);
+        return NULL;
+    }
+    /* Truncate only after taking the lock, never under another writer */
+    if (!(opts && opts->resume)) {
+#ifdef _WIN32
+        _chsize_s(f->fd, 0);
+#else
+        if (ftruncate(f->fd, 0) != 0) {
+            /* Preallocation below still fixes the size */
+        }
+#endif
+    }
+    preallocate(f->fd, size);
+    f->refs = 1;
+    f->status = WR_PENDING;
+    f->queue = wp->next;
+    wp->next = (wp->next + 1) % wp->nthreads;
+    return f;
+}
+
+/* Reads a map saved by a tracked file. Succeeds only if it was written for
+ * exactly this header (same file identity and chunking) and nchunks. */
+int wr_load_map(const char* map_path, const char* map_header, size_t nchunks, Bitmap* out,
+                uint64_t* digest) {
+    FILE* fp = fopen(map_path, "rb");
+    if (!fp) return 0;
+    size_t hlen = strlen(map_header);
+    char* head = malloc(hlen + 1);
+    uint8_t be[8];
+    int ok = head && fread(head, 1, hlen, fp) == hlen && memcmp(head, map_header, hlen) == 0 &&
+             fread(be, 1, sizeof(be), fp) == sizeof(be);
+    free(head);
+    if (ok) *digest = get_be64(be);
+    if (ok) ok = bm_init(out, nchunks);
+    if (ok && (!bm_read(out, fp) || fgetc(fp) != EOF)) {
+        bm_free(out);
+        ok = 0;
+    }
+    fclose(fp);
+    return ok;
+}
+
+/* Queues len bytes of buf (from wr_buf_get) at off; takes ownership of buf */
+void wr_write(WriterPool* wp, WrFile* f, uint64_t off, uint8_t* buf, size_t len) {
+    wr_write_packed(wp, f, off, buf, len, NULL, len);
+}
+
+/* Like wr_write(), for a payload compressed with codec that must expand
+ * to raw_len bytes; a payload that does not fails the file */
+void wr_write_packed(WriterPool* wp, WrFile* f, uint64_t off, uint8_t* buf, size_t len,
+                     const Codec* codec, size_t raw_len) {
+    (void)wp;
+    WrJob* j = (WrJob*)buf - 1;
+    j->file = f;
+    j->off = off;
+    j->len = len;
+    j->codec = codec;
+    j->raw_len = raw_len;
+    enqueue(f->pool, f->queue, j);
+}
+
+/* Sends reply to `to` from the writer thread once every write queued so
+ * far is in the file, unless one failed. Unlike wr_close() it may be
+ * called any number of times; returns 0 if the job cannot be queued. */
+int wr_notify(WriterPool* wp, WrFile* f, const uint8_t* reply, size_t reply_len,
+              const void* to, SOCKLEN_TYPE tolen) {
+    (void)wp;
+    WrJob* j = malloc(sizeof(WrJob) + reply_len);
+    if (!j) return 0;
+    memset(j, 0, sizeof(*j));
+    j->file = f;
+    j->cls = WR_JOB_NOTIFY;
+    memcpy(j + 1, reply, reply_len);
+    memcpy(&j->to, to, (size_t)tolen);
+    j->tolen = tolen;
+    j->reply_len = reply_len;
+    mutex_lock(&f->pool->lock);
+    f->refs++;
+    mutex_unlock(&f->pool->lock);
+    enqueue(f->pool, f->queue, j);
+    return 1;
+}
+
+/* The digest the file must have for a finalizing close to go ahead;
+ * call before wr_close(), whose queueing publishes it to the writer */
+void wr_expect_digest(WrFile* f, uint64_t digest) {
+    f->expect = digest;
+    f->check = 1;
+}
+
+/* Closes f after its queued writes. A finalizing close moves the file to
+ * its final name; if that and every write succeeded the reply datagram (if
+ * any) is then sent to `to` from the writer thread. If the digest does not
+ * match the one expected, the file keeps its temporary name, its map is
+ * dropped and the reply goes out as a PT_ERROR instead. Call once per file. */
+void wr_close(WriterPool* wp, WrFile* f, int finalize, const uint8_t* reply, size_t reply_len,
+              const void* to, SOCKLEN_TYPE tolen) {
+    wp = f->pool;
+    WrJob* j = f->close_job;
+    f->close_job = NULL;
+    if (!j) return;
+    j->finalize = finalize;
+    mutex_lock(&wp->lock);
+    f->refs++;
+    mutex_unlock(&wp->lock);
+    if (reply && to && reply_len <= WR_MAX_REPLY) {
+        memcpy(j + 1, reply, reply_len);
+        memcpy(&j->to, to, (size_t)tolen);
+        j->tolen = tolen;
+        j->reply_len = reply_len;
+    }
+    enqueue(wp, f->queue, j);
+}
+
+WrStatus wr_status(WriterPool* wp, WrFile* f) {
+    wp = f->pool;
+    mutex_lock(&wp->lock);
+    WrStatus st = f->status;
+    mutex_unlock(&wp->lock);
+    return st;
+}
+
+/* Drops the caller's reference, queueing a silent close if wr_close() was
+ * never called; the file itself lives until its close has run */
+void wr_release(WriterPool* wp, WrFile* f) {
+    if (!f) return;
+    if (f->close_job) wr_close(wp, f, 0, NULL, 0, NULL, 0);
+    file_unref(f);
+}
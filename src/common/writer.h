@@ -0,0 +1,101 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "platform.h"
+#include "thread.h"
+#include "bitmap.h"
+#include "compress.h"
+
+/* Asynchronous positional file writer. The network thread copies each
+ * payload into a pooled buffer and queues it with its file offset; writer
+ * threads pwrite() it into place, so out-of-order data lands directly at its
+ * final position and a slow disk never blocks packet processing. Each file
+ * is pinned to one writer, which keeps its jobs in order: the close queued
+ * after the last write runs only once every write has hit the file.
+ * Buffers go back to size-class free lists; the bytes handed out at any one
+ * time are capped by a budget, and wr_buf_get() returning NULL is the
+ * back-pressure signal (drop the packet, the sender will resend it).
+ * A file may be written through another thread's pool: its jobs still go
+ * to the pool that opened it, and each buffer returns to the pool it was
+ * taken from. Compressed payloads are expanded by the writer thread. */
+
+#define WR_MAX_THREADS 16
+#define WR_SIZE_CLASSES 9       /* 256 B .. 64 KiB */
+#define WR_MAX_REPLY 512        /* largest datagram wr_close() can send */
+#define WR_CHECKPOINT_US 1000000ULL /* how often a tracked file saves its map */
+#define WR_MAX_RAW 65536        /* largest chunk a compressed payload may expand to */
+
+typedef enum {
+    WR_PENDING,                 /* open, or close still queued */
+    WR_DONE,                    /* closed after every write succeeded */
+    WR_FAILED,                  /* a write or the close failed */
+    WR_MISMATCH                 /* written, but not what wr_expect_digest() said */
+} WrStatus;
+
+typedef struct WrJob WrJob;
+typedef struct WrFile WrFile;
+
+/* Resumable output: the file is written under a temporary name and locked
+ * against a second writer. Its writer thread keeps a bitmap of the chunks
+ * that really reached the file and periodically saves it, after syncing
+ * the data, to map_path as map_header, the digest of those chunks (u64,
+ * big-endian) and the bitmap. A finalizing close renames the file to
+ * final_path and deletes the map; any other close saves the map one last
+ * time so wr_load_map() can resume it. Given a chunk size, the writer also
+ * folds every chunk it stores into the file's digest (digest.h). */
+typedef struct {
+    const char* final_path;
+    const char* map_path;
+    const char* map_header;
+    size_t chunk;
+    size_t nchunks;
+    const Bitmap* resume;       /* chunks already in the file, NULL = truncate */
+    uint64_t resume_digest;     /* and their digest, from wr_load_map() */
+} WrOpenOpts;
+
+typedef struct {
+    ru_thread thread;
+    ru_mutex lock;
+    ru_cond ready;
+    WrJob* head;
+    WrJob* tail;
+    int stop;
+} WrQueue;
+
+typedef struct {
+    SOCKET_TYPE sock;           /* close replies are sent from the writer */
+    int nthreads;
+    int next;                   /* round-robin file placement */
+    WrQueue queues[WR_MAX_THREADS];
+    ru_mutex lock;              /* buffer pool and file status */
+    WrJob* free_bufs[WR_SIZE_CLASSES];
+    size_t budget;
+    size_t in_use;
+} WriterPool;
+
+/* Function declarations */
+int wr_pool_init(WriterPool* wp, int nthreads, size_t budget, SOCKET_TYPE sock);
+void wr_pool_destroy(WriterPool* wp);
+
+uint8_t* wr_buf_get(WriterPool* wp, size_t len);
+size_t wr_buf_room(WriterPool* wp, size_t len);
+void wr_buf_put(WriterPool* wp, uint8_t* buf);
+
+WrFile* wr_open(WriterPool* wp, const char* path, uint64_t size, const WrOpenOpts* opts);
+void wr_write(WriterPool* wp, WrFile* f, uint64_t off, uint8_t* buf, size_t len);
+void wr_write_packed(WriterPool* wp, WrFile* f, uint64_t off, uint8_t* buf, size_t len,
+                     const Codec* codec, size_t raw_len);
+void wr_expect_digest(WrFile* f, uint64_t digest);
+void wr_close(WriterPool* wp, WrFile* f, int finalize, const uint8_t* reply, size_t reply_len,
+              const void* to, SOCKLEN_TYPE tolen);
+int wr_notify(WriterPool* wp, WrFile* f, const uint8_t* reply, size_t reply_len,
+              const void* to, SOCKLEN_TYPE tolen);
+WrStatus wr_status(WriterPool* wp, WrFile* f);
+void wr_release(WriterPool* wp, WrFile* f);
+
+int wr_load_map(const char* map_path, const char* map_header, size_t nchunks, Bitmap* out,
+                uint64_t* digest);
+
+#endif /* WRITER_H */
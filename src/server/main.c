@@ -1,470 +1,1415 @@
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include <errno.h>
-
-
-
-#include "../common/platform.h"
-#include "../common/protocol.h"
-#include "../common/util.h"
-#include "../common/crc32.h"
-
-typedef struct {
-    int port;
-    char outdir[1024];
-    uint16_t window;
-} Args;
-
-typedef struct {
-    char key[256];
-    FILE* ofs;
-    char filename[256];
-    size_t expected;
-    size_t total;
-    size_t received;
-    int active;
-    char target_path[1024];
-    uint32_t session_id;  // Unique session identifier
-    uint64_t last_activity; // Track last activity time for cleanup
-} Session;
-
-static void usage(const char* prog) {
-    fprintf(stderr, "Usage: %s [--port 9000] [--out ./server_data] [--window 8]\n", prog);
-}
-
-static int parse_args(int argc, char** argv, Args* a) {
-    /* Initialize defaults */
-    a->port = 9000;
-    strcpy(a->outdir, "./server_data");
-    a->window = 8;
-    
-    for (int i = 1; i < argc; i++) {
-        char* s = argv[i];
-        if (strcmp(s, "--port") == 0 && i+1 < argc) {
-            a->port = atoi(argv[++i]);
-        } else if (strcmp(s, "--out") == 0 && i+1 < argc) {
-            strncpy(a->outdir, argv[++i], sizeof(a->outdir) - 1);
-            a->outdir[sizeof(a->outdir) - 1] = '\0';
-        } else if (strcmp(s, "--window") == 0 && i+1 < argc) {
-            a->window = (uint16_t)atoi(argv[++i]);
-        } else {
-            usage(argv[0]);
-            return 0;
-        }
-    }
-    return 1;
-}
-
-static char* addr_key(const struct sockaddr_in* a) {
-    static char key[256];
-    char ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &a->sin_addr, ip, sizeof(ip));
-    snprintf(key, sizeof(key), "%s:%d", ip, ntohs(a->sin_port));
-    return key;
-}
-
-static Session* find_session(Session* sessions, int* session_count, const char* key) {
-    for (int i = 0; i < *session_count; i++) {
-        if (strcmp(sessions[i].key, key) == 0) {
-            return &sessions[i];
-        }
-    }
-    return NULL;
-}
-
-static void remove_session(Session* sessions, int* session_count, int index) {
-    if (index < *session_count - 1) {
-        memmove(&sessions[index], &sessions[index + 1], 
-                (*session_count - index - 1) * sizeof(Session));
-    }
-    (*session_count)--;
-}
-
-static void cleanup_old_session(Session* sessions, int* session_count, const char* key) {
-    for (int i = 0; i < *session_count; i++) {
-        if (strcmp(sessions[i].key, key) == 0) {
-            // Close any open file
-            if (sessions[i].ofs) {
-                fclose(sessions[i].ofs);
-                sessions[i].ofs = NULL;
-            }
-            // Remove the session
-            remove_session(sessions, session_count, i);
-            break;
-        }
-    }
-}
-
-static void cleanup_inactive_sessions(Session* sessions, int* session_count) {
-    uint64_t now = ms_since(0);
-    for (int i = *session_count - 1; i >= 0; i--) {
-        // Clean up sessions that have been inactive for more than 30 seconds
-        if (now - sessions[i].last_activity > 30000) {
-            if (sessions[i].ofs) {
-                fclose(sessions[i].ofs);
-                sessions[i].ofs = NULL;
-            }
-            remove_session(sessions, session_count, i);
-        }
-    }
-}
-
-int main(int argc, char** argv) {
-#ifdef _WIN32
-    // Initialize Winsock
-    WSADATA wsaData;
-    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (result != 0) {
-        fprintf(stderr, "WSAStartup failed: %d\n", result);
-        return 1;
-    }
-#endif
-
-    Args args;
-    if (!parse_args(argc, argv, &args)) {
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 1;
-    }
-    
-    MKDIR(args.outdir);
-
-    SOCKET_TYPE sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sock == INVALID_SOCKET_TYPE) {
-#ifdef _WIN32
-        fprintf(stderr, "socket failed: %d\n", WSAGetLastError());
-        WSACleanup();
-#else
-        fprintf(stderr, "socket failed: %s\n", strerror(errno));
-#endif
-        return 1;
-    }
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(args.port);
-
-    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-#ifdef _WIN32
-        fprintf(stderr, "bind failed: %d\n", WSAGetLastError());
-        closesocket(sock);
-        WSACleanup();
-#else
-        fprintf(stderr, "bind failed: %s\n", strerror(errno));
-        CLOSE_SOCKET(sock);
-#endif
-        return 1;
-    }
-
-    /* Non-blocking */
-#ifdef _WIN32
-    u_long mode = 1;
-    if (ioctlsocket(sock, FIONBIO, &mode) == SOCKET_ERROR) {
-        fprintf(stderr, "ioctlsocket failed: %d\n", WSAGetLastError());
-        closesocket(sock);
-        WSACleanup();
-        return 1;
-    }
-#else
-    int flags = fcntl(sock, F_GETFL, 0);
-    if (flags == -1) {
-        fprintf(stderr, "fcntl F_GETFL failed: %s\n", strerror(errno));
-        CLOSE_SOCKET(sock);
-        return 1;
-    }
-    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
-        fprintf(stderr, "fcntl F_SETFL failed: %s\n", strerror(errno));
-        CLOSE_SOCKET(sock);
-        return 1;
-    }
-#endif
-
-    Session sessions[100]; /* Max 100 concurrent sessions */
-    memset(sessions, 0, sizeof(sessions));  // Initialize all sessions to zero
-    int session_count = 0;
-    uint64_t last_cleanup = ms_since(0);
-
-    char* time_str = now_time();
-    printf("[%s] Server listening on UDP %d\n", time_str, args.port);
-    free(time_str);
-
-    while (1) {
-        uint8_t buf[64 * 1024];
-        struct sockaddr_in from;
-        int fromlen = sizeof(from);
-        int n = recvfrom(sock, (char*)buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
-        if (n <= 0) {
-#ifdef _WIN32
-            int error = WSAGetLastError();
-            if (error == WSAEWOULDBLOCK) {
-                Sleep(5); // Windows equivalent of usleep(5000)
-                // Periodic cleanup of inactive sessions
-                uint64_t now = ms_since(0);
-                if (now - last_cleanup > 10000) { // Every 10 seconds
-                    cleanup_inactive_sessions(sessions, &session_count);
-                    last_cleanup = now;
-                }
-                continue;
-            }
-            fprintf(stderr, "recvfrom failed: %d\n", error);
-#else
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(5000); // 5ms sleep
-                // Periodic cleanup of inactive sessions
-                uint64_t now = ms_since(0);
-                if (now - last_cleanup > 10000) { // Every 10 seconds
-                    cleanup_inactive_sessions(sessions, &session_count);
-                    last_cleanup = now;
-                }
-                continue;
-            }
-            fprintf(stderr, "recvfrom failed: %s\n", strerror(errno));
-#endif
-            continue;
-        }
-
-        char* key = addr_key(&from);
-        Packet p;
-        if (unpack(buf, n, &p) == 0) {
-            if (p.ptype == PT_HANDSHAKE) {
-                /* Convert payload to string */
-                char* meta = malloc(p.payload_size + 1);
-                if (!meta) {
-                    free_packet(&p);
-                    continue;
-                }
-                memcpy(meta, p.payload, p.payload_size);
-                meta[p.payload_size] = '\0';
-                
-                int parts_count;
-                char** parts = split(meta, '|', &parts_count);
-                if (!parts || parts_count < 5) {
-                    Packet err;
-                    memset(&err, 0, sizeof(err));
-                    err.magic0 = 'R';
-                    err.magic1 = 'U';
-                    err.version = VERSION;
-                    err.ptype = PT_ERROR;
-                    const char* msg = "bad handshake";
-                    err.payload = (uint8_t*)msg;
-                    err.payload_size = strlen(msg);
-                    
-                    size_t eb_size;
-                    uint8_t* eb = pack(&err, &eb_size);
-                    if (eb) {
-                        sendto(sock, (char*)eb, (int)eb_size, 0, (struct sockaddr*)&from, fromlen);
-                        free(eb);
-                    }
-                    
-                    if (parts) free_split_result(parts, parts_count);
-                    free(meta);
-                    free_packet(&p);
-                    continue;
-                }
-                
-                // Clean up any existing session for this client
-                cleanup_old_session(sessions, &session_count, key);
-                
-                if (session_count >= 100) {
-                    fprintf(stderr, "Too many sessions\n");
-                    if (parts) free_split_result(parts, parts_count);
-                    free(meta);
-                    free_packet(&p);
-                    continue;
-                }
-                
-                Session* s = &sessions[session_count];
-                memset(s, 0, sizeof(Session));  // Initialize all fields to zero
-                strncpy(s->key, key, sizeof(s->key) - 1);
-                s->key[sizeof(s->key) - 1] = '\0';
-                strncpy(s->filename, parts[0], sizeof(s->filename) - 1);
-                s->filename[sizeof(s->filename) - 1] = '\0';
-                s->total = (size_t)atoll(parts[2]);
-                s->expected = 0;
-                s->received = 0;
-                s->active = 1;
-                s->last_activity = ms_since(0);
-                s->session_id = (uint32_t)ms_since(0);  // Use timestamp as unique ID
-                s->ofs = NULL;  // Explicitly set file handle to NULL
-                
-                // Create unique filename to avoid conflicts
-                char unique_filename[512];
-                snprintf(unique_filename, sizeof(unique_filename), "%s_%u_%s", 
-                        s->filename, s->session_id, key);
-                snprintf(s->target_path, sizeof(s->target_path), "%s/%s", args.outdir, unique_filename);
-                
-                s->ofs = fopen(s->target_path, "wb");
-                if (!s->ofs) {
-                    fprintf(stderr, "Failed to create file: %s\n", s->target_path);
-                    if (parts) free_split_result(parts, parts_count);
-                    free(meta);
-                    free_packet(&p);
-                    continue;
-                }
-                
-                session_count++;
-
-                Packet ack;
-                memset(&ack, 0, sizeof(ack));
-                ack.magic0 = 'R';
-                ack.magic1 = 'U';
-                ack.version = VERSION;
-                ack.ptype = PT_HANDSHAKE_ACK;
-                ack.total = s->total;
-                ack.window = args.window;
-                
-                size_t b_size;
-                uint8_t* b = pack(&ack, &b_size);
-                if (b) {
-                    sendto(sock, (char*)b, (int)b_size, 0, (struct sockaddr*)&from, fromlen);
-                    free(b);
-                }
-                
-                time_str = now_time();
-                printf("[%s] %s handshake for %s total=%zu -> %s\n", 
-                       time_str, s->key, s->filename, s->total, s->target_path);
-                free(time_str);
-                
-                if (parts) free_split_result(parts, parts_count);
-                free(meta);
-            }
-            else if (p.ptype == PT_DATA) {
-                Session* s = find_session(sessions, &session_count, key);
-                if (!s) {
-                    Packet err;
-                    memset(&err, 0, sizeof(err));
-                    err.magic0 = 'R';
-                    err.magic1 = 'U';
-                    err.version = VERSION;
-                    err.ptype = PT_ERROR;
-                    const char* msg = "no session";
-                    err.payload = (uint8_t*)msg;
-                    err.payload_size = strlen(msg);
-                    
-                    size_t eb_size;
-                    uint8_t* eb = pack(&err, &eb_size);
-                    if (eb) {
-                        sendto(sock, (char*)eb, (int)eb_size, 0, (struct sockaddr*)&from, fromlen);
-                        free(eb);
-                    }
-                    free_packet(&p);
-                    continue;
-                }
-                
-                // Update activity time
-                s->last_activity = ms_since(0);
-                
-                /* Validate checksum */
-                uint32_t chk = ru_crc32(p.payload, p.payload_size);
-                if (chk != p.checksum) {
-                    /* drop corrupted packet, send cumulative ack for last in-order */
-                    Packet ack;
-                    memset(&ack, 0, sizeof(ack));
-                    ack.magic0 = 'R';
-                    ack.magic1 = 'U';
-                    ack.version = VERSION;
-                    ack.ptype = PT_ACK;
-                    ack.seq = (s->expected > 0) ? s->expected - 1 : 0;  /* ACK the last in-order packet */
-                    
-                    size_t b_size;
-                    uint8_t* b = pack(&ack, &b_size);
-                    if (b) {
-                        sendto(sock, (char*)b, (int)b_size, 0, (struct sockaddr*)&from, fromlen);
-                        free(b);
-                    }
-                    free_packet(&p);
-                    continue;
-                }
-                
-                if (p.seq == s->expected) {
-                    size_t written = fwrite(p.payload, 1, p.payload_size, s->ofs);
-                    if (written != p.payload_size) {
-                        fprintf(stderr, "Failed to write data: expected %zu, wrote %zu\n", 
-                               p.payload_size, written);
-                    }
-                    s->expected++;
-                    s->received++;
-                    
-                    // Try to write any buffered packets that are now in order
-                    // For simplicity, we'll just write in-order packets as they arrive
-                    // In a more sophisticated implementation, we'd buffer out-of-order packets
-                }
-                
-                /* cumulative ACK for last in-order */
-                Packet ack;
-                memset(&ack, 0, sizeof(ack));
-                ack.magic0 = 'R';
-                ack.magic1 = 'U';
-                ack.version = VERSION;
-                ack.ptype = PT_ACK;
-                ack.seq = (s->expected > 0) ? s->expected - 1 : 0;  /* ACK the last in-order packet */
-                
-                size_t b_size;
-                uint8_t* b = pack(&ack, &b_size);
-                if (b) {
-                    sendto(sock, (char*)b, (int)b_size, 0, (struct sockaddr*)&from, fromlen);
-                    free(b);
-                }
-            }
-            else if (p.ptype == PT_FIN) {
-                Session* s = find_session(sessions, &session_count, key);
-                if (s) {
-                    if (s->ofs) {
-                        fflush(s->ofs);
-                        fclose(s->ofs);
-                        s->ofs = NULL;
-                    }
-                    
-                    time_str = now_time();
-                    printf("[%s] %s transfer complete %zu/%zu packets -> %s\n", 
-                           time_str, s->key, s->received, s->total, s->target_path);
-                    free(time_str);
-                    
-                    /* Find index and remove */
-                    for (int i = 0; i < session_count; i++) {
-                        if (&sessions[i] == s) {
-                            remove_session(sessions, &session_count, i);
-                            break;
-                        }
-                    }
-                }
-                
-                Packet a;
-                memset(&a, 0, sizeof(a));
-                a.magic0 = 'R';
-                a.magic1 = 'U';
-                a.version = VERSION;
-                a.ptype = PT_FIN_ACK;
-                
-                size_t b_size;
-                uint8_t* b = pack(&a, &b_size);
-                if (b) {
-                    sendto(sock, (char*)b, (int)b_size, 0, (struct sockaddr*)&from, fromlen);
-                    free(b);
-                }
-            }
-            /* ignore others */
-            
-            free_packet(&p);
-        } else {
-            fprintf(stderr, "Failed to unpack packet\n");
-        }
-    }
-    
-    /* Cleanup */
-    for (int i = 0; i < session_count; i++) {
-        if (sessions[i].ofs) {
-            fclose(sessions[i].ofs);
-        }
-    }
-    
-    CLOSE_SOCKET(sock);
-#ifdef _WIN32
-    WSACleanup();
-#endif
-    return 0;
-}
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+
+
+#include "../common/platform.h"
+#include "../common/protocol.h"
+#include "../common/util.h"
+#include "../common/crc32.h"
+#include "../common/udpio.h"
+#include "../common/evloop.h"
+#include "../common/hashmap.h"
+#include "../common/slab.h"
+#include "../common/thread.h"
+#include "../common/writer.h"
+#include "../common/bitmap.h"
+#include "../common/fec.h"
+#include "../common/compress.h"
+#include "../common/stats.h"
+#include "../common/trace.h"
+
+typedef struct {
+    int port;
+    char outdir[1024];
+    uint16_t window;
+    int workers;            /* event-loop threads, 0 = one per CPU */
+    int writers;            /* disk writer threads per worker */
+    int ack_every;          /* in-order DATA packets per SACK */
+    uint32_t ack_delay;     /* longest a SACK is held back, microseconds */
+    int stats_interval;     /* seconds between printed summaries, 0 = none */
+    char stats[80];         /* [addr:]port of the metrics endpoint, "" = none */
+    char trace[1024];       /* --trace output file, "" = off */
+    uint64_t max_size;      /* largest file a handshake may announce */
+} Args;
+
+#define DEFAULT_MAX_SIZE (64ULL << 30)
+
+typedef struct Session {
+    uint64_t key;           // Packed peer address and stream, see session_key()
+    uint16_t stream;        // Client's id for this transfer, echoed in replies
+    char peer[64];          // "ip:port" for logs and file names
+    struct Session* prev;   // Sweep list of every live session
+    struct Session* next;
+    WrFile* wf;             // Output file, written by the worker's writer pool
+    int closing;            // FIN seen, close queued behind the last write
+    char filename[512];
+    size_t expected;        // First chunk not yet received
+    size_t total;
+    uint64_t size;          // File size in bytes, from the handshake
+    int active;
+    char target_path[1024]; // Final output name (the data goes to <name>.part first)
+    char ident[700];        // Upload identity; also the header of the .part map
+    uint32_t session_id;  // Unique session identifier
+    uint64_t last_activity; // Track last activity time for cleanup
+    size_t chunk;           // Negotiated chunk size from the handshake
+    /* Every accepted packet is queued straight to its file offset; the
+     * bitmap records which chunks are in, the window bounds how far past
+     * expected the client may run ahead */
+    uint16_t window;
+    Bitmap have;            // Bit i is chunk lo + i
+    size_t top;             // One past the highest bit set in have; ends SACK scans
+    /* A striped file is sent as one session per flow, each for its own
+     * chunk range [lo, hi); plain uploads cover [0, total) */
+    size_t lo;
+    size_t hi;
+    struct Transfer* xfer;  // Shared output of a striped file, or NULL
+    FecDecoder* fec;        // Parity groups being assembled, if the client asked for FEC
+    uint32_t recovered;     // Chunks rebuilt from parity, reported in every SACK
+    const Codec* codec;     // Agreed per-chunk compression, or NULL
+    uint32_t caps;          // CAP_* bits accepted in the handshake
+    /* Delayed ACKs: in-order packets are acknowledged every ack_every
+     * packets or after ack_delay, whichever comes first; anything else is
+     * acknowledged at the end of the receive batch */
+    struct sockaddr_in addr; // Where the SACKs go
+    int unacked;            // Accepted in-order packets not yet acknowledged
+    int ack_queued;         // Listed in the worker's ack_pending
+    EvTimer ack_timer;
+    uint64_t started_us;    // Handshake accepted
+    uint64_t bytes;         // Payload accepted, and as of the last summary
+    uint64_t bytes_reported;
+    uint32_t dups;          // DATA already held or out of the window
+    uint32_t crc_errors;
+} Session;
+
+#define MAX_FLOWS 64
+
+/* A file striped over several flows (client sockets, so possibly several
+ * workers). The flows' sessions borrow the transfer's output file; the
+ * last flow to FIN finalizes it. Only handshakes, FINs and session teardown
+ * touch the table, under its lock. */
+typedef struct Transfer {
+    uint64_t id;
+    char ident[700];
+    WrFile* wf;
+    char target_path[1024];
+    int nflows;
+    uint64_t joined;        // Bit per flow index
+    int fins;
+    int incomplete;         // A flow FINed with chunks missing
+    uint64_t digest;        // Sum of the flows' FIN digests, each over its range
+    int digests;            // FINs that carried one
+    int refs;               // Live flow sessions
+} Transfer;
+
+static ru_mutex xfer_lock;
+static HashMap xfers;       /* transfer id -> Transfer* */
+
+#define CLEANUP_INTERVAL_US 10000000ULL  /* sweep idle sessions every 10 s */
+
+/* A worker's counters, written only by its own thread (see stats.h) */
+typedef struct {
+    uint64_t datagrams;     /* received, of any type */
+    uint64_t rx_bytes;
+    uint64_t data_packets;  /* DATA accepted as new, and their payload bytes */
+    uint64_t data_bytes;
+    uint64_t duplicates;    /* DATA already held */
+    uint64_t window_drops;  /* DATA beyond the receive window */
+    uint64_t crc_errors;
+    uint64_t write_stalls;  /* DATA refused because the disk was behind */
+    uint64_t rebuilt;       /* chunks rebuilt from parity */
+    uint64_t sacks;
+    uint64_t opened;        /* sessions */
+    uint64_t closed;
+    uint64_t completed;     /* FINs with every chunk in, and without */
+    uint64_t incomplete;
+    StatHist batch;         /* datagrams per receive batch */
+    StatHist transfer_us;   /* handshake to FIN */
+} WorkerStats;
+#define WRITE_BUDGET (64u * 1024u * 1024u) /* payload bytes queued to disk per worker */
+
+/* One worker: its own socket in the SO_REUSEPORT group, event loop and
+ * shard of the session table. Workers share nothing on the packet path; the
+ * kernel keeps each client's 4-tuple on the same socket. */
+typedef struct {
+    const Args* args;
+    int id;
+    SOCKET_TYPE sock;
+    EvLoop loop;
+    EvTimer cleanup_timer;
+    UdpRx rx;
+    UdpTx tx;               /* replies queued while a receive batch is handled */
+    WriterPool writers;
+    HashMap sessions;       /* session_key() -> Session* */
+    Slab session_slab;
+    Session* session_list;
+    size_t session_count;
+    /* Sessions that owe a SACK once the current receive batch is handled;
+     * one per session however many of its packets the batch held */
+    Session* ack_pending[UDP_BATCH_MAX];
+    size_t nack_pending;
+    WorkerStats stats;
+    EvTimer stats_timer;    /* --stats-interval summaries */
+    uint64_t last_bytes;    /* worker 0: total payload at the last summary */
+    uint64_t last_us;
+} Server;
+
+/* Every worker, for totals across them */
+static Server* fleet;
+static int fleet_size;
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--port 9000] [--out ./server_data] [--window 256] [--workers 1] [--writers 2] "
+                    "[--ack-every 2] [--ack-delay 200] [--stats-interval 0] [--stats-port [addr:]port] [--trace <file>]\n"
+                    "       [--max-size 64G]\n", prog);
+}
+
+static int parse_args(int argc, char** argv, Args* a) {
+    /* Initialize defaults */
+    a->port = 9000;
+    strcpy(a->outdir, "./server_data");
+    a->window = 256;
+    a->workers = 1;
+    a->writers = 2;
+    a->ack_every = 2;
+    a->ack_delay = 200;
+    a->stats_interval = 0;
+    a->stats[0] = '\0';
+    a->trace[0] = '\0';
+    a->max_size = DEFAULT_MAX_SIZE;
+    
+    for (int i = 1; i < argc; i++) {
+        char* s = argv[i];
+        if (strcmp(s, "--port") == 0 && i+1 < argc) {
+            a->port = atoi(argv[++i]);
+        } else if (strcmp(s, "--out") == 0 && i+1 < argc) {
+            strncpy(a->outdir, argv[++i], sizeof(a->outdir) - 1);
+            a->outdir[sizeof(a->outdir) - 1] = '\0';
+        } else if (strcmp(s, "--window") == 0 && i+1 < argc) {
+            a->window = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(s, "--workers") == 0 && i+1 < argc) {
+            a->workers = atoi(argv[++i]);
+            if (a->workers < 0) a->workers = 1;
+        } else if (strcmp(s, "--writers") == 0 && i+1 < argc) {
+            a->writers = atoi(argv[++i]);
+            if (a->writers < 1) a->writers = 1;
+        } else if (strcmp(s, "--ack-every") == 0 && i+1 < argc) {
+            a->ack_every = atoi(argv[++i]);
+            if (a->ack_every < 1) a->ack_every = 1;
+        } else if (strcmp(s, "--ack-delay") == 0 && i+1 < argc) {
+            a->ack_delay = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(s, "--stats-interval") == 0 && i+1 < argc) {
+            a->stats_interval = atoi(argv[++i]);
+            if (a->stats_interval < 0) a->stats_interval = 0;
+        } else if (strcmp(s, "--stats-port") == 0 && i+1 < argc) {
+            strncpy(a->stats, argv[++i], sizeof(a->stats) - 1);
+            a->stats[sizeof(a->stats) - 1] = '\0';
+        } else if (strcmp(s, "--trace") == 0 && i+1 < argc) {
+            strncpy(a->trace, argv[++i], sizeof(a->trace) - 1);
+            a->trace[sizeof(a->trace) - 1] = '\0';
+        } else if (strcmp(s, "--max-size") == 0 && i+1 < argc) {
+            char* end;
+            a->max_size = strtoull(argv[++i], &end, 10);
+            int shift = *end == 'k' ? 10 : *end == 'M' ? 20 : *end == 'G' ? 30 : *end == 'T' ? 40 : 0;
+            if (shift) end++;
+            if (*end || a->max_size == 0 || a->max_size > (UINT64_MAX >> shift)) {
+                fprintf(stderr, "--max-size must be a positive byte count, optionally k, M, G or T\n");
+                return 0;
+            }
+            a->max_size <<= shift;
+        } else {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Sessions are keyed by the peer's IPv4 address and port packed into one
+ * integer, so the per-packet lookup does no string formatting */
+static uint64_t addr_key(const struct sockaddr_in* a) {
+    return ((uint64_t)ntohl(a->sin_addr.s_addr) << 16) | ntohs(a->sin_port);
+}
+
+/* One client address may run many transfers at once, told apart by the
+ * header's stream id; 48 address bits plus 16 stream bits fill the key */
+static uint64_t session_key(const struct sockaddr_in* a, uint16_t stream) {
+    return (addr_key(a) << 16) | stream;
+}
+
+static void format_peer(const struct sockaddr_in* a, char* out, size_t cap) {
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &a->sin_addr, ip, sizeof(ip));
+    snprintf(out, cap, "%s:%d", ip, ntohs(a->sin_port));
+}
+
+/* Queue a control packet; it goes out when the batch is flushed */
+static void send_packet(UdpTx* tx, const Packet* p,
+                        const struct sockaddr_in* to, int tolen) {
+    uint8_t* out = udp_tx_reserve(tx, HEADER_SIZE + p->payload_size);
+    size_t n = out ? pack_into(out, HEADER_SIZE + p->payload_size, p) : 0;
+    if (n) {
+        udp_tx_commit(tx, n, to, (SOCKLEN_TYPE)tolen);
+        TRACE(TR_PACKET_SENT, p->ptype, ntohs(to->sin_port), p->stream, p->seq,
+              (uint32_t)p->payload_size, p->window, 0);
+    }
+}
+
+/* A PT_ERROR telling the stream why it ends */
+static void send_error(UdpTx* tx, uint16_t stream, const char* msg,
+                       const struct sockaddr_in* to, int tolen) {
+    Packet err;
+    memset(&err, 0, sizeof(err));
+    err.magic0 = 'R';
+    err.magic1 = 'U';
+    err.version = VERSION;
+    err.ptype = PT_ERROR;
+    err.stream = stream;
+    err.payload = (uint8_t*)msg;
+    err.payload_size = strlen(msg);
+    send_packet(tx, &err, to, tolen);
+}
+
+/* Drops a flow's hold on its transfer; the last one releases the file */
+static void leave_transfer(Server* sv, Transfer* x) {
+    mutex_lock(&xfer_lock);
+    int last = --x->refs == 0;
+    if (last) hmap_remove(&xfers, x->id);
+    mutex_unlock(&xfer_lock);
+    if (last) {
+        wr_release(&sv->writers, x->wf);
+        free(x);
+    }
+}
+
+static void free_session(Server* sv, Session* s) {
+    ev_timer_stop(&sv->loop, &s->ack_timer);
+    if (s->ack_queued) {
+        for (size_t i = 0; i < sv->nack_pending; i++) {
+            if (sv->ack_pending[i] == s) {
+                sv->ack_pending[i] = sv->ack_pending[--sv->nack_pending];
+                break;
+            }
+        }
+        s->ack_queued = 0;
+    }
+    if (s->xfer) {
+        leave_transfer(sv, s->xfer);
+        s->xfer = NULL;
+    } else {
+        /* Queues the close behind any pending writes if FIN never came */
+        wr_release(&sv->writers, s->wf);
+    }
+    s->wf = NULL;
+    bm_free(&s->have);
+    fec_dec_free(s->fec);
+    free(s->fec);
+    s->fec = NULL;
+}
+
+static int init_receive_window(Session* s, uint16_t window, size_t chunk) {
+    s->window = window ? window : 1;
+    s->chunk = chunk;
+    return bm_init(&s->have, s->hi - s->lo);
+}
+
+/* Accept a DATA payload into the receive window. It is copied into a pooled
+ * buffer and queued for a positional write at seq * chunk, in whatever order
+ * it arrived; the window start then advances past every accepted packet.
+ * A compressed payload is queued as is and expanded by the writer.
+ * Returns 1 if the chunk was new and queued. */
+static int accept_data(Server* sv, Session* s, size_t seq, const uint8_t* data, size_t len,
+                       int packed) {
+    uint16_t flow = ntohs(s->addr.sin_port);
+    if (s->closing || seq < s->expected) {
+        STAT_ADD(sv->stats.duplicates, 1);
+        s->dups++;
+        TRACE(TR_PACKET_DROPPED, TD_DUPLICATE, flow, s->stream, (uint32_t)seq, (uint32_t)len, 0, 0);
+        return 0;
+    }
+    if (seq >= s->expected + s->window || seq >= s->hi) {
+        STAT_ADD(sv->stats.window_drops, 1);
+        s->dups++;
+        TRACE(TR_PACKET_DROPPED, TD_BEYOND_WINDOW, flow, s->stream, (uint32_t)seq, (uint32_t)len, 0, 0);
+        return 0;
+    }
+    uint64_t off = (uint64_t)seq * s->chunk;
+    size_t raw = s->size - off < s->chunk ? (size_t)(s->size - off) : s->chunk;
+    if (packed ? !s->codec || len == 0 || len > s->chunk : len != raw) {
+        TRACE(TR_PACKET_DROPPED, TD_INVALID, flow, s->stream, (uint32_t)seq, (uint32_t)len, 0, 0);
+        return 0; /* a raw chunk is exactly its chunk's size; only the last is short */
+    }
+    if (bm_test(&s->have, seq - s->lo)) {
+        STAT_ADD(sv->stats.duplicates, 1);
+        s->dups++;
+        TRACE(TR_PACKET_DROPPED, TD_DUPLICATE, flow, s->stream, (uint32_t)seq, (uint32_t)len, 0, 0);
+        return 0; /* already queued */
+    }
+
+    uint8_t* buf = wr_buf_get(&sv->writers, len);
+    if (!buf) {
+        STAT_ADD(sv->stats.write_stalls, 1);
+        TRACE(TR_PACKET_DROPPED, TD_WRITE_STALL, flow, s->stream, (uint32_t)seq, (uint32_t)len, 0, 0);
+        return 0; /* the disk is behind; leave it unacknowledged so it is resent */
+    }
+    memcpy(buf, data, len);
+    if (packed) {
+        wr_write_packed(&sv->writers, s->wf, off, buf, len, s->codec, raw);
+    } else {
+        wr_write(&sv->writers, s->wf, off, buf, len);
+    }
+    bm_set(&s->have, seq - s->lo);
+    if (seq - s->lo >= s->top) s->top = seq - s->lo + 1;
+    STAT_ADD(sv->stats.data_packets, 1);
+    STAT_ADD(sv->stats.data_bytes, len);
+    s->bytes += len;
+    if (seq == s->expected) {
+        s->expected = s->lo + bm_next_clear(&s->have, seq - s->lo + 1);
+    }
+    return 1;
+}
+
+/* Folds a chunk or parity packet into its FEC group; once the group lacks
+ * just one chunk, that chunk is rebuilt and accepted as if it had arrived */
+static void fec_receive(Server* sv, Session* s, size_t seq, int shift, int parity,
+                        const uint8_t* data, size_t len) {
+    FecGroup* g = fec_dec_add(s->fec, seq, shift, s->lo, s->hi, parity, data, len);
+    if (!g) return;
+    size_t lost;
+    const uint8_t* chunk = fec_dec_missing(g, &lost);
+    uint64_t off = (uint64_t)lost * s->chunk;
+    size_t n = s->size - off < s->chunk ? (size_t)(s->size - off) : s->chunk;
+    if (accept_data(sv, s, lost, chunk, n, 0)) {
+        s->recovered++;
+        STAT_ADD(sv->stats.rebuilt, 1);
+    }
+    fec_dec_release(s->fec, g);
+}
+
+/* Send a PT_SACK: seq is the next expected packet, the payload marks which
+ * packets past it have already been accepted. The header's window is how
+ * far past seq the client may send right now: the chunks already held there
+ * plus as many more as the writer pool has buffers for, split evenly among
+ * the worker's sessions, never more than the negotiated window and never
+ * 0 (a lone packet then probes until the disk catches up). */
+static void send_sack(Server* sv, const Session* s,
+                      const struct sockaddr_in* to, int tolen) {
+    uint8_t payload[SACK_RECOVERED_SIZE + SACK_MAX_BYTES];
+    size_t lead = s->fec ? SACK_RECOVERED_SIZE : 0;
+    uint8_t* bitmap = payload + lead;
+    size_t nbytes = 0;
+    size_t held = 0;
+    if (s->fec) put_be32(payload, s->recovered);
+    /* Bit 0 is expected + 1; nothing is held at or past top */
+    size_t from = s->expected - s->lo + 1;
+    size_t span = s->window - 1 < SACK_MAX_BYTES * 8 ? s->window - 1 : SACK_MAX_BYTES * 8;
+    if (s->top <= from) span = 0;
+    else if (s->top - from < span) span = s->top - from;
+    if (span) nbytes = bm_extract(&s->have, from, span, bitmap, &held);
+    size_t room = wr_buf_room(&sv->writers, s->chunk) / (sv->session_count ? sv->session_count : 1);
+    size_t window = held + room < s->window ? held + room : s->window;
+
+    Packet ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.magic0 = 'R';
+    ack.magic1 = 'U';
+    ack.version = VERSION;
+    ack.ptype = PT_SACK;
+    ack.stream = s->stream;
+    ack.seq = (uint32_t)s->expected;
+    ack.total = (uint32_t)s->total;
+    ack.window = (uint16_t)(window ? window : 1);
+    ack.payload = lead + nbytes ? payload : NULL;
+    ack.payload_size = lead + nbytes;
+
+    send_packet(&sv->tx, &ack, to, tolen);
+    STAT_ADD(sv->stats.sacks, 1);
+}
+
+/* SACK whatever the session holds now, settling any delayed ACK */
+static void ack_send(Server* sv, Session* s) {
+    ev_timer_stop(&sv->loop, &s->ack_timer);
+    s->unacked = 0;
+    send_sack(sv, s, &s->addr, (int)sizeof(s->addr));
+}
+
+/* Owe a SACK at the end of the receive batch, so a batch holding many of
+ * a session's packets answers them all with one */
+static void ack_soon(Server* sv, Session* s) {
+    if (s->ack_queued) return;
+    if (sv->nack_pending == UDP_BATCH_MAX) {
+        ack_send(sv, s);
+        return;
+    }
+    sv->ack_pending[sv->nack_pending++] = s;
+    s->ack_queued = 1;
+}
+
+/* An in-order packet: acknowledge every ack_every of them, or once the
+ * oldest unacknowledged one has waited ack_delay */
+static void ack_later(Server* sv, Session* s) {
+    if (++s->unacked >= sv->args->ack_every || sv->args->ack_delay == 0) {
+        ack_soon(sv, s);
+    } else if (!ev_timer_active(&s->ack_timer)) {
+        ev_timer_start(&sv->loop, &s->ack_timer, us_now() + sv->args->ack_delay);
+    }
+}
+
+static void flush_acks(Server* sv) {
+    while (sv->nack_pending) {
+        Session* s = sv->ack_pending[--sv->nack_pending];
+        s->ack_queued = 0;
+        ack_send(sv, s);
+    }
+}
+
+static void on_ack_timer(EvTimer* t, uint64_t now_us) {
+    Server* sv = t->arg;
+    Session* s = (Session*)((char*)t - offsetof(Session, ack_timer));
+    (void)now_us;
+    s->unacked = 0;
+    send_sack(sv, s, &s->addr, (int)sizeof(s->addr));
+}
+
+static Session* find_session(Server* sv, uint64_t key) {
+    return hmap_get(&sv->sessions, key);
+}
+
+static int insert_session(Server* sv, Session* s) {
+    if (!hmap_put(&sv->sessions, s->key, s)) return 0;
+    s->prev = NULL;
+    s->next = sv->session_list;
+    if (s->next) s->next->prev = s;
+    sv->session_list = s;
+    sv->session_count++;
+    STAT_ADD(sv->stats.opened, 1);
+    return 1;
+}
+
+/* Unlink, close and recycle a session */
+static void remove_session(Server* sv, Session* s) {
+    hmap_remove(&sv->sessions, s->key);
+    if (s->prev) s->prev->next = s->next;
+    else sv->session_list = s->next;
+    if (s->next) s->next->prev = s->prev;
+    sv->session_count--;
+    STAT_ADD(sv->stats.closed, 1);
+    free_session(sv, s);
+    slab_free(&sv->session_slab, s);
+}
+
+static void cleanup_old_session(Server* sv, uint64_t key) {
+    Session* s = find_session(sv, key);
+    if (s) {
+        remove_session(sv, s);
+    }
+}
+
+static void cleanup_inactive_sessions(Server* sv) {
+    uint64_t now = ms_since(0);
+    Session* s = sv->session_list;
+    while (s) {
+        Session* next = s->next;
+        // Clean up sessions that have been inactive for more than 30 seconds,
+        // and finished ones once their FIN_ACK had a sweep interval to arrive
+        if (now - s->last_activity > 30000 ||
+            (s->closing && now - s->last_activity > CLEANUP_INTERVAL_US / 1000 &&
+             wr_status(&sv->writers, s->wf) == WR_DONE)) {
+            remove_session(sv, s);
+        }
+        s = next;
+    }
+}
+
+/* How long a session must have been silent before a new upload of the same
+ * file may take it over (a client restarted on another port) */
+#define TAKEOVER_IDLE_MS 1000
+
+/* A relative path of '/'-separated names, none of which could climb out of
+ * the output directory. On Windows '\' also separates and ':' names a
+ * drive or stream, so neither may appear; elsewhere both are plain bytes. */
+static int valid_filename(const char* name) {
+#ifdef _WIN32
+    if (strpbrk(name, "\\:")) return 0;
+#endif
+    const char* c = name;
+    for (;;) {
+        size_t len = strcspn(c, "/");
+        if (len == 0 || (len == 1 && c[0] == '.') || (len == 2 && c[0] == '.' && c[1] == '.')) {
+            return 0;
+        }
+        if (!c[len]) return 1;
+        c += len + 1;
+    }
+}
+
+/* Creates the directories of a path below the output directory */
+static void make_parents(const char* outdir, char* path) {
+    for (char* c = path + strlen(outdir) + 1; *c; c++) {
+        if (*c == '/') {
+            *c = '\0';
+            MKDIR(path);
+            *c = '/';
+        }
+    }
+}
+
+static Session* find_target(Server* sv, const char* target_path) {
+    for (Session* s = sv->session_list; s; s = s->next) {
+        if (s->wf && strcmp(s->target_path, target_path) == 0) return s;
+    }
+    return NULL;
+}
+
+/* Opens the session's output. The data goes to <name>.part and is renamed
+ * to <name> by the finalizing close. With a content id the .part is also
+ * resumable: its writer saves a map of the chunks on disk, and a later
+ * upload of the same identity picks up the chunks the map records.
+ * If another live transfer holds the .part, fall back to a private,
+ * non-resumable name. */
+static int open_target(Server* sv, Session* s, int resumable) {
+    char part[1100], map[1110];
+    snprintf(s->target_path, sizeof(s->target_path), "%s/%s", sv->args->outdir, s->filename);
+    snprintf(part, sizeof(part), "%s.part", s->target_path);
+    snprintf(map, sizeof(map), "%s.map", part);
+    make_parents(sv->args->outdir, s->target_path);
+
+    /* Same upload restarted from a new address while its old, now silent,
+     * session is still open on this worker: take over the file as is */
+    Session* prev = find_target(sv, s->target_path);
+    if (prev && resumable && !prev->xfer && !prev->closing && strcmp(prev->ident, s->ident) == 0 &&
+        s->last_activity - prev->last_activity >= TAKEOVER_IDLE_MS) {
+        bm_free(&s->have);
+        s->have = prev->have;
+        s->top = prev->top;
+        memset(&prev->have, 0, sizeof(prev->have));
+        s->wf = prev->wf;
+        prev->wf = NULL;
+        remove_session(sv, prev);
+        s->expected = s->lo + bm_next_clear(&s->have, 0);
+        return 1;
+    }
+
+    Bitmap loaded;
+    const Bitmap* resume = NULL;
+    uint64_t resume_digest = 0;
+    struct stat st;
+    if (resumable && stat(part, &st) == 0 && (uint64_t)st.st_size == s->size &&
+        wr_load_map(map, s->ident, s->total, &loaded, &resume_digest)) {
+        bm_free(&s->have);
+        s->have = loaded;
+        s->top = loaded.nbits;
+        resume = &s->have;
+    }
+
+    WrOpenOpts opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.final_path = s->target_path;
+    opts.map_path = resumable ? map : NULL;
+    opts.map_header = s->ident;
+    opts.chunk = s->chunk;
+    opts.nchunks = s->total;
+    opts.resume = resume;
+    opts.resume_digest = resume_digest;
+    s->wf = wr_open(&sv->writers, part, s->size, &opts);
+    if (s->wf) {
+        s->expected = s->lo + bm_next_clear(&s->have, 0);
+        return 1;
+    }
+
+    if (resume) {
+        bm_free(&s->have);
+        s->top = 0;
+        if (!bm_init(&s->have, s->total)) return 0;
+    }
+    char unique_filename[700];
+    snprintf(unique_filename, sizeof(unique_filename), "%s_%u_%s",
+             s->filename, s->session_id, s->peer);
+    snprintf(s->target_path, sizeof(s->target_path), "%s/%s", sv->args->outdir, unique_filename);
+    WrOpenOpts plain;
+    memset(&plain, 0, sizeof(plain));
+    plain.chunk = s->chunk; /* for the digest */
+    s->wf = wr_open(&sv->writers, s->target_path, s->size, &plain);
+    s->expected = s->lo;
+    return s->wf != NULL;
+}
+
+static void send_handshake_ack(Server* sv, const Session* s,
+                               const struct sockaddr_in* to, int tolen) {
+    uint8_t opts[HS_ACK_MAX];
+    uint8_t ranges[RESUME_MAX_BYTES];
+    Packet ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.magic0 = 'R';
+    ack.magic1 = 'U';
+    ack.version = VERSION;
+    ack.ptype = PT_HANDSHAKE_ACK;
+    ack.stream = s->stream;
+    ack.seq = (uint32_t)s->expected;
+    ack.total = s->total;
+    ack.window = s->window;
+
+    TlvBuf b;
+    tlv_init(&b, opts, sizeof(opts));
+    tlv_put_u32(&b, HS_CAPS, s->caps);
+    if (s->codec) {
+        uint8_t id = (uint8_t)s->codec->id;
+        tlv_put(&b, HS_CODEC, &id, 1);
+    }
+    if ((s->caps & CAP_RESUME) && s->have.count > s->expected) {
+        tlv_put(&b, HS_RANGES, ranges, resume_encode(ranges, sizeof(ranges), &s->have, s->expected));
+    }
+    ack.payload = opts;
+    ack.payload_size = b.len;
+    send_packet(&sv->tx, &ack, to, tolen);
+}
+
+/* Attaches a flow session to its striped transfer, opening the shared
+ * output on the first flow to arrive */
+static int join_transfer(Server* sv, Session* s, uint64_t id, int flow, int nflows) {
+    int ok = 0;
+    mutex_lock(&xfer_lock);
+    Transfer* x = hmap_get(&xfers, id);
+    if (!x) {
+        x = calloc(1, sizeof(Transfer));
+        if (x && open_target(sv, s, 0)) {
+            x->id = id;
+            memcpy(x->ident, s->ident, sizeof(x->ident));
+            x->wf = s->wf;
+            memcpy(x->target_path, s->target_path, sizeof(x->target_path));
+            x->nflows = nflows;
+            if (hmap_put(&xfers, id, x)) {
+                ok = 1;
+            } else {
+                wr_release(&sv->writers, x->wf);
+            }
+        }
+        if (!ok) {
+            free(x);
+            x = NULL;
+        }
+        s->wf = NULL;
+    } else if (strcmp(x->ident, s->ident) == 0 && x->nflows == nflows &&
+               !(x->joined & ((uint64_t)1 << flow)) && x->fins < x->nflows) {
+        memcpy(s->target_path, x->target_path, sizeof(s->target_path));
+        ok = 1;
+    }
+    if (ok) {
+        x->joined |= (uint64_t)1 << flow;
+        x->refs++;
+        s->xfer = x;
+        s->wf = x->wf;
+        s->expected = s->lo;
+    }
+    mutex_unlock(&xfer_lock);
+    return ok;
+}
+
+/* First FIN of a flow: the last flow closes (and, if every flow was
+ * complete, finalizes) the shared file, the others are acknowledged once
+ * their writes are in it. The file's digest is checked only if every flow
+ * sent its part of it. */
+static void finish_flow(Server* sv, Session* s, int complete, const uint8_t* digest,
+                        const uint8_t* reply, size_t n, const struct sockaddr_in* to, int tolen) {
+    Transfer* x = s->xfer;
+    mutex_lock(&xfer_lock);
+    if (!complete) x->incomplete = 1;
+    if (digest) {
+        x->digest += get_be64(digest);
+        x->digests++;
+    }
+    int last = ++x->fins == x->nflows;
+    int finalize = !x->incomplete;
+    int check = x->digests == x->nflows;
+    mutex_unlock(&xfer_lock);
+    if (last) {
+        if (check) wr_expect_digest(x->wf, x->digest);
+        wr_close(&sv->writers, x->wf, finalize, reply, n, to, (SOCKLEN_TYPE)tolen);
+    } else {
+        wr_notify(&sv->writers, x->wf, reply, n, to, (SOCKLEN_TYPE)tolen);
+    }
+}
+
+/* Dispatch one datagram from a client */
+static void handle_packet(Server* sv, const uint8_t* buf, size_t n,
+                          const struct sockaddr_in* from, int fromlen) {
+    Packet p;
+    int rc = unpack_view(buf, n, &p);
+    if (rc == 0) {
+        TRACE(TR_PACKET_RECEIVED, p.ptype, ntohs(from->sin_port), p.stream, p.seq,
+              (uint32_t)p.payload_size, p.window, 0);
+        uint64_t key = session_key(from, p.stream);
+        if (p.ptype == PT_HANDSHAKE) {
+            Handshake hs;
+            if (!hs_parse(p.payload, p.payload_size, &hs)) {
+                send_error(&sv->tx, p.stream, "bad handshake", from, fromlen);
+                return;
+            }
+            /* Every chunk costs bitmap bits and the size is reserved on
+             * disk up front, so both are bounded before anything is */
+            if (hs.chunk < MIN_CHUNK || hs.chunk > MAX_PACKET - HEADER_SIZE) {
+                send_error(&sv->tx, p.stream, "chunk size out of range", from, fromlen);
+                return;
+            }
+            if (hs.size > sv->args->max_size) {
+                send_error(&sv->tx, p.stream, "file too large", from, fromlen);
+                return;
+            }
+            if (!valid_filename(hs.name)) {
+                send_error(&sv->tx, p.stream, "invalid file name", from, fromlen);
+                return;
+            }
+            if ((uint64_t)p.total != (hs.size + hs.chunk - 1) / hs.chunk) {
+                send_error(&sv->tx, p.stream, "packet count mismatch", from, fromlen);
+                return;
+            }
+            if ((hs.caps & CAP_STRIPE) && (hs.nflows < 1 || hs.nflows > MAX_FLOWS || hs.flow >= hs.nflows)) {
+                send_error(&sv->tx, p.stream, "bad flow", from, fromlen);
+                return;
+            }
+            
+            size_t chunk = hs.chunk;
+            int resumable = (hs.caps & CAP_RESUME) != 0;
+            char content_id[16] = "-";
+            if (resumable) snprintf(content_id, sizeof(content_id), "%08x", (unsigned)hs.id);
+            char ident[sizeof(((Session*)0)->ident)];
+            snprintf(ident, sizeof(ident), "RUFT-PART 2 %s %llu %zu %s\n",
+                     hs.name, (unsigned long long)hs.size, chunk, content_id);
+
+            /* A retransmitted handshake (our ACK was lost) must not restart
+             * the transfer: answer it from the live session, even one an
+             * early FIN has already closed */
+            Session* s = find_session(sv, key);
+            if (s && strcmp(s->ident, ident) == 0) {
+                send_handshake_ack(sv, s, from, fromlen);
+                return;
+            }
+
+            // Clean up any existing session for this client
+            cleanup_old_session(sv, key);
+            
+            s = slab_alloc(&sv->session_slab);  // Zeroed
+            if (!s) {
+                fprintf(stderr, "Cannot allocate session\n");
+                return;
+            }
+            s->key = key;
+            s->stream = p.stream;
+            s->addr = *from;
+            ev_timer_init(&s->ack_timer, on_ack_timer, sv);
+            format_peer(from, s->peer, sizeof(s->peer));
+            strncpy(s->filename, hs.name, sizeof(s->filename) - 1);
+            s->filename[sizeof(s->filename) - 1] = '\0';
+            memcpy(s->ident, ident, sizeof(s->ident));
+            s->size = hs.size;
+            s->total = p.total;
+            s->hi = s->total;
+            s->expected = 0;
+
+            /* CAP_STRIPE: flow i of n carries chunks
+             * [total * i / n, total * (i + 1) / n) */
+            int flow = 0, nflows = 0;
+            if (hs.caps & CAP_STRIPE) {
+                flow = hs.flow;
+                nflows = hs.nflows;
+            }
+            if (nflows > 0) {
+                s->lo = (size_t)((uint64_t)s->total * (uint64_t)flow / (uint64_t)nflows);
+                s->hi = (size_t)((uint64_t)s->total * (uint64_t)(flow + 1) / (uint64_t)nflows);
+                resumable = 0;
+            }
+            s->active = 1;
+            s->last_activity = ms_since(0);
+            s->session_id = (uint32_t)ms_since(0);  // Use timestamp as unique ID
+
+            /* Receive window is the smaller of ours and what the client asked for */
+            uint16_t window = sv->args->window;
+            if (p.window > 0 && p.window < window) window = p.window;
+            if (!init_receive_window(s, window, chunk)) {
+                fprintf(stderr, "Cannot allocate receive window for %s\n", s->peer);
+                free_session(sv, s);
+                slab_free(&sv->session_slab, s);
+                return;
+            }
+
+            /* CAP_COMPRESS: the first offered codec this build has; with
+             * none the bit stays out of the ACK and chunks come raw */
+            if (hs.caps & CAP_COMPRESS) {
+                for (size_t i = 0; i < hs.ncodecs && !s->codec; i++) s->codec = codec_by_id(hs.codecs[i]);
+            }
+
+            /* CAP_FEC: the client sends parity groups; without memory for
+             * them we simply decline. Parity covers raw chunks, so it does
+             * not combine with compression. */
+            if ((hs.caps & CAP_FEC) && !s->codec) {
+                s->fec = malloc(sizeof(FecDecoder));
+                if (s->fec && !fec_dec_init(s->fec, chunk)) {
+                    fec_dec_free(s->fec);
+                    free(s->fec);
+                    s->fec = NULL;
+                }
+            }
+            s->caps = (hs.caps & CAP_STRIPE) | (resumable ? CAP_RESUME : 0) |
+                      (s->codec ? CAP_COMPRESS : 0) | (s->fec ? CAP_FEC : 0) | (hs.caps & CAP_DIGEST);
+            
+            int opened = nflows > 0
+                ? join_transfer(sv, s, hs.xfer, flow, nflows)
+                : open_target(sv, s, resumable);
+            if (!opened) {
+                fprintf(stderr, "Failed to create file: %s\n", s->target_path);
+                free_session(sv, s);
+                slab_free(&sv->session_slab, s);
+                return;
+            }
+            
+            if (!insert_session(sv, s)) {
+                fprintf(stderr, "Cannot allocate session\n");
+                free_session(sv, s);
+                slab_free(&sv->session_slab, s);
+                return;
+            }
+
+            s->started_us = us_now();
+            send_handshake_ack(sv, s, from, fromlen);
+            
+            char time_str[TIME_STR_SIZE];
+            now_time(time_str, sizeof(time_str));
+            if (s->xfer) {
+                printf("[%s] %s handshake for %s total=%zu flow %d/%d chunks [%zu, %zu) -> %s\n",
+                       time_str, s->peer, s->filename, s->total, flow + 1, nflows,
+                       s->lo, s->hi, s->target_path);
+            } else if (s->have.count) {
+                printf("[%s] %s handshake for %s total=%zu resuming with %zu chunks -> %s\n", 
+                       time_str, s->peer, s->filename, s->total, s->have.count, s->target_path);
+            } else {
+                printf("[%s] %s handshake for %s total=%zu -> %s\n", 
+                       time_str, s->peer, s->filename, s->total, s->target_path);
+            }
+        }
+        else if (p.ptype == PT_DATA) {
+            Session* s = find_session(sv, key);
+            if (!s) {
+                TRACE(TR_PACKET_DROPPED, TD_NO_SESSION, ntohs(from->sin_port), p.stream, p.seq,
+                      (uint32_t)p.payload_size, 0, 0);
+            }
+            if (!s && (p.flags & PF_EARLY)) {
+                return; /* overtook its handshake; the sender resends it as lost */
+            }
+            if (!s) {
+                send_error(&sv->tx, p.stream, "no session", from, fromlen);
+                return;
+            }
+            
+            // Update activity time
+            s->last_activity = ms_since(0);
+            
+            /* Validate checksum */
+            uint32_t chk = ru_crc32(p.payload, p.payload_size);
+            if (chk != p.checksum) {
+                /* drop corrupted packet, report what we do hold */
+                STAT_ADD(sv->stats.crc_errors, 1);
+                s->crc_errors++;
+                TRACE(TR_PACKET_DROPPED, TD_BAD_CHECKSUM, ntohs(from->sin_port), p.stream, p.seq,
+                      (uint32_t)p.payload_size, 0, 0);
+                ack_soon(sv, s);
+                return;
+            }
+            
+            int shift = p.flags & PF_FEC_MASK;
+            int packed = (p.flags & PF_COMPRESSED) != 0;
+            size_t before = s->expected;
+            int fresh = accept_data(sv, s, p.seq, p.payload, p.payload_size, packed);
+            if (fresh && s->fec && shift) {
+                fec_receive(sv, s, p.seq, shift, 0, p.payload, p.payload_size);
+            }
+            
+            /* cumulative ACK plus a bitmap of the buffered packets. Only the
+             * next packet in order may wait for company; a gap, a filled
+             * hole, a duplicate or the last chunk is reported straight away
+             * so the sender's loss detection and FIN are never held up. */
+            if (fresh && p.seq == before && s->expected == before + 1 && s->expected < s->hi) {
+                ack_later(sv, s);
+            } else {
+                ack_soon(sv, s);
+            }
+        }
+        else if (p.ptype == PT_PARITY) {
+            Session* s = find_session(sv, key);
+            if (!s || !s->fec || s->closing || p.seq < s->lo || p.seq >= s->hi ||
+                ru_crc32(p.payload, p.payload_size) != p.checksum) {
+                return; /* parity is only ever a shortcut, never worth an error */
+            }
+            s->last_activity = ms_since(0);
+            size_t start, end;
+            fec_group_bounds(p.seq, p.flags & PF_FEC_MASK, s->lo, s->hi, &start, &end);
+            if (bm_next_clear(&s->have, start - s->lo) + s->lo >= end) {
+                return; /* every chunk of the group is already in */
+            }
+            uint32_t before = s->recovered;
+            fec_receive(sv, s, p.seq, p.flags & PF_FEC_MASK, 1, p.payload, p.payload_size);
+            if (s->recovered != before) ack_soon(sv, s);
+        }
+        else if (p.ptype == PT_FIN) {
+            Packet a;
+            memset(&a, 0, sizeof(a));
+            a.magic0 = 'R';
+            a.magic1 = 'U';
+            a.version = VERSION;
+            a.ptype = PT_FIN_ACK;
+            a.stream = p.stream;
+
+            Session* s = find_session(sv, key);
+            if ((p.flags & PF_EARLY) && (!s || (!s->closing && s->have.count != s->hi - s->lo))) {
+                return; /* sent on spec behind early DATA that did not all arrive */
+            }
+            if (s && !s->closing) {
+                s->closing = 1;
+                s->last_activity = ms_since(0);
+
+                char time_str[TIME_STR_SIZE];
+                now_time(time_str, sizeof(time_str));
+                if (s->fec) {
+                    printf("[%s] %s transfer complete %zu/%zu packets, %u rebuilt from parity -> %s\n",
+                           time_str, s->peer, s->have.count, s->hi - s->lo, s->recovered, s->target_path);
+                } else {
+                    printf("[%s] %s transfer complete %zu/%zu packets -> %s\n", 
+                           time_str, s->peer, s->have.count, s->hi - s->lo, s->target_path);
+                }
+
+                /* The writer sends FIN_ACK once every queued write is in the file */
+                uint8_t reply[HEADER_SIZE];
+                size_t n = pack_into(reply, sizeof(reply), &a);
+                int complete = s->have.count == s->hi - s->lo;
+                if (complete) STAT_ADD(sv->stats.completed, 1);
+                else STAT_ADD(sv->stats.incomplete, 1);
+                stat_observe(&sv->stats.transfer_us, us_now() - s->started_us);
+                const uint8_t* digest = (s->caps & CAP_DIGEST) && p.payload_size == FIN_DIGEST_SIZE
+                                        ? p.payload : NULL;
+                if (s->xfer) {
+                    finish_flow(sv, s, complete, digest, reply, n, from, fromlen);
+                } else {
+                    if (digest) wr_expect_digest(s->wf, get_be64(digest));
+                    wr_close(&sv->writers, s->wf, complete, reply, n, from, (SOCKLEN_TYPE)fromlen);
+                }
+                return;
+            }
+            if (s) {
+                /* Retransmitted FIN */
+                WrStatus st = wr_status(&sv->writers, s->wf);
+                if (st == WR_PENDING) {
+                    if (s->xfer) {
+                        /* The shared file waits for the other flows; this
+                         * one's writes may well be in by now */
+                        uint8_t reply[HEADER_SIZE];
+                        size_t n = pack_into(reply, sizeof(reply), &a);
+                        wr_notify(&sv->writers, s->wf, reply, n, from, (SOCKLEN_TYPE)fromlen);
+                    }
+                    return; /* still flushing; the writer will answer */
+                }
+                if (st == WR_FAILED || st == WR_MISMATCH) {
+                    send_error(&sv->tx, p.stream, st == WR_MISMATCH ? "digest mismatch" : "write failed",
+                               from, fromlen);
+                    remove_session(sv, s);
+                    return;
+                }
+                remove_session(sv, s);
+            }
+            
+            send_packet(&sv->tx, &a, from, fromlen);
+        }
+        else if (p.ptype == PT_PROBE) {
+            /* Path MTU probe: report the size that got through, no session */
+            Packet a;
+            memset(&a, 0, sizeof(a));
+            a.magic0 = 'R';
+            a.magic1 = 'U';
+            a.version = VERSION;
+            a.ptype = PT_PROBE_ACK;
+            a.seq = (uint32_t)n;
+            a.stream = p.stream;
+            send_packet(&sv->tx, &a, from, fromlen);
+        }
+        /* ignore others */
+        
+    } else if ((rc == -1 || rc == -2) && n >= 4 && buf[0] == 'R' && buf[1] == 'U' && buf[2] != VERSION &&
+               buf[3] == PT_HANDSHAKE) {
+        /* A client speaking another protocol version: tell it so in a
+         * header it can parse */
+        uint8_t* out = udp_tx_reserve(&sv->tx, HEADER_SIZE + 64);
+        size_t len = out ? pack_version_error(out, HEADER_SIZE + 64, buf, n, "unsupported protocol version") : 0;
+        if (len) udp_tx_commit(&sv->tx, len, from, (SOCKLEN_TYPE)fromlen);
+    } else {
+        fprintf(stderr, "Failed to unpack packet\n");
+    }
+}
+
+static void on_cleanup_timer(EvTimer* t, uint64_t now_us) {
+    Server* sv = t->arg;
+    cleanup_inactive_sessions(sv);
+    ev_timer_start(&sv->loop, t, now_us + CLEANUP_INTERVAL_US);
+}
+
+/* Every worker's counters added up; safe from any thread */
+static void stats_total(WorkerStats* t) {
+    memset(t, 0, sizeof(*t));
+    for (int i = 0; i < fleet_size; i++) {
+        const WorkerStats* w = &fleet[i].stats;
+        t->datagrams += STAT_LOAD(w->datagrams);
+        t->rx_bytes += STAT_LOAD(w->rx_bytes);
+        t->data_packets += STAT_LOAD(w->data_packets);
+        t->data_bytes += STAT_LOAD(w->data_bytes);
+        t->duplicates += STAT_LOAD(w->duplicates);
+        t->window_drops += STAT_LOAD(w->window_drops);
+        t->crc_errors += STAT_LOAD(w->crc_errors);
+        t->write_stalls += STAT_LOAD(w->write_stalls);
+        t->rebuilt += STAT_LOAD(w->rebuilt);
+        t->sacks += STAT_LOAD(w->sacks);
+        t->opened += STAT_LOAD(w->opened);
+        t->closed += STAT_LOAD(w->closed);
+        t->completed += STAT_LOAD(w->completed);
+        t->incomplete += STAT_LOAD(w->incomplete);
+        stat_hist_add(&t->batch, &w->batch);
+        stat_hist_add(&t->transfer_us, &w->transfer_us);
+    }
+}
+
+/* --stats-port: one scrape, rendered on the endpoint's thread */
+static void render_metrics(StatText* t, void* arg) {
+    (void)arg;
+    WorkerStats w;
+    stats_total(&w);
+    stat_counter(t, "ruft_datagrams_received_total", "Datagrams received, of any type", w.datagrams);
+    stat_counter(t, "ruft_received_bytes_total", "Bytes of every datagram received", w.rx_bytes);
+    stat_counter(t, "ruft_data_packets_total", "DATA packets accepted as new", w.data_packets);
+    stat_counter(t, "ruft_data_bytes_total", "Payload bytes of accepted DATA", w.data_bytes);
+    stat_counter(t, "ruft_duplicate_packets_total", "DATA packets already held", w.duplicates);
+    stat_counter(t, "ruft_window_drops_total", "DATA packets beyond the receive window", w.window_drops);
+    stat_counter(t, "ruft_crc_errors_total", "DATA packets that failed the checksum", w.crc_errors);
+    stat_counter(t, "ruft_write_stalls_total", "DATA packets refused while the disk was behind",
+                 w.write_stalls);
+    stat_counter(t, "ruft_fec_rebuilt_total", "Chunks rebuilt from parity", w.rebuilt);
+    stat_counter(t, "ruft_sacks_sent_total", "SACKs sent", w.sacks);
+    stat_counter(t, "ruft_sessions_opened_total", "Sessions opened by a handshake", w.opened);
+    stat_counter(t, "ruft_sessions_closed_total", "Sessions closed or expired", w.closed);
+    stat_counter(t, "ruft_transfers_completed_total", "FINs with every chunk received", w.completed);
+    stat_counter(t, "ruft_transfers_incomplete_total", "FINs with chunks missing", w.incomplete);
+    stat_gauge(t, "ruft_sessions", "Live sessions", (double)(w.opened - w.closed));
+    stat_gauge(t, "ruft_workers", "Worker threads", (double)fleet_size);
+    stat_hist(t, "ruft_rx_batch_datagrams", "Datagrams per receive batch", &w.batch, 1);
+    stat_hist(t, "ruft_transfer_duration_seconds", "Handshake to FIN", &w.transfer_us, 1e-6);
+}
+
+/* --stats-interval: worker 0 prints the totals, every worker its sessions */
+static void on_stats_timer(EvTimer* t, uint64_t now_us) {
+    Server* sv = t->arg;
+    uint64_t interval = (uint64_t)sv->args->stats_interval * 1000000;
+    char time_str[TIME_STR_SIZE];
+    now_time(time_str, sizeof(time_str));
+    if (sv->id == 0) {
+        WorkerStats w;
+        stats_total(&w);
+        double secs = (double)(now_us - sv->last_us) / 1e6;
+        printf("[%s] stats: %llu sessions, %.1f Mbit/s in, %llu DATA (%llu dup, %llu beyond window, "
+               "%llu CRC errors, %llu write stalls, %llu rebuilt), %llu SACKs\n",
+               time_str, (unsigned long long)(w.opened - w.closed),
+               (double)(w.data_bytes - sv->last_bytes) * 8 / secs / 1e6,
+               (unsigned long long)w.data_packets, (unsigned long long)w.duplicates,
+               (unsigned long long)w.window_drops, (unsigned long long)w.crc_errors,
+               (unsigned long long)w.write_stalls, (unsigned long long)w.rebuilt,
+               (unsigned long long)w.sacks);
+        sv->last_bytes = w.data_bytes;
+        sv->last_us = now_us;
+    }
+    for (Session* s = sv->session_list; s; s = s->next) {
+        if (s->closing) continue;
+        size_t n = s->hi - s->lo;
+        printf("[%s]   %s %s: %zu/%zu chunks (%.1f%%), %.1f Mbit/s, window %u, %u dup, %u CRC errors\n",
+               time_str, s->peer, s->filename, s->have.count, n,
+               n ? 100.0 * (double)s->have.count / (double)n : 100.0,
+               (double)(s->bytes - s->bytes_reported) * 8 / ((double)interval / 1e6) / 1e6,
+               s->window, s->dups, s->crc_errors);
+        s->bytes_reported = s->bytes;
+    }
+    fflush(stdout);
+    ev_timer_start(&sv->loop, t, now_us + interval);
+}
+
+/* Bound, non-blocking UDP socket; with reuseport it joins the port's
+ * load-balancing group so several workers can bind the same port */
+static SOCKET_TYPE open_socket(int port, int reuseport) {
+    SOCKET_TYPE sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET_TYPE) {
+#ifdef _WIN32
+        fprintf(stderr, "socket failed: %d\n", WSAGetLastError());
+#else
+        fprintf(stderr, "socket failed: %s\n", strerror(errno));
+#endif
+        return INVALID_SOCKET_TYPE;
+    }
+
+#ifdef RU_REUSEPORT_LB
+    if (reuseport) {
+        int on = 1;
+        if (setsockopt(sock, SOL_SOCKET, RU_REUSEPORT_LB, &on, sizeof(on)) == -1) {
+            fprintf(stderr, "SO_REUSEPORT failed: %s\n", strerror(errno));
+            CLOSE_SOCKET(sock);
+            return INVALID_SOCKET_TYPE;
+        }
+    }
+#else
+    (void)reuseport;
+#endif
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+#ifdef _WIN32
+        fprintf(stderr, "bind failed: %d\n", WSAGetLastError());
+#else
+        fprintf(stderr, "bind failed: %s\n", strerror(errno));
+#endif
+        CLOSE_SOCKET(sock);
+        return INVALID_SOCKET_TYPE;
+    }
+
+    /* Non-blocking */
+#ifdef _WIN32
+    u_long mode = 1;
+    if (ioctlsocket(sock, FIONBIO, &mode) == SOCKET_ERROR) {
+        fprintf(stderr, "ioctlsocket failed: %d\n", WSAGetLastError());
+        closesocket(sock);
+        return INVALID_SOCKET_TYPE;
+    }
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags == -1) {
+        fprintf(stderr, "fcntl F_GETFL failed: %s\n", strerror(errno));
+        CLOSE_SOCKET(sock);
+        return INVALID_SOCKET_TYPE;
+    }
+    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
+        fprintf(stderr, "fcntl F_SETFL failed: %s\n", strerror(errno));
+        CLOSE_SOCKET(sock);
+        return INVALID_SOCKET_TYPE;
+    }
+#endif
+
+    udp_tune_buffers(sock, UDP_SOCKET_BUFFER);
+    return sock;
+}
+
+static int server_init(Server* sv, const Args* args, int id, SOCKET_TYPE sock) {
+    memset(sv, 0, sizeof(*sv));
+    sv->args = args;
+    sv->id = id;
+    sv->sock = sock;
+    slab_init(&sv->session_slab, sizeof(Session), 64);
+    if (!hmap_init(&sv->sessions, 64) ||
+        !udp_rx_init(&sv->rx, sock, 65536, UDP_BATCH_MAX) ||
+        !udp_tx_init(&sv->tx, sock, UDP_BATCH_MAX * (HEADER_SIZE + SACK_RECOVERED_SIZE + SACK_MAX_BYTES))) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 0;
+    }
+    if (!ev_init(&sv->loop) || !ev_add(&sv->loop, sock)) {
+        fprintf(stderr, "event loop setup failed\n");
+        return 0;
+    }
+    if (!wr_pool_init(&sv->writers, args->writers, WRITE_BUDGET, sock)) {
+        fprintf(stderr, "Failed to start writer threads\n");
+        return 0;
+    }
+    ev_timer_init(&sv->cleanup_timer, on_cleanup_timer, sv);
+    ev_timer_start(&sv->loop, &sv->cleanup_timer, us_now() + CLEANUP_INTERVAL_US);
+    ev_timer_init(&sv->stats_timer, on_stats_timer, sv);
+    sv->last_us = us_now();
+    if (args->stats_interval) {
+        ev_timer_start(&sv->loop, &sv->stats_timer, sv->last_us + (uint64_t)args->stats_interval * 1000000);
+    }
+    return 1;
+}
+
+static void server_free(Server* sv) {
+    while (sv->session_list) {
+        remove_session(sv, sv->session_list);
+    }
+    wr_pool_destroy(&sv->writers);  /* finishes every queued write */
+    hmap_free(&sv->sessions);
+    slab_destroy(&sv->session_slab);
+    udp_rx_free(&sv->rx);
+    udp_tx_free(&sv->tx);
+    ev_close(&sv->loop);
+    if (sv->sock != INVALID_SOCKET_TYPE) CLOSE_SOCKET(sv->sock);
+}
+
+/* Worker loop; runs on its own thread, or on the main one for worker 0 */
+static void server_run(void* arg) {
+    Server* sv = arg;
+    while (1) {
+        /* Sleep until a datagram arrives or a delayed ACK or the cleanup timer is due */
+        SOCKET_TYPE ready;
+        int nready = ev_wait(&sv->loop, &ready, 1);
+        if (nready < 0) {
+            fprintf(stderr, "event wait failed: %s\n", strerror(errno));
+            break;
+        }
+        if (nready == 0) {
+            udp_tx_flush(&sv->tx);  /* delayed ACKs from expired timers */
+            continue;
+        }
+
+        /* Level-triggered: anything left after one batch wakes the next wait */
+        int got = udp_rx_recv(&sv->rx);
+        if (got < 0) {
+#ifdef _WIN32
+            fprintf(stderr, "recvfrom failed: %d\n", WSAGetLastError());
+#else
+            fprintf(stderr, "recvfrom failed: %s\n", strerror(errno));
+#endif
+            continue;
+        }
+
+        UdpMsg m;
+        uint64_t count = 0, bytes = 0;
+        while (udp_rx_next(&sv->rx, &m)) {
+            count++;
+            bytes += m.len;
+            if (m.addr->ss_family != AF_INET) continue;
+            handle_packet(sv, m.data, m.len, (const struct sockaddr_in*)m.addr, (int)m.addrlen);
+        }
+        if (count) {
+            STAT_ADD(sv->stats.datagrams, count);
+            STAT_ADD(sv->stats.rx_bytes, bytes);
+            stat_observe(&sv->stats.batch, count);
+        }
+        flush_acks(sv);
+        udp_tx_flush(&sv->tx);
+    }
+}
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    // Initialize Winsock
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (result != 0) {
+        fprintf(stderr, "WSAStartup failed: %d\n", result);
+        return 1;
+    }
+#endif
+
+    Args args;
+    if (!parse_args(argc, argv, &args)) {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
+    
+    if (args.trace[0] && !trace_open(args.trace, "server")) {
+        fprintf(stderr, "Cannot write trace %s\n", args.trace);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
+
+    MKDIR(args.outdir);
+    mutex_init(&xfer_lock);
+    if (!hmap_init(&xfers, 16)) {
+        fprintf(stderr, "Memory allocation failed\n");
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
+
+    int nworkers = args.workers > 0 ? args.workers : cpu_count();
+#ifndef RU_REUSEPORT_LB
+    if (nworkers > 1) {
+        fprintf(stderr, "--workers needs SO_REUSEPORT load balancing; using 1 worker\n");
+        nworkers = 1;
+    }
+#endif
+
+    Server* workers = calloc((size_t)nworkers, sizeof(Server));
+    ru_thread* threads = calloc((size_t)nworkers, sizeof(ru_thread));
+    if (!workers || !threads) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(workers);
+        free(threads);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
+
+    /* Bind every socket before any traffic is read, so the kernel's
+     * 4-tuple -> socket mapping is settled from the first datagram */
+    int ok = 1;
+    int ready = 0;
+    for (int i = 0; i < nworkers && ok; i++) {
+        SOCKET_TYPE sock = open_socket(args.port, nworkers > 1);
+        if (sock == INVALID_SOCKET_TYPE) {
+            ok = 0;
+            break;
+        }
+        ok = server_init(&workers[i], &args, i, sock);
+        ready++;
+    }
+    if (!ok) {
+        for (int i = 0; i < ready; i++) server_free(&workers[i]);
+        free(workers);
+        free(threads);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
+
+    fleet = workers;
+    fleet_size = nworkers;
+    StatServer stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.sock = INVALID_SOCKET_TYPE;
+    if (args.stats[0] && !stats_serve(&stats, args.stats, render_metrics, NULL)) {
+        fprintf(stderr, "Cannot serve metrics on %s\n", args.stats);
+    }
+
+    char time_str[TIME_STR_SIZE];
+    now_time(time_str, sizeof(time_str));
+    printf("[%s] Server listening on UDP %d (%d worker%s)\n", time_str, args.port,
+           nworkers, nworkers == 1 ? "" : "s");
+    if (stats.sock != INVALID_SOCKET_TYPE) {
+        printf("[%s] Metrics on http://%s%s/metrics\n", time_str,
+               strchr(args.stats, ':') ? "" : "127.0.0.1:", args.stats);
+    }
+    fflush(stdout);
+
+    for (int i = 1; i < nworkers; i++) {
+        if (!thread_start(&threads[i], server_run, &workers[i])) {
+            /* Its socket would silently swallow a share of the clients */
+            fprintf(stderr, "Failed to start worker %d\n", i);
+            exit(1);
+        }
+    }
+    server_run(&workers[0]);
+    for (int i = 1; i < nworkers; i++) thread_join(threads[i]);
+    stats_stop(&stats);
+    
+    /* Cleanup */
+    for (int i = 0; i < nworkers; i++) server_free(&workers[i]);
+    free(workers);
+    free(threads);
+    hmap_free(&xfers);
+    mutex_destroy(&xfer_lock);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
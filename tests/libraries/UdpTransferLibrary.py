@@ -1,255 +1,415 @@
-import os
-import subprocess
-import time
-import signal
-import shutil
-from pathlib import Path
-from typing import Optional, Dict, Any
-
-
-class UdpTransferLibrary:
-    """Robot Framework library for testing UDP reliable transfer protocol."""
-    
-    def __init__(self):
-        self.server_process = None
-        # Get the project root directory (2 levels up from this file)
-        project_root = Path(__file__).parent.parent.parent
-        self.build_dir = str(project_root / "build" / "bin")
-        self.server_data_dir = str(project_root / "server_data")
-        self.sample_data_dir = str(project_root / "sample_data")
-    
-    def start_server(self, port: int = 9000, output_dir: str = None) -> None:
-        """Start the UDP server.
-        
-        Args:
-            port: Server port number
-            output_dir: Directory where received files will be saved
-        """
-        if self.server_process:
-            self.stop_server()
-        
-        # Use default output directory if none provided
-        if output_dir is None:
-            output_dir = self.server_data_dir
-            
-        # Ensure output directory exists
-        os.makedirs(output_dir, exist_ok=True)
-        
-        # Start server process
-        server_cmd = [f"{self.build_dir}/server.exe", "--port", str(port), "--out", output_dir]
-        self.server_process = subprocess.Popen(
-            server_cmd,
-            stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
-            text=True
-        )
-        
-        # Wait a bit for server to start
-        time.sleep(0.5)
-        
-        if self.server_process.poll() is not None:
-            raise RuntimeError(f"Server failed to start: {self.server_process.stderr.read()}")
-    
-    def stop_server(self) -> None:
-        """Stop the UDP server."""
-        if self.server_process:
-            self.server_process.terminate()
-            try:
-                self.server_process.wait(timeout=5)
-            except subprocess.TimeoutExpired:
-                self.server_process.kill()
-                self.server_process.wait()
-            self.server_process = None
-    
-    def send_file(self, host: str, port: int, file_path: str) -> int:
-        """Send a file using the UDP client.
-        
-        Args:
-            host: Server hostname/IP
-            port: Server port
-            file_path: Path to file to send
-            
-        Returns:
-            Exit code of the client process
-        """
-        if not os.path.exists(file_path):
-            raise FileNotFoundError(f"File not found: {file_path}")
-        
-        client_cmd = [
-            f"{self.build_dir}/client.exe",
-            "--host", host,
-            "--port", str(port),
-            "--file", file_path
-        ]
-        
-        result = subprocess.run(client_cmd, capture_output=True, text=True)
-        return result.returncode
-    
-    def send_file_with_options(self, host: str, port: int, file_path: str, **options) -> int:
-        """Send a file using the UDP client with custom options.
-        
-        Args:
-            host: Server hostname/IP
-            port: Server port
-            file_path: Path to file to send
-            **options: Additional options (chunk, window, timeout, max_retries)
-            
-        Returns:
-            Exit code of the client process
-        """
-        if not os.path.exists(file_path):
-            raise FileNotFoundError(f"File not found: {file_path}")
-        
-        client_cmd = [
-            f"{self.build_dir}/client.exe",
-            "--host", host,
-            "--port", str(port),
-            "--file", file_path
-        ]
-        
-        # Add optional parameters
-        if 'chunk' in options:
-            client_cmd.extend(["--chunk", str(options['chunk'])])
-        if 'window' in options:
-            client_cmd.extend(["--window", str(options['window'])])
-        if 'timeout' in options:
-            client_cmd.extend(["--timeout", str(options['timeout'])])
-        if 'max_retries' in options:
-            client_cmd.extend(["--max-retries", str(options['max_retries'])])
-        
-        result = subprocess.run(client_cmd, capture_output=True, text=True)
-        return result.returncode
-    
-    def get_file_size(self, file_path: str) -> int:
-        """Get the size of a file in bytes.
-        
-        Args:
-            file_path: Path to the file
-            
-        Returns:
-            File size in bytes
-        """
-        if not os.path.exists(file_path):
-            return 0
-        return os.path.getsize(file_path)
-    
-    def compare_files(self, file1: str, file2: str) -> bool:
-        """Compare two files for equality.
-        
-        Args:
-            file1: Path to first file
-            file2: Path to second file
-            
-        Returns:
-            True if files are identical, False otherwise
-        """
-        if not os.path.exists(file1) or not os.path.exists(file2):
-            return False
-        
-        # Compare file sizes first
-        if os.path.getsize(file1) != os.path.getsize(file2):
-            return False
-        
-        # Compare file contents
-        with open(file1, 'rb') as f1, open(file2, 'rb') as f2:
-            return f1.read() == f2.read()
-    
-    def copy_file(self, src: str, dst: str) -> None:
-        """Copy a file from source to destination.
-        
-        Args:
-            src: Source file path
-            dst: Destination file path
-        """
-        shutil.copy2(src, dst)
-    
-    def remove_file(self, file_path: str, missing_ok: bool = False) -> None:
-        """Remove a file.
-        
-        Args:
-            file_path: Path to file to remove
-            missing_ok: If True, don't raise error if file doesn't exist
-        """
-        try:
-            os.remove(file_path)
-        except FileNotFoundError:
-            if not missing_ok:
-                raise
-    
-    def create_directory(self, dir_path: str) -> None:
-        """Create a directory.
-        
-        Args:
-            dir_path: Path to directory to create
-        """
-        os.makedirs(dir_path, exist_ok=True)
-    
-    def remove_directory(self, dir_path: str, recursive: bool = False) -> None:
-        """Remove a directory.
-        
-        Args:
-            dir_path: Path to directory to remove
-            recursive: If True, remove directory and all contents
-        """
-        if recursive:
-            shutil.rmtree(dir_path, ignore_errors=True)
-        else:
-            os.rmdir(dir_path)
-    
-    def file_exists(self, file_path: str) -> bool:
-        """Check if a file exists.
-        
-        Args:
-            file_path: Path to file to check
-            
-        Returns:
-            True if file exists, False otherwise
-        """
-        return os.path.exists(file_path)
-    
-    def directory_exists(self, dir_path: str) -> bool:
-        """Check if a directory exists.
-        
-        Args:
-            dir_path: Path to directory to check
-            
-        Returns:
-            True if directory exists, False otherwise
-        """
-        return os.path.isdir(dir_path)
-    
-    def get_server_output(self) -> str:
-        """Get the server's stdout output.
-        
-        Returns:
-            Server's stdout output as string
-        """
-        if self.server_process:
-            return self.server_process.stdout.read() if self.server_process.stdout else ""
-        return ""
-    
-    def get_server_error(self) -> str:
-        """Get the server's stderr output.
-        
-        Returns:
-            Server's stderr output as string
-        """
-        if self.server_process:
-            return self.server_process.stderr.read() if self.server_process.stderr else ""
-        return ""
-    
-    def wait_for_server_ready(self, timeout: int = 10) -> bool:
-        """Wait for server to be ready.
-        
-        Args:
-            timeout: Timeout in seconds
-            
-        Returns:
-            True if server is ready, False if timeout
-        """
-        start_time = time.time()
-        while time.time() - start_time < timeout:
-            if self.server_process and self.server_process.poll() is None:
-                return True
-            time.sleep(0.1)
-        return False
+import os
+import subprocess
+import time
+import signal
+import shutil
+import socket
+import struct
+import zlib
+from pathlib import Path
+from typing import Optional, Dict, Any
+
+
+# Wire format (src/common/protocol.h), used to send what the client never would
+PROTOCOL_VERSION = 3
+HEADER = struct.Struct(">2sBBIIHHIHBx")  # magic, version, type, seq, total, length, window, crc, stream, flags
+PT_HANDSHAKE, PT_HANDSHAKE_ACK, PT_DATA, PT_FIN, PT_FIN_ACK, PT_ERROR, PT_SACK = 0, 1, 2, 4, 5, 6, 7
+HS_NAME, HS_SIZE, HS_CHUNK, HS_CAPS = 1, 2, 3, 4
+CAP_DIGEST = 0x10
+
+
+def _packet(ptype: int, stream: int, seq: int = 0, total: int = 0, window: int = 0,
+            payload: bytes = b"") -> bytes:
+    crc = zlib.crc32(payload) if ptype == PT_DATA else 0
+    return HEADER.pack(b"RU", PROTOCOL_VERSION, ptype, seq, total, len(payload), window,
+                       crc, stream, 0) + payload
+
+
+def _option(otype: int, value: bytes) -> bytes:
+    return struct.pack(">BH", otype, len(value)) + value
+
+
+class UdpTransferLibrary:
+    """Robot Framework library for testing UDP reliable transfer protocol."""
+    
+    def __init__(self):
+        self.server_process = None
+        self.client_process = None
+        self.client_output = ""
+        # Get the project root directory (2 levels up from this file)
+        project_root = Path(__file__).parent.parent.parent
+        self.build_dir = str(project_root / "build" / "bin")
+        self.server_data_dir = str(project_root / "server_data")
+        self.sample_data_dir = str(project_root / "sample_data")
+    
+    def _binary(self, name: str) -> str:
+        """Path of a built executable, with .exe on Windows."""
+        return f"{self.build_dir}/{name}.exe" if os.name == 'nt' else f"{self.build_dir}/{name}"
+    
+    def _client_command(self, host: str, port: int, file_path: str, options: Dict[str, Any]) -> list:
+        """Client command line for a file and the options send_file_with_options takes."""
+        if not os.path.exists(file_path):
+            raise FileNotFoundError(f"File not found: {file_path}")
+        
+        client_cmd = [
+            self._binary("client"),
+            "--host", host,
+            "--port", str(port),
+            "--file", file_path
+        ]
+        
+        # Add optional parameters
+        if 'chunk' in options:
+            client_cmd.extend(["--chunk", str(options['chunk'])])
+        if 'window' in options:
+            client_cmd.extend(["--window", str(options['window'])])
+        if 'timeout' in options:
+            client_cmd.extend(["--timeout", str(options['timeout'])])
+        if 'max_retries' in options:
+            client_cmd.extend(["--max-retries", str(options['max_retries'])])
+        if 'rate' in options:
+            client_cmd.extend(["--rate", str(options['rate'])])
+        if 'flows' in options:
+            client_cmd.extend(["--flows", str(options['flows'])])
+        if 'fec' in options:
+            client_cmd.extend(["--fec", str(options['fec'])])
+        return client_cmd
+    
+    def _client_env(self, options: Dict[str, Any]) -> Optional[Dict[str, str]]:
+        """Client environment: netem impairs the client's socket, e.g. "loss=3%"."""
+        if 'netem' not in options:
+            return None
+        env = dict(os.environ)
+        env["RUFT_NETEM"] = str(options['netem'])
+        return env
+    
+    def start_server(self, port: int = 9000, output_dir: str = None) -> None:
+        """Start the UDP server.
+        
+        Args:
+            port: Server port number
+            output_dir: Directory where received files will be saved
+        """
+        if self.server_process:
+            self.stop_server()
+        
+        # Use default output directory if none provided
+        if output_dir is None:
+            output_dir = self.server_data_dir
+            
+        # Ensure output directory exists
+        os.makedirs(output_dir, exist_ok=True)
+        
+        # Start server process
+        server_cmd = [self._binary("server"), "--port", str(port), "--out", output_dir]
+        self.server_process = subprocess.Popen(
+            server_cmd,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            text=True
+        )
+        
+        # Wait a bit for server to start
+        time.sleep(0.5)
+        
+        if self.server_process.poll() is not None:
+            raise RuntimeError(f"Server failed to start: {self.server_process.stderr.read()}")
+    
+    def stop_server(self) -> None:
+        """Stop the UDP server."""
+        if self.server_process:
+            self.server_process.terminate()
+            try:
+                self.server_process.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                self.server_process.kill()
+                self.server_process.wait()
+            self.server_process = None
+    
+    def send_file(self, host: str, port: int, file_path: str) -> int:
+        """Send a file using the UDP client.
+        
+        Args:
+            host: Server hostname/IP
+            port: Server port
+            file_path: Path to file to send
+            
+        Returns:
+            Exit code of the client process
+        """
+        if not os.path.exists(file_path):
+            raise FileNotFoundError(f"File not found: {file_path}")
+        
+        client_cmd = [
+            self._binary("client"),
+            "--host", host,
+            "--port", str(port),
+            "--file", file_path
+        ]
+        
+        result = subprocess.run(client_cmd, capture_output=True, text=True)
+        self.client_output = result.stdout + result.stderr
+        return result.returncode
+    
+    def send_file_with_options(self, host: str, port: int, file_path: str, **options) -> int:
+        """Send a file using the UDP client with custom options.
+        
+        Args:
+            host: Server hostname/IP
+            port: Server port
+            file_path: Path to file to send
+            **options: Additional options (chunk, window, timeout, max_retries, rate, flows,
+                fec, netem)
+            
+        Returns:
+            Exit code of the client process
+        """
+        client_cmd = self._client_command(host, port, file_path, options)
+        result = subprocess.run(client_cmd, capture_output=True, text=True,
+                                env=self._client_env(options))
+        self.client_output = result.stdout + result.stderr
+        return result.returncode
+    
+    def start_sending_file(self, host: str, port: int, file_path: str, **options) -> None:
+        """Start the UDP client in the background, e.g. to interrupt it.
+        
+        Args:
+            host: Server hostname/IP
+            port: Server port
+            file_path: Path to file to send
+            **options: Same options as send_file_with_options
+        """
+        if self.client_process:
+            self.kill_client()
+        client_cmd = self._client_command(host, port, file_path, options)
+        self.client_process = subprocess.Popen(
+            client_cmd,
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL,
+            env=self._client_env(options)
+        )
+    
+    def kill_client(self) -> None:
+        """Kill the background client outright, as a crash or power cut would."""
+        if self.client_process:
+            self.client_process.kill()
+            self.client_process.wait()
+            self.client_process = None
+    
+    def get_client_output(self) -> str:
+        """Get the stdout and stderr of the last client run to completion.
+        
+        Returns:
+            Client output as string
+        """
+        return self.client_output
+    
+    def send_file_with_wrong_digest(self, host: str, port: int, file_path: str,
+                                    chunk: int = 1024, timeout: float = 10.0) -> str:
+        """Upload a file over a hand-built session whose FIN carries a wrong digest.
+        
+        Every chunk arrives intact, so only the whole-file digest check
+        can catch the difference.
+        
+        Args:
+            host: Server hostname/IP
+            port: Server port
+            file_path: Path to file to send
+            chunk: Chunk size in bytes
+            timeout: Seconds to wait for the server before giving up
+            
+        Returns:
+            "FIN_ACK" if the server accepted the file, otherwise the message of its ERROR
+        """
+        with open(file_path, 'rb') as f:
+            data = f.read()
+        chunk = int(chunk)
+        total = (len(data) + chunk - 1) // chunk
+        stream, window = 1, 64
+        server = (host, int(port))
+        deadline = time.time() + float(timeout)
+        
+        def reply(sock):
+            pkt = sock.recv(65536)
+            if len(pkt) < HEADER.size:
+                return None, None, b""
+            magic, _, ptype, seq, _, length, _, _, _, _ = HEADER.unpack_from(pkt)
+            if magic != b"RU":
+                return None, None, b""
+            return ptype, seq, pkt[HEADER.size:HEADER.size + length]
+        
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+            sock.settimeout(0.5)
+            options = (_option(HS_NAME, os.path.basename(file_path).encode()) +
+                       _option(HS_SIZE, struct.pack(">Q", len(data))) +
+                       _option(HS_CHUNK, struct.pack(">I", chunk)) +
+                       _option(HS_CAPS, struct.pack(">I", CAP_DIGEST)))
+            hello = _packet(PT_HANDSHAKE, stream, total=total, window=window, payload=options)
+            
+            # Handshake, then DATA until a SACK says every chunk is in
+            expected = None
+            while expected is None or expected < total:
+                if time.time() > deadline:
+                    raise AssertionError("Server did not take the whole file")
+                if expected is None:
+                    sock.sendto(hello, server)
+                else:
+                    for seq in range(expected, min(total, expected + window)):
+                        sock.sendto(_packet(PT_DATA, stream, seq, total, window,
+                                            data[seq * chunk:(seq + 1) * chunk]), server)
+                try:
+                    ptype, seq, payload = reply(sock)
+                except socket.timeout:
+                    continue
+                if ptype == PT_ERROR:
+                    return payload.decode(errors='replace')
+                if ptype in (PT_HANDSHAKE_ACK, PT_SACK):
+                    expected = max(expected or 0, seq)
+            
+            # The digest of no real file: 8 zero bytes
+            fin = _packet(PT_FIN, stream, total=total, payload=bytes(8))
+            while time.time() < deadline:
+                sock.sendto(fin, server)
+                try:
+                    ptype, _, payload = reply(sock)
+                except socket.timeout:
+                    continue
+                if ptype == PT_FIN_ACK:
+                    return "FIN_ACK"
+                if ptype == PT_ERROR:
+                    return payload.decode(errors='replace')
+        raise AssertionError("Server did not answer the FIN")
+    
+    def get_file_size(self, file_path: str) -> int:
+        """Get the size of a file in bytes.
+        
+        Args:
+            file_path: Path to the file
+            
+        Returns:
+            File size in bytes
+        """
+        if not os.path.exists(file_path):
+            return 0
+        return os.path.getsize(file_path)
+    
+    def compare_files(self, file1: str, file2: str) -> bool:
+        """Compare two files for equality.
+        
+        Args:
+            file1: Path to first file
+            file2: Path to second file
+            
+        Returns:
+            True if files are identical, False otherwise
+        """
+        if not os.path.exists(file1) or not os.path.exists(file2):
+            return False
+        
+        # Compare file sizes first
+        if os.path.getsize(file1) != os.path.getsize(file2):
+            return False
+        
+        # Compare file contents
+        with open(file1, 'rb') as f1, open(file2, 'rb') as f2:
+            return f1.read() == f2.read()
+    
+    def copy_file(self, src: str, dst: str) -> None:
+        """Copy a file from source to destination.
+        
+        Args:
+            src: Source file path
+            dst: Destination file path
+        """
+        shutil.copy2(src, dst)
+    
+    def remove_file(self, file_path: str, missing_ok: bool = False) -> None:
+        """Remove a file.
+        
+        Args:
+            file_path: Path to file to remove
+            missing_ok: If True, don't raise error if file doesn't exist
+        """
+        try:
+            os.remove(file_path)
+        except FileNotFoundError:
+            if not missing_ok:
+                raise
+    
+    def create_directory(self, dir_path: str) -> None:
+        """Create a directory.
+        
+        Args:
+            dir_path: Path to directory to create
+        """
+        os.makedirs(dir_path, exist_ok=True)
+    
+    def remove_directory(self, dir_path: str, recursive: bool = False) -> None:
+        """Remove a directory.
+        
+        Args:
+            dir_path: Path to directory to remove
+            recursive: If True, remove directory and all contents
+        """
+        if recursive:
+            shutil.rmtree(dir_path, ignore_errors=True)
+        else:
+            os.rmdir(dir_path)
+    
+    def file_exists(self, file_path: str) -> bool:
+        """Check if a file exists.
+        
+        Args:
+            file_path: Path to file to check
+            
+        Returns:
+            True if file exists, False otherwise
+        """
+        return os.path.exists(file_path)
+    
+    def directory_exists(self, dir_path: str) -> bool:
+        """Check if a directory exists.
+        
+        Args:
+            dir_path: Path to directory to check
+            
+        Returns:
+            True if directory exists, False otherwise
+        """
+        return os.path.isdir(dir_path)
+    
+    def get_server_output(self) -> str:
+        """Get the server's stdout output.
+        
+        Returns:
+            Server's stdout output as string
+        """
+        if self.server_process:
+            return self.server_process.stdout.read() if self.server_process.stdout else ""
+        return ""
+    
+    def get_server_error(self) -> str:
+        """Get the server's stderr output.
+        
+        Returns:
+            Server's stderr output as string
+        """
+        if self.server_process:
+            return self.server_process.stderr.read() if self.server_process.stderr else ""
+        return ""
+    
+    def wait_for_server_ready(self, timeout: int = 10) -> bool:
+        """Wait for server to be ready.
+        
+        Args:
+            timeout: Timeout in seconds
+            
+        Returns:
+            True if server is ready, False if timeout
+        """
+        start_time = time.time()
+        while time.time() - start_time < timeout:
+            if self.server_process and self.server_process.poll() is None:
+                return True
+            time.sleep(0.1)
+        return False
@@ -0,0 +1,20 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+/* Minimal assertions for the unit tests: a failed CHECK reports its line
+ * and the test carries on, so one run lists every failure; main returns
+ * CHECK_RESULT() for ctest. */
+static int check_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_RESULT() (check_failures ? 1 : 0)
+
+#endif /* CHECK_H */
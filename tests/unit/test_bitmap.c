@@ -0,0 +1,56 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/common/bitmap.h"
+#include "check.h"
+
+static void test_set_scan(void) {
+    Bitmap b;
+    CHECK(bm_init(&b, 200));
+    CHECK(bm_next_set(&b, 0) == 200 && bm_next_clear(&b, 0) == 0);
+    CHECK(bm_set(&b, 0) && bm_set(&b, 63) && bm_set(&b, 64) && bm_set(&b, 199));
+    CHECK(!bm_set(&b, 64) && !bm_set(&b, 200));
+    CHECK(b.count == 4);
+    CHECK(bm_next_set(&b, 1) == 63 && bm_next_set(&b, 65) == 199 && bm_next_set(&b, 200) == 200);
+    for (size_t i = 0; i < 200; i++) bm_set(&b, i);
+    CHECK(bm_next_clear(&b, 0) == 200 && b.count == 200);
+    bm_free(&b);
+}
+
+/* bm_extract against bit-by-bit bm_test, for random bitmaps, offsets off
+ * word boundaries and ranges running past the end */
+static void test_extract(void) {
+    uint8_t out[200];
+    srand(7);
+    for (int round = 0; round < 2000; round++) {
+        Bitmap b;
+        size_t nbits = 1 + (size_t)rand() % 3000;
+        CHECK(bm_init(&b, nbits));
+        int sets = rand() % 500;
+        for (int i = 0; i < sets; i++) bm_set(&b, (size_t)rand() % nbits);
+        size_t from = (size_t)rand() % (nbits + 10);
+        size_t n = 1 + (size_t)rand() % (sizeof(out) * 8);
+        size_t held;
+        memset(out, 0xFF, sizeof(out));
+        size_t len = bm_extract(&b, from, n, out, &held);
+
+        size_t want_held = 0, want_len = 0;
+        for (size_t i = 0; i < n; i++) {
+            int bit = (out[i / 8] >> (i % 8)) & 1;
+            CHECK(bit == bm_test(&b, from + i));
+            if (bit) {
+                want_held++;
+                want_len = i / 8 + 1;
+            }
+        }
+        CHECK(held == want_held && len == want_len);
+        bm_free(&b);
+    }
+}
+
+int main(void) {
+    test_set_scan();
+    test_extract();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/common/compress.h"
+#include "check.h"
+
+#define MAX_LEN 8192
+
+static uint8_t text[MAX_LEN];
+static uint8_t noise[MAX_LEN];
+
+/* Compress then expand, as the client and the server's writers do */
+static void round_trip(const Codec* c, void* cctx, void* dctx, const uint8_t* src, size_t len) {
+    static uint8_t packed[MAX_LEN * 2], out[MAX_LEN];
+    size_t n = c->compress(cctx, packed, sizeof(packed), src, len);
+    CHECK(n > 0);
+    if (!n) return;
+    memset(out, 0xA5, sizeof(out));
+    CHECK(c->decompress(dctx, out, len, packed, n));
+    CHECK(memcmp(out, src, len) == 0);
+
+    /* The expanded size must match exactly, and a cut-off payload fails */
+    if (len > 1) CHECK(!c->decompress(dctx, out, len - 1, packed, n));
+    CHECK(!c->decompress(dctx, out, len + 1, packed, n));
+    if (n > 1) CHECK(!c->decompress(dctx, out, len, packed, n / 2));
+}
+
+static void test_codec(const Codec* c) {
+    CHECK(c->id >= 0 && c->id < CODEC_MAX);
+    CHECK(codec_by_id(c->id) == c);
+    void* cctx = c->ctx_new();
+    void* dctx = c->ctx_new();
+    CHECK(cctx != NULL && dctx != NULL);
+
+    /* Contexts are reused chunk after chunk */
+    for (size_t len = 1; len <= MAX_LEN; len = len * 3 + 1) {
+        round_trip(c, cctx, dctx, text, len);
+        round_trip(c, cctx, dctx, noise, len);
+    }
+    round_trip(c, cctx, dctx, text, MAX_LEN);
+
+    /* Text shrinks well; noise does not fit below its own size, which is
+     * what makes the client send such chunks raw */
+    static uint8_t packed[MAX_LEN];
+    size_t n = c->compress(cctx, packed, MAX_LEN - MAX_LEN / 16, text, MAX_LEN);
+    CHECK(n > 0 && n < MAX_LEN / 2);
+    CHECK(c->compress(cctx, packed, MAX_LEN - MAX_LEN / 16, noise, MAX_LEN) == 0);
+
+    c->ctx_free(cctx);
+    c->ctx_free(dctx);
+}
+
+int main(void) {
+    const char* words[] = { "chunk ", "window ", "sack ", "parity ", "flow ", "digest\n" };
+    srand(5);
+    for (size_t i = 0; i < MAX_LEN;) {
+        const char* w = words[rand() % 6];
+        size_t k = strlen(w);
+        if (k > MAX_LEN - i) k = MAX_LEN - i;
+        memcpy(text + i, w, k);
+        i += k;
+    }
+    for (size_t i = 0; i < MAX_LEN; i++) noise[i] = (uint8_t)rand();
+
+    /* Every codec this build offers, by name */
+    char names[64];
+    strncpy(names, codec_names(), sizeof(names) - 1);
+    names[sizeof(names) - 1] = '\0';
+    CHECK(strncmp(names, "off", 3) == 0);
+    int found = 0;
+    for (char* name = strtok(names, "|"); name; name = strtok(NULL, "|")) {
+        if (strcmp(name, "off") == 0) continue;
+        const Codec* c = codec_find(name);
+        CHECK(c != NULL);
+        if (!c) continue;
+        printf("%s\n", c->name);
+        test_codec(c);
+        found++;
+    }
+    CHECK(codec_find("off") == NULL);
+    CHECK(codec_find("brotli") == NULL);
+    CHECK(codec_by_id(CODEC_MAX) == NULL);
+    if (!found) printf("no codecs in this build\n");
+    return CHECK_RESULT();
+}
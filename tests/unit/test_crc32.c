@@ -0,0 +1,61 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/common/crc32.h"
+#include "check.h"
+
+#define BIG (64 * 1024)
+
+/* One bit at a time, the definition both kernels must agree with */
+static uint32_t crc32_bitwise(const uint8_t* p, size_t len) {
+    uint32_t crc = ~0u;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void test_check_value(void) {
+    const uint8_t s[] = "123456789";
+    CHECK(crc32_bitwise(s, 9) == 0xCBF43926u);
+    CHECK(ru_crc32(s, 9) == 0xCBF43926u);
+    CHECK(ru_crc32_portable(s, 9) == 0xCBF43926u);
+    CHECK(ru_crc32(s, 0) == 0);
+    CHECK(ru_crc32_portable(s, 0) == 0);
+}
+
+/* Every length through the short tails and the first few folding blocks,
+ * at each alignment, so the head, body and tail paths all get exercised */
+static void test_lengths(const uint8_t* buf) {
+    for (size_t off = 0; off < 8; off++) {
+        for (size_t len = 0; len <= 300; len++) {
+            uint32_t want = crc32_bitwise(buf + off, len);
+            CHECK(ru_crc32(buf + off, len) == want);
+            CHECK(ru_crc32_portable(buf + off, len) == want);
+        }
+    }
+}
+
+static void test_big(const uint8_t* buf) {
+    for (size_t off = 0; off < 4; off++) {
+        uint32_t want = crc32_bitwise(buf + off, BIG);
+        CHECK(ru_crc32(buf + off, BIG) == want);
+        CHECK(ru_crc32_portable(buf + off, BIG) == want);
+    }
+}
+
+int main(void) {
+    uint8_t* buf = malloc(BIG + 8);
+    if (!buf) return 1;
+    srand(1);
+    for (size_t i = 0; i < BIG + 8; i++) buf[i] = (uint8_t)rand();
+
+    printf("%s\n", ru_crc32_impl());
+    test_check_value();
+    test_lengths(buf);
+    test_big(buf);
+    free(buf);
+    return CHECK_RESULT();
+}
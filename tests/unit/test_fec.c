@@ -0,0 +1,180 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/common/fec.h"
+#include "check.h"
+
+#define CHUNK 1000
+#define NCHUNKS 150
+#define LAST_LEN 123            /* the file's last chunk is short */
+
+static uint8_t file[NCHUNKS][CHUNK];
+
+static size_t chunk_len(size_t seq) {
+    return seq == NCHUNKS - 1 ? LAST_LEN : CHUNK;
+}
+
+/* The sender's parity: the group's chunks XORed, each zero-padded */
+static size_t make_parity(uint8_t* out, size_t start, size_t end) {
+    size_t len = 0;
+    memset(out, 0, CHUNK);
+    for (size_t s = start; s < end; s++) {
+        for (size_t i = 0; i < chunk_len(s); i++) out[i] ^= file[s][i];
+        if (chunk_len(s) > len) len = chunk_len(s);
+    }
+    return len;
+}
+
+/* Every kernel length and misalignment against a byte-wise XOR */
+static void test_xor(void) {
+    uint8_t a[300], b[300], want[300];
+    for (size_t off = 0; off < 8; off++) {
+        for (size_t len = 0; len + off <= sizeof(a); len += 7) {
+            for (size_t i = 0; i < sizeof(a); i++) {
+                a[i] = (uint8_t)rand();
+                b[i] = (uint8_t)rand();
+            }
+            memcpy(want, a, sizeof(a));
+            for (size_t i = 0; i < len; i++) want[off + i] ^= b[i];
+            fec_xor(a + off, b, len);
+            CHECK(memcmp(a, want, sizeof(a)) == 0);
+        }
+    }
+    CHECK(fec_xor_impl() != NULL);
+}
+
+/* Drops each chunk of each group in turn, for every group size and a
+ * range that starts and ends in the middle of groups, as a striped flow's
+ * does; the parity arrives first, last or in between */
+static void test_recover_each_loss(void) {
+    const size_t lo = 5, hi = NCHUNKS;
+    FecDecoder d;
+    uint8_t parity[CHUNK];
+    CHECK(fec_dec_init(&d, CHUNK));
+    for (int shift = FEC_MIN_SHIFT; shift <= FEC_MAX_SHIFT; shift++) {
+        for (size_t seq = lo; seq < hi; seq++) {
+            size_t start, end;
+            fec_group_bounds(seq, shift, lo, hi, &start, &end);
+            CHECK(start <= seq && seq < end && end - start <= ((size_t)1 << shift));
+            if (end - start < 2) continue;
+            size_t plen = make_parity(parity, start, end);
+            size_t parity_at = seq % (end - start + 1);
+            size_t fed = 0, got = 0;
+            FecGroup* g = NULL;
+            for (size_t s = start; s <= end; s++) {
+                if (fed == parity_at) {
+                    g = fec_dec_add(&d, start, shift, lo, hi, 1, parity, plen);
+                    if (g) got++;
+                }
+                if (s == end) break;
+                fed++;
+                if (s == seq) continue;
+                CHECK(g == NULL);
+                g = fec_dec_add(&d, s, shift, lo, hi, 0, file[s], chunk_len(s));
+                if (g) got++;
+            }
+            CHECK(got == 1 && g != NULL);
+            if (!g) continue;
+            size_t lost;
+            const uint8_t* rebuilt = fec_dec_missing(g, &lost);
+            CHECK(lost == seq);
+            CHECK(memcmp(rebuilt, file[seq], chunk_len(seq)) == 0);
+            fec_dec_release(&d, g);
+        }
+    }
+    fec_dec_free(&d);
+}
+
+/* Two losses in a group, a duplicate and a complete group rebuild nothing */
+static void test_no_recovery(void) {
+    FecDecoder d;
+    uint8_t parity[CHUNK];
+    CHECK(fec_dec_init(&d, CHUNK));
+    int shift = 3;
+    size_t plen = make_parity(parity, 16, 24);
+
+    CHECK(fec_dec_add(&d, 16, shift, 0, NCHUNKS, 1, parity, plen) == NULL);
+    for (size_t s = 16; s < 22; s++) {
+        CHECK(fec_dec_add(&d, s, shift, 0, NCHUNKS, 0, file[s], CHUNK) == NULL);
+    }
+    /* 22 and 23 lost; a resent 21 must not count twice */
+    CHECK(fec_dec_add(&d, 21, shift, 0, NCHUNKS, 0, file[21], CHUNK) == NULL);
+    CHECK(fec_dec_add(&d, 16, shift, 0, NCHUNKS, 1, parity, plen) == NULL);
+
+    /* Then 23 arrives and 22 can be rebuilt */
+    FecGroup* g = fec_dec_add(&d, 23, shift, 0, NCHUNKS, 0, file[23], CHUNK);
+    CHECK(g != NULL);
+    if (g) {
+        size_t lost;
+        const uint8_t* rebuilt = fec_dec_missing(g, &lost);
+        CHECK(lost == 22 && memcmp(rebuilt, file[22], CHUNK) == 0);
+        fec_dec_release(&d, g);
+    }
+
+    /* All chunks in before the parity: the parity has nothing to add */
+    for (size_t s = 32; s < 40; s++) {
+        CHECK(fec_dec_add(&d, s, shift, 0, NCHUNKS, 0, file[s], CHUNK) == NULL);
+    }
+    plen = make_parity(parity, 32, 40);
+    CHECK(fec_dec_add(&d, 32, shift, 0, NCHUNKS, 1, parity, plen) == NULL);
+
+    /* Out of range or unsupported group sizes are ignored */
+    CHECK(fec_dec_add(&d, NCHUNKS, shift, 0, NCHUNKS, 0, file[0], CHUNK) == NULL);
+    CHECK(fec_dec_add(&d, 0, FEC_MAX_SHIFT + 1, 0, NCHUNKS, 0, file[0], CHUNK) == NULL);
+    CHECK(fec_dec_add(&d, 0, shift, 0, NCHUNKS, 0, file[0], CHUNK + 1) == NULL);
+    fec_dec_free(&d);
+}
+
+/* Groups of different sizes assemble side by side without evicting each
+ * other, as when the sender changes the group size mid-transfer */
+static void test_mixed_sizes(void) {
+    FecDecoder d;
+    uint8_t p64[CHUNK], p4[CHUNK];
+    CHECK(fec_dec_init(&d, CHUNK));
+    size_t l64 = make_parity(p64, 0, 64);
+    size_t l4 = make_parity(p4, 64, 68);
+    for (size_t s = 0; s < 64; s++) {
+        if (s == 10) continue;
+        CHECK(fec_dec_add(&d, s, 6, 0, NCHUNKS, 0, file[s], CHUNK) == NULL);
+        if (s == 40) {
+            /* The small group completes while the large one is open */
+            for (size_t t = 64; t < 67; t++) {
+                CHECK(fec_dec_add(&d, t, 2, 0, NCHUNKS, 0, file[t], CHUNK) == NULL);
+            }
+            FecGroup* g = fec_dec_add(&d, 64, 2, 0, NCHUNKS, 1, p4, l4);
+            size_t lost = 0;
+            CHECK(g != NULL && fec_dec_missing(g, &lost) && lost == 67);
+            if (g) fec_dec_release(&d, g);
+        }
+    }
+    FecGroup* g = fec_dec_add(&d, 0, 6, 0, NCHUNKS, 1, p64, l64);
+    CHECK(g != NULL);
+    if (g) {
+        size_t lost;
+        const uint8_t* rebuilt = fec_dec_missing(g, &lost);
+        CHECK(lost == 10 && memcmp(rebuilt, file[10], CHUNK) == 0);
+    }
+    fec_dec_free(&d);
+}
+
+static void test_shift_for_loss(void) {
+    CHECK(fec_shift_for_loss(0.0) == FEC_MAX_SHIFT);
+    CHECK(fec_shift_for_loss(0.5) == FEC_MIN_SHIFT);
+    for (double loss = 0.001; loss < 0.5; loss *= 1.5) {
+        CHECK(fec_shift_for_loss(loss * 1.5) <= fec_shift_for_loss(loss));
+    }
+}
+
+int main(void) {
+    srand(3);
+    for (size_t s = 0; s < NCHUNKS; s++) {
+        for (size_t i = 0; i < CHUNK; i++) file[s][i] = i < chunk_len(s) ? (uint8_t)rand() : 0;
+    }
+    test_xor();
+    test_recover_each_loss();
+    test_no_recovery();
+    test_mixed_sizes();
+    test_shift_for_loss();
+    return CHECK_RESULT();
+}
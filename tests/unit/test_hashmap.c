@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../../src/common/hashmap.h"
+#include "check.h"
+
+#define NKEYS 5000
+
+/* Values are addresses into this array, so each key's value is checkable */
+static int vals[NKEYS];
+
+static uint64_t key_of(size_t i) {
+    /* Packed IPv4 address and port, the server's session key */
+    return ((uint64_t)0x7f000001 << 16) | (uint64_t)(40000 + i);
+}
+
+/* Every key below n that is still in the map maps to its own value */
+static int all_present(const HashMap* m, size_t n, size_t skip_mod) {
+    for (size_t i = 0; i < n; i++) {
+        void* v = hmap_get(m, key_of(i));
+        int want = !(skip_mod && i % skip_mod == 0);
+        if (want ? v != &vals[i] : v != NULL) return 0;
+    }
+    return 1;
+}
+
+static void test_put_get(void) {
+    HashMap m;
+    CHECK(hmap_init(&m, 0));
+    CHECK(hmap_get(&m, key_of(0)) == NULL);
+    CHECK(!hmap_put(&m, key_of(0), NULL));
+
+    /* Grows several times on the way */
+    for (size_t i = 0; i < NKEYS; i++) CHECK(hmap_put(&m, key_of(i), &vals[i]));
+    CHECK(m.count == NKEYS);
+    CHECK(m.count * 10 <= m.cap * 7);
+    CHECK(all_present(&m, NKEYS, 0));
+
+    /* Replacing a value keeps the count */
+    CHECK(hmap_put(&m, key_of(7), &vals[8]));
+    CHECK(hmap_get(&m, key_of(7)) == &vals[8]);
+    CHECK(m.count == NKEYS);
+    hmap_free(&m);
+}
+
+/* Backward-shift deletion must leave every other probe chain intact, and
+ * a deleted key must go back in as a fresh entry */
+static void test_remove_reinsert(void) {
+    HashMap m;
+    CHECK(hmap_init(&m, 64));
+    for (size_t i = 0; i < NKEYS; i++) hmap_put(&m, key_of(i), &vals[i]);
+
+    for (size_t i = 0; i < NKEYS; i += 3) CHECK(hmap_remove(&m, key_of(i)) == &vals[i]);
+    CHECK(hmap_remove(&m, key_of(0)) == NULL);
+    CHECK(hmap_remove(&m, key_of(NKEYS)) == NULL);
+    CHECK(m.count == NKEYS - (NKEYS + 2) / 3);
+    CHECK(all_present(&m, NKEYS, 3));
+
+    for (size_t i = 0; i < NKEYS; i += 3) CHECK(hmap_put(&m, key_of(i), &vals[i]));
+    CHECK(m.count == NKEYS);
+    CHECK(all_present(&m, NKEYS, 0));
+
+    /* Emptied completely, then refilled */
+    for (size_t i = 0; i < NKEYS; i++) CHECK(hmap_remove(&m, key_of(i)) == &vals[i]);
+    CHECK(m.count == 0);
+    for (size_t i = 0; i < m.cap; i++) CHECK(m.slots[i].val == NULL);
+    for (size_t i = 0; i < NKEYS; i++) CHECK(hmap_put(&m, key_of(i), &vals[i]));
+    CHECK(all_present(&m, NKEYS, 0));
+    hmap_free(&m);
+}
+
+/* Random churn against a plain array as the reference */
+static void test_churn(void) {
+    HashMap m;
+    CHECK(hmap_init(&m, 0));
+    static int in[NKEYS];
+    srand(1);
+    for (int step = 0; step < 200000; step++) {
+        size_t i = (size_t)rand() % NKEYS;
+        if (rand() % 2) {
+            hmap_put(&m, key_of(i), &vals[i]);
+            in[i] = 1;
+        } else {
+            CHECK(hmap_remove(&m, key_of(i)) == (in[i] ? &vals[i] : NULL));
+            in[i] = 0;
+        }
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < NKEYS; i++) {
+        CHECK(hmap_get(&m, key_of(i)) == (in[i] ? &vals[i] : NULL));
+        count += (size_t)in[i];
+    }
+    CHECK(m.count == count);
+    hmap_free(&m);
+}
+
+int main(void) {
+    test_put_get();
+    test_remove_reinsert();
+    test_churn();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,282 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/common/protocol.h"
+#include "check.h"
+
+#define NCHUNKS 1000
+
+static int same_bits(const Bitmap* a, const Bitmap* b) {
+    if (a->nbits != b->nbits || a->count != b->count) return 0;
+    for (size_t i = 0; i < a->nbits; i++) {
+        if (bm_test(a, i) != bm_test(b, i)) return 0;
+    }
+    return 1;
+}
+
+/* The server's HS_RANGES from its .part bitmap, read back by the client */
+static void test_resume_round_trip(void) {
+    Bitmap have, got;
+    uint8_t ranges[RESUME_MAX_BYTES];
+    bm_init(&have, NCHUNKS);
+    for (size_t i = 0; i < 100; i++) bm_set(&have, i);         /* below seq */
+    for (size_t i = 120; i < 130; i++) bm_set(&have, i);
+    bm_set(&have, 500);
+    for (size_t i = 990; i < NCHUNKS; i++) bm_set(&have, i);  /* runs to the end */
+
+    size_t first = bm_next_clear(&have, 0);
+    CHECK(first == 100);
+    size_t n = resume_encode(ranges, sizeof(ranges), &have, first);
+    CHECK(n == 3 * 8);
+    CHECK(get_be32(ranges) == 120 && get_be32(ranges + 4) == 130);
+    CHECK(get_be32(ranges + 8) == 500 && get_be32(ranges + 12) == 501);
+    CHECK(get_be32(ranges + 16) == 990 && get_be32(ranges + 20) == NCHUNKS);
+
+    bm_init(&got, NCHUNKS);
+    resume_decode((uint32_t)first, ranges, n, &got);
+    CHECK(same_bits(&have, &got));
+    bm_free(&got);
+
+    /* Nothing held past seq: no ranges at all */
+    Bitmap prefix;
+    bm_init(&prefix, NCHUNKS);
+    for (size_t i = 0; i < 10; i++) bm_set(&prefix, i);
+    CHECK(resume_encode(ranges, sizeof(ranges), &prefix, 10) == 0);
+    bm_free(&prefix);
+    bm_free(&have);
+}
+
+/* A list cut short to fit only loses chunks the client then resends */
+static void test_resume_truncated(void) {
+    Bitmap have, got;
+    uint8_t ranges[RESUME_MAX_BYTES];
+    bm_init(&have, NCHUNKS);
+    for (size_t i = 1; i < NCHUNKS; i += 2) bm_set(&have, i);
+
+    size_t n = resume_encode(ranges, 8 * 4 + 7, &have, 0);
+    CHECK(n == 8 * 4);
+    bm_init(&got, NCHUNKS);
+    resume_decode(0, ranges, n, &got);
+    CHECK(got.count == 4);
+    for (size_t i = 0; i < NCHUNKS; i++) {
+        if (bm_test(&got, i)) CHECK(bm_test(&have, i));
+    }
+    bm_free(&got);
+
+    /* Every other chunk needs more ranges than the largest list holds */
+    n = resume_encode(ranges, sizeof(ranges), &have, 0);
+    CHECK(n == RESUME_MAX_BYTES);
+    bm_free(&have);
+}
+
+/* Ranges from a confused or hostile server stay inside the bitmap */
+static void test_resume_decode_bounds(void) {
+    Bitmap got;
+    uint8_t ranges[16 + 3];
+    put_be32(ranges, 20);
+    put_be32(ranges + 4, 0xFFFFFFFFu);      /* past the end */
+    put_be32(ranges + 8, 5);
+    put_be32(ranges + 12, 2);               /* backwards */
+    memset(ranges + 16, 0xFF, 3);           /* a trailing partial pair */
+    bm_init(&got, 30);
+    resume_decode(0xFFFFFFFFu, ranges, 0, &got);
+    CHECK(got.count == 30);
+    bm_free(&got);
+
+    bm_init(&got, 30);
+    resume_decode(0, ranges, sizeof(ranges), &got);
+    CHECK(got.count == 10);
+    CHECK(bm_next_set(&got, 0) == 20);
+    bm_free(&got);
+}
+
+static void fill_handshake(Handshake* hs) {
+    memset(hs, 0, sizeof(*hs));
+    strcpy(hs->name, "photos/2024/beach.jpg");
+    hs->size = 5000000123ULL;               /* needs all 64 bits */
+    hs->chunk = 1400;
+    hs->caps = CAP_RESUME | CAP_STRIPE | CAP_FEC | CAP_COMPRESS | CAP_DIGEST;
+    hs->id = 0xDEADBEEF;
+    hs->xfer = 0x0123456789ABCDEFULL;
+    hs->flow = 2;
+    hs->nflows = 4;
+    hs->codecs[0] = 1;
+    hs->codecs[1] = 0;
+    hs->ncodecs = 2;
+}
+
+static int same_handshake(const Handshake* a, const Handshake* b) {
+    return strcmp(a->name, b->name) == 0 && a->size == b->size && a->chunk == b->chunk &&
+           a->caps == b->caps && a->id == b->id && a->xfer == b->xfer && a->flow == b->flow &&
+           a->nflows == b->nflows && a->ncodecs == b->ncodecs &&
+           memcmp(a->codecs, b->codecs, a->ncodecs) == 0;
+}
+
+static void test_hs_round_trip(void) {
+    Handshake hs, got;
+    uint8_t buf[HS_ACK_MAX];
+    fill_handshake(&hs);
+    size_t n = hs_encode(buf, sizeof(buf), &hs);
+    CHECK(n > 0);
+    CHECK(hs_parse(buf, n, &got) == 1);
+    CHECK(same_handshake(&hs, &got));
+
+    /* Only the required options */
+    memset(&hs, 0, sizeof(hs));
+    strcpy(hs.name, "a");
+    hs.chunk = MIN_CHUNK;
+    n = hs_encode(buf, sizeof(buf), &hs);
+    CHECK(n == 3 + 1 + 3 + 8 + 3 + 4);
+    CHECK(hs_parse(buf, n, &got) == 1);
+    CHECK(same_handshake(&hs, &got));
+
+    /* The longest name allowed */
+    memset(hs.name, 'x', HS_FIELD_MAX);
+    hs.name[HS_FIELD_MAX] = '\0';
+    n = hs_encode(buf, sizeof(buf), &hs);
+    CHECK(n > 0 && hs_parse(buf, n, &got) == 1 && strlen(got.name) == HS_FIELD_MAX);
+
+    /* Does not fit: nothing is written past cap */
+    fill_handshake(&hs);
+    n = hs_encode(buf, sizeof(buf), &hs);
+    memset(buf, 0xEE, sizeof(buf));
+    CHECK(hs_encode(buf, n - 1, &hs) == 0);
+    CHECK(buf[n - 1] == 0xEE);
+}
+
+/* Options a newer client adds are skipped, and CAP_* bits that lack
+ * their parameter are dropped rather than trusted */
+static void test_hs_options(void) {
+    Handshake got;
+    uint8_t buf[HS_ACK_MAX];
+    TlvBuf b;
+    tlv_init(&b, buf, sizeof(buf));
+    tlv_put(&b, 200, "future", 6);
+    tlv_put(&b, HS_NAME, "f", 1);
+    tlv_put(&b, 201, NULL, 0);
+    tlv_put_u64(&b, HS_SIZE, 10);
+    tlv_put_u32(&b, HS_CHUNK, 1000);
+    tlv_put_u32(&b, HS_CAPS, CAP_RESUME | CAP_STRIPE | CAP_COMPRESS | CAP_DIGEST);
+    CHECK(!b.overflow);
+    CHECK(hs_parse(buf, b.len, &got) == 1);
+    CHECK(got.caps == CAP_DIGEST);
+    CHECK(strcmp(got.name, "f") == 0 && got.size == 10 && got.chunk == 1000);
+
+    /* More codecs offered than kept: the first ones win */
+    tlv_put(&b, HS_CODEC, "\x02\x01\x00\x05\x06\x07", 6);
+    CHECK(hs_parse(buf, b.len, &got) == 1);
+    CHECK(got.caps == (CAP_COMPRESS | CAP_DIGEST));
+    CHECK(got.ncodecs == sizeof(got.codecs) && memcmp(got.codecs, "\x02\x01\x00\x05", 4) == 0);
+
+    /* A later option overrides an earlier one of the same type */
+    tlv_put_u32(&b, HS_CHUNK, 2000);
+    CHECK(hs_parse(buf, b.len, &got) == 1 && got.chunk == 2000);
+
+    /* Overflow leaves the buffer as it was */
+    size_t len = b.len;
+    tlv_put(&b, HS_NAME, buf, sizeof(buf));
+    CHECK(b.overflow && b.len == len);
+}
+
+/* Builds NAME, SIZE, CHUNK with one of them replaced by a bad option */
+static size_t bad_handshake(uint8_t* buf, size_t cap, uint8_t type, const void* val, size_t len) {
+    TlvBuf b;
+    tlv_init(&b, buf, cap);
+    if (type == HS_NAME) tlv_put(&b, HS_NAME, val, len);
+    else tlv_put(&b, HS_NAME, "f", 1);
+    if (type == HS_SIZE) tlv_put(&b, HS_SIZE, val, len);
+    else tlv_put_u64(&b, HS_SIZE, 10);
+    if (type == HS_CHUNK) tlv_put(&b, HS_CHUNK, val, len);
+    else tlv_put_u32(&b, HS_CHUNK, 1000);
+    if (type != HS_NAME && type != HS_SIZE && type != HS_CHUNK) tlv_put(&b, type, val, len);
+    return b.len;
+}
+
+static void test_hs_malformed(void) {
+    Handshake hs, got;
+    uint8_t buf[HS_ACK_MAX];
+    uint8_t zeros[16] = {0};
+    char longname[HS_FIELD_MAX + 1];
+    memset(longname, 'x', sizeof(longname));
+
+    CHECK(hs_parse(buf, 0, &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_NAME, "", 0), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_NAME, "a\0b", 3), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_NAME, longname, sizeof(longname)), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_SIZE, zeros, 4), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_CHUNK, zeros, 8), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_CAPS, zeros, 2), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_ID, zeros, 8), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), HS_FLOW, zeros, 9), &got) == 0);
+    CHECK(hs_parse(buf, bad_handshake(buf, sizeof(buf), 99, zeros, 9), &got) == 1);
+
+    /* A required option missing */
+    TlvBuf b;
+    tlv_init(&b, buf, sizeof(buf));
+    tlv_put(&b, HS_NAME, "f", 1);
+    tlv_put_u32(&b, HS_CHUNK, 1000);
+    CHECK(hs_parse(buf, b.len, &got) == 0);
+
+    /* Cut anywhere but between two options: the last option's header or
+     * value runs past the datagram */
+    fill_handshake(&hs);
+    size_t n = hs_encode(buf, sizeof(buf), &hs);
+    size_t ends[16], nends = 0, off = 0;
+    Tlv t;
+    while (tlv_next(buf, n, &off, &t) > 0) ends[nends++] = off;
+    CHECK(nends == 7 && ends[nends - 1] == n);
+    for (size_t cut = 1; cut < n; cut++) {
+        int boundary = 0;
+        for (size_t i = 0; i < nends; i++) boundary |= ends[i] == cut;
+        if (!boundary) CHECK(hs_parse(buf, cut, &got) == 0);
+    }
+
+    /* An option length that claims more than there is */
+    n = bad_handshake(buf, sizeof(buf), 99, zeros, 4);
+    buf[n - 6] = 0xFF;
+    CHECK(hs_parse(buf, n, &got) == 0);
+}
+
+/* A handshake in another protocol version gets its ERROR in that
+ * version's header layout, so an old client can read the reason */
+static void test_version_error(void) {
+    uint8_t req[HEADER_SIZE] = { 'R', 'U', 1, PT_HANDSHAKE };
+    uint8_t out[HEADER_SIZE + 64];
+    const char* msg = "unsupported version";
+    size_t len = strlen(msg);
+
+    size_t n = pack_version_error(out, sizeof(out), req, HEADER_SIZE_V1, msg);
+    CHECK(n == HEADER_SIZE_V1 + len);
+    CHECK(out[2] == 1 && out[3] == PT_ERROR && out[12] == 0 && out[13] == len);
+    CHECK(memcmp(out + HEADER_SIZE_V1, msg, len) == 0);
+    CHECK(pack_version_error(out, sizeof(out), req, HEADER_SIZE_V1 - 1, msg) == 0);
+
+    req[2] = 2;
+    req[20] = 0x04;
+    req[21] = 0xD2;
+    CHECK(pack_version_error(out, sizeof(out), req, HEADER_SIZE - 1, msg) == 0);
+    n = pack_version_error(out, sizeof(out), req, HEADER_SIZE, msg);
+    CHECK(n == HEADER_SIZE + len);
+    out[2] = VERSION;                       /* unpack only reads this version */
+    Packet p;
+    CHECK(unpack_view(out, n, &p) == 0);
+    CHECK(p.ptype == PT_ERROR && p.stream == 1234 && p.payload_size == len);
+
+    /* Newer than this build: answered in this build's layout */
+    req[2] = VERSION + 6;
+    n = pack_version_error(out, sizeof(out), req, HEADER_SIZE, msg);
+    CHECK(n == HEADER_SIZE + len && out[2] == VERSION);
+    CHECK(pack_version_error(out, HEADER_SIZE + len - 1, req, HEADER_SIZE, msg) == 0);
+}
+
+int main(void) {
+    test_resume_round_trip();
+    test_resume_truncated();
+    test_resume_decode_bounds();
+    test_hs_round_trip();
+    test_hs_options();
+    test_hs_malformed();
+    test_version_error();
+    return CHECK_RESULT();
+}
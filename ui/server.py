@@ -17,6 +17,7 @@ from pathlib import Path
 from flask import Flask, request, jsonify, send_file
 from flask_cors import CORS
 import psutil
+import urllib.request
 
 app = Flask(__name__, static_folder=str(Path(__file__).parent), static_url_path='')
 CORS(app)  # Enable CORS for all routes
@@ -41,10 +42,30 @@ app_start_time = datetime.now()
 request_count = 0
 error_count = 0
 
+def free_tcp_port(preferred):
+    """The preferred TCP port if it can be bound on 127.0.0.1, else one the OS picks"""
+    for candidate in (preferred, 0):
+        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as probe:
+            try:
+                probe.bind(("127.0.0.1", candidate))
+            except OSError:
+                continue
+            return probe.getsockname()[1]
+    raise OSError("no free TCP port for the metrics endpoint")
+
+def metrics_reachable(stats_port):
+    """One scrape of the server's metrics endpoint, True if it answered"""
+    try:
+        with urllib.request.urlopen(f"http://127.0.0.1:{stats_port}/metrics", timeout=2) as resp:
+            return resp.status == 200
+    except OSError:
+        return False
+
 class ServerManager:
     def __init__(self):
         self.process = None
         self.port = None
+        self.stats_port = None  # TCP port of the server's Prometheus endpoint
         self.output_dir = None
         self.is_running = False
         self.logs = []
@@ -75,7 +96,11 @@ class ServerManager:
             
             for attempt in range(max_port_attempts):
                 try:
-                    cmd = [str(server_exe), "--port", str(port), "--out", output_dir]
+                    # TCP and UDP ports are separate, so the metrics share the
+                    # number unless something else already holds it over TCP
+                    stats_port = free_tcp_port(port)
+                    cmd = [str(server_exe), "--port", str(port), "--out", output_dir,
+                           "--stats-port", str(stats_port)]
                     print(f"Attempting to start server on port {port} (attempt {attempt + 1}/{max_port_attempts})")
                     
                     # Start the process
@@ -106,8 +131,15 @@ class ServerManager:
                             self.is_running = False
                             return {"success": False, "error": f"Server failed to start: {error_output}"}
                     else:
+                        # The server keeps running without metrics if it cannot
+                        # bind them, so check the endpoint answers before saying so
+                        if not metrics_reachable(stats_port):
+                            self.stop_server()
+                            return {"success": False, "error": f"Server started on port {port} but its metrics endpoint on TCP port {stats_port} did not answer"}
+
                         # Server started successfully
                         self.port = port
+                        self.stats_port = stats_port
                         self.output_dir = output_dir
                         self.is_running = True
                         self.start_time = datetime.now()
@@ -115,10 +147,12 @@ class ServerManager:
                         # Start log monitoring thread
                         threading.Thread(target=self._monitor_logs, daemon=True).start()
                         
+                        message = f"Server started on port {port}"
                         if port != original_port:
-                            return {"success": True, "message": f"Server started on port {port} (original port {original_port} was in use)"}
-                        else:
-                            return {"success": True, "message": f"Server started on port {port}"}
+                            message += f" (original port {original_port} was in use)"
+                        if stats_port != port:
+                            message += f", metrics on TCP port {stats_port} (TCP port {port} was in use)"
+                        return {"success": True, "message": message}
                             
                 except Exception as e:
                     if attempt < max_port_attempts - 1:
@@ -171,6 +205,7 @@ class ServerManager:
             
             self.is_running = False
             self.port = None
+            self.stats_port = None
             self.output_dir = None
             self.start_time = None
             
@@ -203,6 +238,31 @@ class ServerManager:
     def get_logs(self):
         """Get server logs"""
         return self.logs.copy()
+
+    def get_metrics(self):
+        """Scrape the server's metrics endpoint and parse the Prometheus text"""
+        if not self.is_running or not self.stats_port:
+            return None
+        url = f"http://127.0.0.1:{self.stats_port}/metrics"
+        with urllib.request.urlopen(url, timeout=2) as resp:
+            text = resp.read().decode('utf-8', 'replace')
+        metrics = {}
+        for line in text.splitlines():
+            if not line or line.startswith('#'):
+                continue
+            name, _, value = line.rpartition(' ')
+            try:
+                value = float(value)
+            except ValueError:
+                continue
+            if '{' in name:
+                # Histogram bucket: name_bucket{le="..."}
+                base, _, label = name.partition('{')
+                le = label.split('"')[1] if '"' in label else label
+                metrics.setdefault(base, {})[le] = value
+            else:
+                metrics[name] = value
+        return metrics
     
     def get_status(self):
         """Get server status"""
@@ -413,6 +473,17 @@ def get_server_status():
     except Exception as e:
         return jsonify({"error": f"Failed to get server status: {str(e)}"}), 500
 
+@app.route('/api/server/metrics', methods=['GET'])
+def get_server_metrics():
+    """Get the server's live counters, parsed from its Prometheus endpoint"""
+    try:
+        metrics = server_manager.get_metrics()
+        if metrics is None:
+            return jsonify({"error": "Server is not running"}), 503
+        return jsonify({"metrics": metrics})
+    except Exception as e:
+        return jsonify({"error": f"Failed to get server metrics: {str(e)}"}), 500
+
 @app.route('/api/server/logs', methods=['GET'])
 def get_server_logs():
     """Get server logs"""
@@ -478,8 +549,8 @@ def send_file():
             # Validate and convert parameters with error handling
             try:
                 chunk_size = int(request.form.get('chunk_size', 1024))
-                if chunk_size < 64 or chunk_size > 8192:
-                    return jsonify({"success": False, "error": f"Invalid chunk_size: {chunk_size}. Must be between 64 and 8192"}), 400
+                if chunk_size < 256 or chunk_size > 8192:
+                    return jsonify({"success": False, "error": f"Invalid chunk_size: {chunk_size}. Must be between 256 and 8192"}), 400
             except ValueError:
                 return jsonify({"success": False, "error": "Invalid chunk_size parameter"}), 400
             